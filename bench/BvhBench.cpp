@@ -0,0 +1,114 @@
+/**
+ * CPU benchmark for the Bvh spatial index: build, refit and query times for growing numbers of
+ * randomly scattered objects, compared against a linear walk over every object.
+ */
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include "Bvh.h"
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	double millisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	BoundingBox randomBox(std::mt19937& rng, float worldSize) {
+		std::uniform_real_distribution<float> position{ -worldSize, worldSize };
+		std::uniform_real_distribution<float> size{ 0.5f, 4.0f };
+		glm::vec3 center{ position(rng), 0, position(rng) };
+		glm::vec3 half{ size(rng), size(rng) * 2, size(rng) };
+		return BoundingBox{ center - half, center + half };
+	}
+}
+
+int main() {
+	std::mt19937 rng{ 449 };
+	glm::mat4 projection{ glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 500.0f) };
+	glm::mat4 view{ glm::lookAt(glm::vec3{ 0, 1.3f, 5 }, glm::vec3{ 0, 1.3f, 4 }, glm::vec3{ 0, 1, 0 }) };
+	Frustum frustum{ Frustum::fromMatrix(projection * view) };
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "objects  build(ms)  refit1%(ms)  refit100%(ms)  frustum(ms)  linear(ms)  1k rays(ms)  1k spheres(ms)  visible" << std::endl;
+
+	for (uint32_t count : { 1000u, 10000u, 100000u }) {
+		// Keep the density roughly constant as the world grows.
+		float worldSize{ 20.0f * std::sqrt(static_cast<float>(count)) };
+		std::vector<BoundingBox> boxes(count);
+		for (auto& b : boxes) {
+			b = randomBox(rng, worldSize);
+		}
+
+		Bvh bvh{};
+		auto start{ Clock::now() };
+		bvh.build(boxes);
+		double buildTime{ millisecondsSince(start) };
+
+		// Nudge 1% of the objects, then every object.
+		std::uniform_real_distribution<float> nudge{ -1.0f, 1.0f };
+		auto move{ [&](uint32_t i) {
+			glm::vec3 offset{ nudge(rng), 0, nudge(rng) };
+			boxes[i] = BoundingBox{ boxes[i].min + offset, boxes[i].max + offset };
+			bvh.update(i, boxes[i]);
+		} };
+		for (uint32_t i{ 0 }; i < count; i += 100) {
+			move(i);
+		}
+		start = Clock::now();
+		bvh.refit();
+		double refitSomeTime{ millisecondsSince(start) };
+		for (uint32_t i{ 0 }; i < count; ++i) {
+			move(i);
+		}
+		start = Clock::now();
+		bvh.refit();
+		double refitAllTime{ millisecondsSince(start) };
+
+		std::vector<uint32_t> visible{};
+		visible.reserve(count);
+		start = Clock::now();
+		bvh.queryFrustum(frustum, visible);
+		double frustumTime{ millisecondsSince(start) };
+
+		size_t linearVisible{ 0 };
+		start = Clock::now();
+		for (auto& b : boxes) {
+			linearVisible += frustum.intersects(b) ? 1 : 0;
+		}
+		double linearTime{ millisecondsSince(start) };
+		if (linearVisible != visible.size()) {
+			std::cerr << "frustum query mismatch: " << visible.size() << " vs " << linearVisible << std::endl;
+			return 1;
+		}
+
+		std::uniform_real_distribution<float> angle{ 0, 6.2831853f };
+		uint32_t hits{ 0 };
+		start = Clock::now();
+		for (uint32_t i{ 0 }; i < 1000; ++i) {
+			float a{ angle(rng) };
+			Ray ray{ glm::vec3{ 0, 1, 0 }, glm::vec3{ std::cos(a), -0.01f, std::sin(a) } };
+			uint32_t item{};
+			float distance{};
+			hits += bvh.raycast(ray, worldSize * 2, item, distance) ? 1 : 0;
+		}
+		double rayTime{ millisecondsSince(start) };
+
+		std::vector<uint32_t> nearby{};
+		std::uniform_real_distribution<float> position{ -worldSize, worldSize };
+		start = Clock::now();
+		for (uint32_t i{ 0 }; i < 1000; ++i) {
+			nearby.clear();
+			bvh.querySphere(BoundingSphere{ glm::vec3{ position(rng), 0, position(rng) }, 10.0f }, nearby);
+		}
+		double sphereTime{ millisecondsSince(start) };
+
+		std::cout << std::setw(7) << count << std::setw(11) << buildTime << std::setw(13) << refitSomeTime
+			<< std::setw(15) << refitAllTime << std::setw(13) << frustumTime << std::setw(12) << linearTime
+			<< std::setw(13) << rayTime << std::setw(16) << sphereTime << std::setw(9) << visible.size()
+			<< "  (" << hits << " ray hits)" << std::endl;
+	}
+	return 0;
+}
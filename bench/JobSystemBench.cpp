@@ -0,0 +1,115 @@
+/**
+ * Microbenchmarks for the JobSystem: job throughput, dependency-chain overhead, submit-to-start latency
+ * and parallelFor scaling, for a range of worker counts.
+ * Usage: JobSystemBench [maxWorkers]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "JobSystem.h"
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	double microsecondsBetween(Clock::time_point start, Clock::time_point end) {
+		return std::chrono::duration<double, std::micro>(end - start).count();
+	}
+
+	// Jobs per second for many tiny independent jobs submitted from the main thread.
+	double throughput(JobSystem& jobs, uint32_t jobCount) {
+		std::atomic<uint32_t> counter{ 0 };
+		std::vector<JobSystem::JobHandle> handles{};
+		handles.reserve(jobCount);
+		auto start{ Clock::now() };
+		for (uint32_t i{ 0 }; i < jobCount; ++i) {
+			handles.push_back(jobs.submit([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); }));
+		}
+		for (auto& h : handles) {
+			jobs.wait(h);
+		}
+		double seconds{ microsecondsBetween(start, Clock::now()) / 1e6 };
+		return jobCount / seconds;
+	}
+
+	// Microseconds per link of a chain where every job depends on the one before it.
+	double chainLatency(JobSystem& jobs, uint32_t length) {
+		auto start{ Clock::now() };
+		JobSystem::JobHandle previous{};
+		for (uint32_t i{ 0 }; i < length; ++i) {
+			previous = jobs.submit([]() {}, { previous });
+		}
+		jobs.wait(previous);
+		return microsecondsBetween(start, Clock::now()) / length;
+	}
+
+	// Median and 99th percentile time from submit() until the job starts running, with idle workers.
+	void startLatency(JobSystem& jobs, uint32_t samples, double& median, double& p99) {
+		std::vector<double> latencies{};
+		for (uint32_t i{ 0 }; i < samples; ++i) {
+			Clock::time_point started{};
+			auto submitted{ Clock::now() };
+			auto job{ jobs.submit([&started]() { started = Clock::now(); }) };
+			// Spin rather than help, so we measure how quickly a worker picks the job up.
+			while (jobs.workerCount() > 0 && !JobSystem::isDone(job)) {
+			}
+			jobs.wait(job);
+			latencies.push_back(microsecondsBetween(submitted, started));
+		}
+		std::sort(latencies.begin(), latencies.end());
+		median = latencies[latencies.size() / 2];
+		p99 = latencies[latencies.size() * 99 / 100];
+	}
+
+	// Milliseconds for a parallelFor over a compute-bound loop.
+	double parallelForTime(JobSystem& jobs, std::vector<float>& data) {
+		auto start{ Clock::now() };
+		jobs.parallelFor(data.size(), 16384, [&data](size_t begin, size_t end) {
+			for (size_t i{ begin }; i < end; ++i) {
+				data[i] = std::sqrt(data[i] * 1.0001f + 1.0f);
+			}
+		});
+		return microsecondsBetween(start, Clock::now()) / 1000;
+	}
+}
+
+int main(int argc, char** argv) {
+	uint32_t maxWorkers{ std::max(1u, std::thread::hardware_concurrency()) - 1 };
+	if (argc > 1) {
+		maxWorkers = static_cast<uint32_t>(std::stoul(argv[1]));
+	}
+
+	std::vector<float> data(1 << 23, 1.0f);
+	double serialTime{ 0 };
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "workers  jobs/s(M)  chain(us/job)  start p50(us)  start p99(us)  parallelFor(ms)  speedup" << std::endl;
+	std::vector<uint32_t> workerCounts{ 0 };
+	for (uint32_t w{ 1 }; w <= maxWorkers; w *= 2) {
+		workerCounts.push_back(w);
+	}
+	if (workerCounts.back() != maxWorkers) {
+		workerCounts.push_back(maxWorkers);
+	}
+
+	for (uint32_t workers : workerCounts) {
+		JobSystem jobs{ workers };
+		double rate{ throughput(jobs, 200000) };
+		double chain{ chainLatency(jobs, 50000) };
+		double median{}, p99{};
+		startLatency(jobs, 2000, median, p99);
+		double forTime{ parallelForTime(jobs, data) };
+		if (workers == 0) {
+			serialTime = forTime;
+		}
+
+		std::cout << std::setw(7) << workers << std::setw(11) << rate / 1e6 << std::setw(15) << chain
+			<< std::setw(15) << median << std::setw(15) << p99 << std::setw(17) << forTime
+			<< std::setw(9) << serialTime / forTime << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,154 @@
+/**
+ * Microbenchmark and consistency check for meshlet culling: meshlets per second for cullMeshletsScalar and
+ * cullMeshlets on a finely tessellated sphere seen from random cameras around it, plus a check that both
+ * kernels cull the same meshlets and return the same index ranges for every camera.
+ */
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "Frustum.h"
+#include "Meshlets.h"
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	struct View {
+		glm::vec4 planes[6]{};
+		glm::vec3 camera{};
+	};
+
+	// A sphere of rings x segments quads, with a ripple in its radius so the meshlets' cones differ.
+	void buildSphere(uint32_t rings, uint32_t segments, std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces) {
+		constexpr float pi{ 3.14159265f };
+		for (uint32_t r{ 0 }; r <= rings; ++r) {
+			float theta{ pi * r / rings };
+			for (uint32_t s{ 0 }; s <= segments; ++s) {
+				float phi{ 2 * pi * s / segments };
+				glm::vec3 normal{ std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+				glm::vec3 position{ normal * (1 + 0.05f * std::sin(12 * phi) * std::sin(9 * theta)) };
+				vertices.push_back(Vertex3D{ position.x, position.y, position.z,
+					static_cast<float>(s) / segments, static_cast<float>(r) / rings, normal.x, normal.y, normal.z });
+			}
+		}
+		for (uint32_t r{ 0 }; r < rings; ++r) {
+			for (uint32_t s{ 0 }; s < segments; ++s) {
+				uint32_t a{ r * (segments + 1) + s };
+				uint32_t b{ a + segments + 1 };
+				faces.insert(faces.end(), { a, a + 1, b, a + 1, b + 1, b });
+			}
+		}
+	}
+
+	// A camera between 1.5 and 8 units from the sphere's center, looking somewhere near it (or, now and then,
+	// away from it, so whole frames are frustum culled).
+	View randomView(std::mt19937& rng) {
+		std::uniform_real_distribution<float> unit{ -1, 1 };
+		std::uniform_real_distribution<float> distance{ 1.5f, 8 };
+		glm::vec3 direction{ unit(rng), unit(rng), unit(rng) };
+		if (glm::length(direction) < 1e-3f) {
+			direction = glm::vec3{ 0, 0, 1 };
+		}
+		View view{};
+		view.camera = glm::normalize(direction) * distance(rng);
+		glm::vec3 target{ unit(rng) * 0.5f, unit(rng) * 0.5f, unit(rng) * 0.5f };
+		if (unit(rng) > 0.8f) {
+			target = view.camera * 2.0f;
+		}
+		glm::mat4 projection{ glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f) };
+		Frustum frustum{ Frustum::fromMatrix(projection * glm::lookAt(view.camera, target, glm::vec3{ 0, 1, 0 })) };
+		for (uint32_t i{ 0 }; i < 6; ++i) {
+			view.planes[i] = frustum.planes[i] / glm::length(glm::vec3{ frustum.planes[i] });
+		}
+		return view;
+	}
+
+	bool sameRanges(const std::vector<Meshlet>& a, const std::vector<Meshlet>& b) {
+		if (a.size() != b.size()) {
+			return false;
+		}
+		for (size_t i{ 0 }; i < a.size(); ++i) {
+			if (a[i].firstIndex != b[i].firstIndex || a[i].indexCount != b[i].indexCount) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template <typename F>
+	double meshletsPerSecond(size_t count, F&& run) {
+		// Repeat until at least 200ms have passed, to smooth out timer resolution.
+		size_t total{ 0 };
+		auto start{ Clock::now() };
+		double seconds{ 0 };
+		do {
+			run();
+			total += count;
+			seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		} while (seconds < 0.2);
+		return total / seconds;
+	}
+}
+
+int main() {
+	std::mt19937 rng{ 449 };
+	std::cout << "kernel: " << meshletKernelName() << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "  meshlets  visible    cone  frustum  scalar(M/s)  simd(M/s)  speedup  mismatches" << std::endl;
+
+	bool ok{ true };
+	for (uint32_t rings : { 32u, 128u, 512u }) {
+		std::vector<Vertex3D> vertices{};
+		std::vector<uint32_t> faces{};
+		buildSphere(rings, rings * 2, vertices, faces);
+		MeshletSet set{ buildMeshlets(vertices, faces, false) };
+
+		std::vector<View> views(64);
+		for (auto& view : views) {
+			view = randomView(rng);
+		}
+
+		// Both kernels must agree on every meshlet for every camera.
+		MeshletCullCounts total{};
+		uint32_t mismatches{ 0 };
+		std::vector<Meshlet> scalarOut{}, simdOut{};
+		for (auto& view : views) {
+			MeshletCullCounts scalar{ cullMeshletsScalar(set, view.planes, view.camera, scalarOut) };
+			MeshletCullCounts simd{ cullMeshlets(set, view.planes, view.camera, simdOut) };
+			if (scalar.visible != simd.visible || scalar.coneCulled != simd.coneCulled
+				|| scalar.frustumCulled != simd.frustumCulled || !sameRanges(scalarOut, simdOut)) {
+				++mismatches;
+			}
+			total.visible += scalar.visible;
+			total.coneCulled += scalar.coneCulled;
+			total.frustumCulled += scalar.frustumCulled;
+		}
+		ok = ok && mismatches == 0;
+
+		size_t perPass{ set.size() * views.size() };
+		double scalarRate{ meshletsPerSecond(perPass, [&] {
+			for (auto& view : views) {
+				cullMeshletsScalar(set, view.planes, view.camera, scalarOut);
+			}
+		}) };
+		double simdRate{ meshletsPerSecond(perPass, [&] {
+			for (auto& view : views) {
+				cullMeshlets(set, view.planes, view.camera, simdOut);
+			}
+		}) };
+
+		auto share{ [&](uint32_t n) { return 100.0 * n / perPass; } };
+		std::cout << std::setw(10) << set.size() << std::setw(8) << share(total.visible) << "%"
+			<< std::setw(7) << share(total.coneCulled) << "%" << std::setw(8) << share(total.frustumCulled) << "%"
+			<< std::setw(13) << scalarRate / 1e6 << std::setw(11) << simdRate / 1e6
+			<< std::setw(8) << simdRate / scalarRate << "x" << std::setw(12) << mismatches << std::endl;
+	}
+
+	if (!ok) {
+		std::cout << "FAILED: the kernels disagree" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * Microbenchmark for the batched model matrix kernel: matrices per second for per-object glm composition
+ * (composeModelMatrix, as used by SceneObject::buildModelMatrix), the scalar kernel and the SIMD kernel,
+ * plus the largest difference between the kernels and glm.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "TransformBatch.h"
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	// Largest element-wise difference, relative to the size of the reference element (or absolute near zero).
+	float maxError(const std::vector<glm::mat4>& reference, const std::vector<glm::mat4>& result) {
+		float worst{ 0 };
+		for (size_t i{ 0 }; i < reference.size(); ++i) {
+			for (int c{ 0 }; c < 4; ++c) {
+				for (int r{ 0 }; r < 4; ++r) {
+					float expected{ reference[i][c][r] };
+					float error{ std::abs(result[i][c][r] - expected) / std::max(1.0f, std::abs(expected)) };
+					worst = std::max(worst, error);
+				}
+			}
+		}
+		return worst;
+	}
+
+	template <typename F>
+	double matricesPerSecond(size_t count, F&& run) {
+		// Repeat until at least 200ms have passed, to smooth out timer resolution.
+		size_t total{ 0 };
+		auto start{ Clock::now() };
+		double seconds{ 0 };
+		do {
+			run();
+			total += count;
+			seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		} while (seconds < 0.2);
+		return total / seconds;
+	}
+}
+
+int main() {
+	// Results must agree with glm to this relative tolerance.
+	constexpr float tolerance{ 1e-4f };
+	std::mt19937 rng{ 449 };
+	std::uniform_real_distribution<float> position{ -100, 100 };
+	std::uniform_real_distribution<float> angle{ -6.2831853f, 6.2831853f };
+	std::uniform_real_distribution<float> scale{ 0.1f, 10 };
+	std::uniform_real_distribution<float> center{ -1, 1 };
+
+	std::cout << "kernel: " << modelMatrixKernelName() << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "  count  base  glm(M/s)  scalar(M/s)  simd(M/s)  simd speedup  scalar err  simd err" << std::endl;
+
+	bool ok{ true };
+	for (size_t count : { 1000u, 100000u, 1000000u }) {
+		for (bool withBase : { false, true }) {
+			TransformBatch batch{};
+			std::vector<glm::vec3> positions(count), orientations(count), scales(count), centers(count);
+			std::vector<glm::mat4> bases(count, glm::mat4{ 1 });
+			for (size_t i{ 0 }; i < count; ++i) {
+				positions[i] = glm::vec3{ position(rng), position(rng), position(rng) };
+				orientations[i] = glm::vec3{ angle(rng), angle(rng), angle(rng) };
+				scales[i] = glm::vec3{ scale(rng), scale(rng), scale(rng) };
+				centers[i] = glm::vec3{ center(rng), center(rng), center(rng) };
+				if (withBase) {
+					bases[i] = glm::translate(glm::rotate(glm::mat4{ 1 }, angle(rng), glm::vec3{ 0, 1, 0 }),
+						glm::vec3{ center(rng), center(rng), center(rng) });
+					batch.add(positions[i], orientations[i], scales[i], centers[i], bases[i]);
+				}
+				else {
+					batch.add(positions[i], orientations[i], scales[i], centers[i]);
+				}
+			}
+
+			std::vector<glm::mat4> reference(count), scalar(count), simd(count);
+			double glmRate{ matricesPerSecond(count, [&]() {
+				for (size_t i{ 0 }; i < count; ++i) {
+					reference[i] = composeModelMatrix(positions[i], orientations[i], scales[i], centers[i], bases[i]);
+				}
+			}) };
+			double scalarRate{ matricesPerSecond(count, [&]() { buildModelMatricesScalar(batch, scalar.data()); }) };
+			double simdRate{ matricesPerSecond(count, [&]() { buildModelMatrices(batch, simd.data()); }) };
+
+			float scalarError{ maxError(reference, scalar) };
+			float simdError{ maxError(reference, simd) };
+			ok = ok && scalarError < tolerance && simdError < tolerance;
+
+			std::cout << std::setw(7) << count << std::setw(6) << (withBase ? "yes" : "no")
+				<< std::setw(10) << glmRate / 1e6 << std::setw(13) << scalarRate / 1e6 << std::setw(11) << simdRate / 1e6
+				<< std::setw(14) << simdRate / glmRate << std::scientific << std::setprecision(1)
+				<< std::setw(12) << scalarError << std::setw(10) << simdError << std::fixed << std::setprecision(2) << std::endl;
+		}
+	}
+
+	if (!ok) {
+		std::cerr << "kernel results differ from glm by more than " << tolerance << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SceneObject.h"
+#include "StbImage.h"
+
+/**
+ * @brief A texture in VRAM shared by everything that uses the same image. Its GL texture is retired once
+ * the last handle to it goes away.
+ */
+struct TextureAsset {
+	GlTexture texture{};
+	uint32_t textureId{ 0 };
+	size_t bytes{ 0 };
+	std::string key{};
+	uint64_t contentHash{ 0 };
+};
+
+/**
+ * @brief A loaded model shared by every object made from it: the uploaded hierarchy to copy, and handles
+ * to the textures its meshes use. Its meshes' geometry leaves the arena with the last object that copied them.
+ */
+struct ModelAsset {
+	SceneObject prototype{};
+	std::vector<std::shared_ptr<const TextureAsset>> textures{};
+	// The VRAM taken by the model's meshes, and by the meshes and textures together.
+	size_t meshBytes{ 0 };
+	size_t totalBytes() const;
+	// The vertex memory saved by meshes stored in a packed vertex format instead of Vertex3D.
+	size_t packedBytesSaved{ 0 };
+	uint64_t contentHash{ 0 };
+};
+
+using TextureHandle = std::shared_ptr<const TextureAsset>;
+using ModelHandle = std::shared_ptr<const ModelAsset>;
+
+/**
+ * @brief The process-wide registry of loaded models and textures, so loading the same file twice, or two
+ * files with identical contents, shares one copy in VRAM.
+ *
+ * Assets are looked up by their canonical path first, then by a hash of their file's contents. A path only
+ * matches while the asset's content hash does too, so a file edited on disk loads again instead of handing
+ * back the stale copy. The registry only holds weak references: an asset lives as long as some handle to it
+ * does, and then its GL objects are retired to GpuResources.
+ *
+ * Lookups are thread-safe, so loading jobs can skip work that is already done; adding assets uploads to
+ * the GPU and must happen on the GL thread.
+ */
+class AssetRegistry {
+public:
+	// A key that is the same for every path to the same file.
+	static std::string canonicalKey(const std::filesystem::path& path);
+	static uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+	// The hash of a file's contents, or 0 if it can't be read. Remembered until the file's size or
+	// modification time changes, so hashing a file that is looked up again and again costs one stat.
+	static uint64_t hashFile(const std::filesystem::path& path);
+
+	// The live texture with this key and content hash, or any with the content hash, or null.
+	TextureHandle findTexture(const std::string& key, uint64_t contentHash);
+	// Upload a decoded image as a texture, unless a live one with the same key or content hash appeared
+	// since it was looked up.
+	TextureHandle addTexture(const std::string& key, uint64_t contentHash, const StbImage& image);
+
+	// The live model with this key and content hash, or any with the content hash, or null. A model's key
+	// and hash should include the import options that change what it loads as.
+	ModelHandle findModel(const std::string& key, uint64_t contentHash);
+	// Register a freshly uploaded model, unless a live one with the same key or content hash appeared since
+	// it was looked up; then the new one is dropped and the existing one returned.
+	ModelHandle addModel(const std::string& key, uint64_t contentHash, SceneObject prototype,
+		std::vector<TextureHandle> textures);
+	// A new object made from a model, which keeps the model alive.
+	static SceneObject instantiate(const ModelHandle& model);
+
+	// Loads satisfied by an asset that was already resident, and the VRAM they would have taken.
+	uint64_t duplicatesPrevented() const;
+	uint64_t bytesSaved() const;
+	void printStats(std::ostream& out);
+
+private:
+	template <typename Asset>
+	struct Table {
+		std::unordered_map<std::string, std::weak_ptr<const Asset>> byKey{};
+		std::unordered_map<uint64_t, std::weak_ptr<const Asset>> byHash{};
+
+		std::shared_ptr<const Asset> find(const std::string& key, uint64_t contentHash) const;
+		void insert(const std::string& key, uint64_t contentHash, const std::shared_ptr<const Asset>& asset);
+		size_t liveCount();
+	};
+
+	void countDuplicate(size_t bytes);
+
+	mutable std::mutex m_mutex{};
+	Table<TextureAsset> m_textures{};
+	Table<ModelAsset> m_models{};
+	uint64_t m_duplicatesPrevented{ 0 };
+	uint64_t m_bytesSaved{ 0 };
+};
+
+// The process-wide asset registry.
+AssetRegistry& assetRegistry();
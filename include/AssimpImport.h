@@ -1,14 +1,92 @@
 #pragma once
+#include "AssetRegistry.h"
 #include "Texture.h"
 #include "SceneObject.h"
+#include "EntityStore.h"
 #include <assimp/scene.h>
 #include <unordered_map>
 #include <filesystem>
 #include <string>
+#include <vector>
 
+/**
+ * @brief Options controlling how a model file is turned into a SceneObject.
+ */
+struct ImportOptions {
+	// Flip the V texture coordinate of every vertex, for formats whose UV origin is the top-left.
+	bool flipTextureCoords{ false };
+	// The model never moves relative to its root. Every node's base transform is applied to its vertices
+	// at load time, and all meshes that share the same textures are merged into one, so the model draws
+	// with one call per texture set instead of one per mesh.
+	bool bakeStatic{ false };
+	// The levels of detail to generate for every mesh, as fractions of its triangle count. Empty to only
+	// keep the full mesh.
+	std::vector<float> lodRatios{ 0.5f, 0.25f, 0.1f };
+	// The layout meshes are stored in on the GPU. packed halves their vertex memory, at 16 bits of precision
+	// over each mesh's bounds.
+	VertexFormat vertexFormat{ VertexFormat::standard };
+	// Reorder every mesh's triangles for the post-transform vertex cache and less overdraw, and its vertices
+	// for fetch locality (see optimizeMesh), reporting the vertex cache stats before and after.
+	bool optimizeMeshes{ true };
+	// Meshes with at least this many triangles are split into meshlets (see buildMeshlets), so the render
+	// queue can skip the parts that are off screen or face away from the camera. 0 never splits meshes.
+	uint32_t meshletMinTriangles{ 2048 };
+};
+
+/**
+ * @brief A static model read, baked and decoded into RAM without any GL calls, so the slow part of loading
+ * can run off the main thread. Each mesh's textures are placeholders whose id is the index of their image
+ * plus one; uploadStaticModel replaces them with the real textures.
+ *
+ * Models and images the asset registry already has are not decoded again: existing holds them instead.
+ */
+struct DecodedModel {
+	struct Image {
+		std::string path;
+		std::string samplerName;
+		// The image's registry key and content hash.
+		std::string key{};
+		uint64_t contentHash{ 0 };
+		StbImage image{};
+		bool decoded{ false };
+		TextureHandle existing{};
+	};
+
+	std::string path{};
+	std::string key{};
+	uint64_t contentHash{ 0 };
+	ModelHandle existing{};
+	VertexFormat vertexFormat{ VertexFormat::standard };
+	std::vector<MeshData> meshes{};
+	std::vector<Image> images{};
+
+	// The memory the decoded data takes now, and an estimate of what it will take on the GPU once uploaded.
+	size_t ramBytes() const;
+	size_t vramBytes() const;
+};
+
+// Load a model file, or make a new object from the copy already in the asset registry.
 SceneObject assimpLoad(const std::string& path, bool flipUVCoords);
+SceneObject assimpLoad(const std::string& path, const ImportOptions& options);
 SceneObject processAssimpNode(
 	const aiNode* node, 
 	const aiScene* scene,
 	const std::filesystem::path& modelPath,
-	std::unordered_map<std::string, Texture>& loadedTextures);
\ No newline at end of file
+	std::unordered_map<std::string, Texture>& loadedTextures,
+	const ImportOptions& options = {});
+// Loading a static model in two steps: decodeStaticModel is safe to call from a job, uploadStaticModel must be
+// called on the thread that owns the GL context. options.bakeStatic is implied. Make objects from the model
+// with AssetRegistry::instantiate.
+DecodedModel decodeStaticModel(const std::string& path, const ImportOptions& options);
+ModelHandle uploadStaticModel(DecodedModel& model);
+// Loads a model file into an entity store instead of a SceneObject: every node becomes an entity, and meshes
+// are appended to the store's mesh list. Returns the entity for the root node.
+Entity assimpLoadEntities(const std::string& path, const ImportOptions& options, EntityStore& store);
+Entity processAssimpNodeEntities(
+	const aiNode* node,
+	const aiScene* scene,
+	const std::filesystem::path& modelPath,
+	std::unordered_map<std::string, Texture>& loadedTextures,
+	EntityStore& store,
+	Entity parent,
+	const ImportOptions& options = {});
@@ -0,0 +1,35 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <limits>
+
+/**
+ * @brief An axis-aligned bounding box. A default-constructed box is empty, and grows to fit whatever
+ * points or boxes are added to it.
+ */
+struct BoundingBox {
+	glm::vec3 min{ std::numeric_limits<float>::max() };
+	glm::vec3 max{ -std::numeric_limits<float>::max() };
+
+	bool isEmpty() const;
+	glm::vec3 center() const;
+	// Half the size of the box along each axis.
+	glm::vec3 extents() const;
+
+	// Whether a point is inside the box grown by margin on every side.
+	bool contains(const glm::vec3& point, float margin = 0) const;
+
+	// Grow the box to contain the given point or box.
+	void expand(const glm::vec3& point);
+	void expand(const BoundingBox& box);
+
+	// The axis-aligned box containing this box after it has been transformed by the given matrix.
+	BoundingBox transformed(const glm::mat4& matrix) const;
+};
+
+/**
+ * @brief A sphere enclosing some geometry.
+ */
+struct BoundingSphere {
+	glm::vec3 center{ 0, 0, 0 };
+	float radius{ 0 };
+};
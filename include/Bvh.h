@@ -0,0 +1,74 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <vector>
+#include <cstdint>
+#include "Bounds.h"
+#include "Frustum.h"
+
+/**
+ * @brief A ray for picking queries. The direction does not need to be normalized; hit distances are
+ * measured in multiples of its length.
+ */
+struct Ray {
+	glm::vec3 origin{ 0, 0, 0 };
+	glm::vec3 direction{ 0, 0, -1 };
+};
+
+/**
+ * @brief A bounding volume hierarchy over a set of items identified by index, for culling, picking and
+ * proximity queries that would otherwise need a linear walk over every object.
+ *
+ * The tree is built with a binned surface area heuristic. When items move, their new bounds are set with
+ * update() and the affected branches are refit by refit(). Refitting keeps the topology, so the tree
+ * slowly degrades as items move away from their original neighbours; once its SAH cost has grown past
+ * rebuildThreshold times the cost right after the last build, refit() rebuilds it from scratch.
+ */
+class Bvh {
+public:
+	// How much the SAH cost may grow from refitting before the tree is rebuilt.
+	float rebuildThreshold{ 1.5f };
+
+	// Build the tree over the given item bounds. Item i is identified by index i in query results.
+	void build(const std::vector<BoundingBox>& itemBounds);
+	// Change the bounds of an item. Takes effect at the next refit().
+	void update(uint32_t item, const BoundingBox& bounds);
+	// Refit every branch containing an updated item, rebuilding the tree if it has degraded too far.
+	// Returns true if the tree was rebuilt.
+	bool refit();
+
+	// Append every item whose bounds intersect the frustum.
+	void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const;
+	// Append every item whose bounds intersect the sphere.
+	void querySphere(const BoundingSphere& sphere, std::vector<uint32_t>& results) const;
+	// Find the item whose bounds the ray enters first, within maxDistance. Returns false on a miss.
+	bool raycast(const Ray& ray, float maxDistance, uint32_t& hitItem, float& hitDistance) const;
+
+	// The SAH cost of the current tree: the expected cost of a query, relative to testing one item.
+	float cost() const;
+	size_t itemCount() const;
+	size_t nodeCount() const;
+
+private:
+	struct Node {
+		BoundingBox bounds;
+		// For a leaf, the first of its items in m_items; otherwise the index of its left child.
+		// The right child always directly follows the left.
+		uint32_t first;
+		// The number of items in a leaf, or 0 for an interior node.
+		uint32_t count;
+		uint32_t parent;
+	};
+
+	void subdivide(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth);
+	void rebuild();
+
+	std::vector<Node> m_nodes{};
+	// Item indices, grouped so each leaf's items are contiguous.
+	std::vector<uint32_t> m_items{};
+	std::vector<BoundingBox> m_itemBounds{};
+	// The leaf that holds each item.
+	std::vector<uint32_t> m_itemLeaf{};
+	// Leaves whose items have changed bounds since the last refit.
+	std::vector<uint32_t> m_dirtyLeaves{};
+	float m_builtCost{ 0 };
+};
@@ -0,0 +1,167 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Bounds.h"
+#include "Frustum.h"
+#include "Mesh.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+#include "ShaderProgram.h"
+#include "TransformBatch.h"
+
+/**
+ * @brief Identifies an entity in an EntityStore. The generation distinguishes an entity from a later one
+ * that reuses the same slot after it was destroyed.
+ */
+struct Entity {
+	uint32_t index{ UINT32_MAX };
+	uint32_t generation{ 0 };
+
+	bool isValid() const { return index != UINT32_MAX; }
+	bool operator==(const Entity& other) const = default;
+};
+
+// The hot data for placing an entity in the world; the same fields as SceneObject.
+struct Transform {
+	glm::vec3 position{ 0, 0, 0 };
+	glm::vec3 orientation{ 0, 0, 0 };
+	glm::vec3 scale{ 1, 1, 1 };
+	glm::vec3 center{ 0, 0, 0 };
+	glm::mat4 baseTransform{ 1 };
+	// The entity this one's transform is relative to, if any. Change with EntityStore::setParent.
+	Entity parent{};
+};
+
+// A range of meshes in the store's mesh list that are drawn with the entity's world matrix.
+struct MeshRef {
+	uint32_t first{ 0 };
+	uint32_t count{ 0 };
+};
+
+// Phong material parameters (ambient, diffuse, specular, shininess).
+struct Material {
+	glm::vec4 parameters{ 0.1, 1.0, 0.3, 4 };
+};
+
+// The extent of an entity's meshes in local space, and in world space as of the last culling pass.
+struct Bounds {
+	BoundingBox local{};
+	BoundingBox world{};
+};
+
+using ComponentMask = uint32_t;
+namespace Components {
+	constexpr ComponentMask transform{ 1 << 0 };
+	constexpr ComponentMask meshRef{ 1 << 1 };
+	constexpr ComponentMask material{ 1 << 2 };
+	constexpr ComponentMask bounds{ 1 << 3 };
+	// What an imported node with meshes gets.
+	constexpr ComponentMask renderable{ transform | meshRef | material | bounds };
+}
+
+/**
+ * @brief All entities that have exactly the same set of components, stored as one contiguous array per
+ * component. Row i of every array belongs to entities[i]; arrays for components the archetype doesn't
+ * have stay empty. Systems walk these arrays linearly.
+ */
+struct Archetype {
+	ComponentMask mask{ 0 };
+	std::vector<Entity> entities{};
+	std::vector<Transform> transforms{};
+	// Written by updateTransforms; present whenever transforms are.
+	std::vector<glm::mat4> localMatrices{};
+	std::vector<glm::mat4> worldMatrices{};
+	std::vector<MeshRef> meshRefs{};
+	std::vector<Material> materials{};
+	std::vector<Bounds> bounds{};
+	// Written by cullEntities; present whenever bounds are.
+	std::vector<uint8_t> visible{};
+
+	size_t size() const { return entities.size(); }
+};
+
+struct TextureAsset;
+
+/**
+ * @brief A data-oriented alternative to a tree of SceneObjects. Entities are grouped into archetypes by
+ * their set of components, so the per-frame systems (transforms, culling, draw list) touch only the tightly
+ * packed data they need, instead of chasing pointers through a recursive tree that mixes hot and cold data.
+ */
+class EntityStore {
+public:
+	// Meshes referenced by MeshRef components, and the shared textures they use, which are kept in VRAM for
+	// as long as the store is around.
+	std::vector<Mesh> meshes{};
+	std::vector<std::shared_ptr<const TextureAsset>> textures{};
+
+	Entity create(ComponentMask components);
+	void destroy(Entity entity);
+	bool isAlive(Entity entity) const;
+	// Add or remove components, moving the entity to the archetype for its new set.
+	void setComponents(Entity entity, ComponentMask components);
+	ComponentMask components(Entity entity) const;
+
+	// Access one entity's components. The entity must have the component, and the reference is only
+	// valid until an entity is created, destroyed or changes components.
+	Transform& transform(Entity entity);
+	MeshRef& meshRef(Entity entity);
+	Material& material(Entity entity);
+	Bounds& bounds(Entity entity);
+	const glm::mat4& worldMatrix(Entity entity) const;
+
+	// Make child's transform relative to parent's. Both must be alive and have a Transform; returns false,
+	// changing nothing, if either doesn't. A parent that later loses its Transform makes the child a root.
+	bool setParent(Entity child, Entity parent);
+	// Whether the entity is alive and has a Transform.
+	bool hasTransform(Entity entity) const;
+
+	std::vector<Archetype>& archetypes();
+	size_t entityCount() const;
+
+private:
+	friend void updateTransforms(EntityStore& store);
+
+	struct Location {
+		uint32_t archetype{ 0 };
+		uint32_t row{ 0 };
+		uint32_t generation{ 0 };
+		bool alive{ false };
+	};
+
+	uint32_t archetypeFor(ComponentMask mask);
+	void removeRow(uint32_t archetype, uint32_t row);
+	const Location& locate(Entity entity) const;
+
+	std::vector<Archetype> m_archetypes{};
+	std::vector<Location> m_locations{};
+	std::vector<uint32_t> m_freeSlots{};
+	size_t m_entityCount{ 0 };
+
+	// Entities with a parent, ordered so every parent comes before its children. Rebuilt lazily.
+	std::vector<Entity> m_hierarchyOrder{};
+	bool m_hierarchyDirty{ false };
+	// Scratch space for the batched local matrix kernel.
+	TransformBatch m_batch{};
+};
+
+// The transform system: rebuild every entity's local matrix with the batched kernel, then resolve parents.
+void updateTransforms(EntityStore& store);
+// The culling system: update every entity's world bounds and mark whether it is inside the frustum.
+// Returns the number of entities culled. Entities inside the frustum but hidden behind the occlusion culler's
+// occluders are also marked invisible, and counted in the frame stats instead.
+uint32_t cullEntities(EntityStore& store, const Frustum& frustum, const OcclusionCuller* occlusion = nullptr);
+
+// One mesh to draw, with everything needed to draw it.
+struct EntityDraw {
+	const Mesh* mesh;
+	const glm::mat4* model;
+	const glm::vec4* material;
+};
+// The draw-list system: collect every mesh of every visible entity.
+void buildDrawList(EntityStore& store, std::vector<EntityDraw>& drawList);
+// Draw a draw list, setting the model matrix and material only when they change.
+void drawEntities(const std::vector<EntityDraw>& drawList, ShaderProgram& program);
+// Add a draw list to a render queue instead of drawing it immediately.
+void enqueueEntities(const std::vector<EntityDraw>& drawList, ShaderProgram& program, RenderQueue& queue);
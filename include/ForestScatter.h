@@ -0,0 +1,100 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "InstanceRenderer.h"
+#include "JobSystem.h"
+
+/**
+ * @brief How one kind of plant is scattered over the ground.
+ */
+struct ScatterRule {
+	// The InstanceRenderer model to place.
+	uint32_t model{ 0 };
+	// The minimum distance between two instances of this rule.
+	float spacing{ 1 };
+	// The fraction of Poisson-disk samples kept where the density noise is at its highest. The noise thins
+	// the samples out into clumps and clearings.
+	float density{ 1 };
+	// The minimum distance from instances of the rules added before this one, so mushrooms don't grow
+	// inside tree trunks.
+	float clearance{ 0 };
+	// The height of the model's origin above y = 0, and the range of uniform scales applied on top of
+	// baseScale.
+	float height{ 0 };
+	float baseScale{ 1 };
+	float minScale{ 1 };
+	float maxScale{ 1 };
+};
+
+/**
+ * @brief Scatters plants over an unbounded world in fixed-size square chunks, for drawing with an
+ * InstanceRenderer.
+ *
+ * Each chunk is filled with Poisson-disk samples (Bridson's algorithm) seeded from the world seed and the
+ * chunk's coordinates, so the same chunk always comes out the same no matter when or in what order it is
+ * generated. Samples keep half their rule's spacing away from the chunk's edges, which keeps the spacing
+ * across chunk borders without chunks having to know about each other.
+ *
+ * Chunks within loadRadius of the camera are generated on the job system, nearest first and a few at a time;
+ * chunks beyond unloadRadius are dropped, so the memory and CPU spent on the forest depend only on the radii.
+ */
+class ForestScatter {
+public:
+	// Discs on the ground, as (x, z, radius), where nothing is scattered.
+	std::vector<glm::vec3> keepOut{};
+	// The most chunks generated at once, so a fast camera can't flood the job system.
+	uint32_t maxPendingChunks{ 4 };
+
+	ForestScatter(uint32_t seed, float chunkSize, float loadRadius, float unloadRadius);
+	// Waits for the pending chunks. Their jobs only hold the chunk and a copy of the rules, not the scatter,
+	// so it can be moved at any time.
+	~ForestScatter();
+	ForestScatter(ForestScatter&&) = default;
+	ForestScatter& operator=(ForestScatter&&) = default;
+
+	// Rules are applied in the order they were added. The first update() copies the rules and keepOut for
+	// generating chunks, so changes after it have no effect.
+	void addRule(const ScatterRule& rule);
+
+	// Start generating the chunks the camera has come close to, and drop the ones it has left behind.
+	// Returns true when the set of generated chunks changed, and the instances need to be refilled.
+	bool update(const glm::vec3& cameraPos);
+	// Replace the instances of every rule's model with the instances in the generated chunks.
+	void fillInstances(InstanceRenderer& renderer) const;
+
+	size_t loadedChunks() const;
+	size_t pendingChunks() const;
+
+	// The instance transforms of each rule in one chunk.
+	std::vector<std::vector<glm::mat4>> generateChunk(int32_t chunkX, int32_t chunkZ) const;
+
+private:
+	struct Chunk {
+		int32_t x{ 0 };
+		int32_t z{ 0 };
+		JobSystem::JobHandle job{};
+		std::vector<std::vector<glm::mat4>> instances{};
+	};
+
+	// Everything a chunk is generated from. The first update() takes a copy, which the chunk jobs share.
+	struct Layout {
+		uint32_t seed{ 0 };
+		float chunkSize{ 0 };
+		std::vector<ScatterRule> rules{};
+		std::vector<glm::vec3> keepOut{};
+	};
+
+	static uint64_t chunkKey(int32_t x, int32_t z);
+	static std::vector<std::vector<glm::mat4>> scatterChunk(const Layout& layout, int32_t chunkX, int32_t chunkZ);
+
+	uint32_t m_seed;
+	float m_chunkSize;
+	float m_loadRadius;
+	float m_unloadRadius;
+	std::vector<ScatterRule> m_rules{};
+	std::shared_ptr<const Layout> m_layout{};
+	std::unordered_map<uint64_t, std::shared_ptr<Chunk>> m_chunks{};
+};
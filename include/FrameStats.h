@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+
+/**
+ * @brief Counters collected while updating and rendering a single frame, so the cost of each stage
+ * can be measured. Reset at the start of every frame.
+ */
+struct FrameStats {
+	// The number of scene nodes whose world matrix had to be recomputed this frame.
+	uint32_t recomputedNodes{ 0 };
+	// Frustum culling: scene nodes skipped along with their whole subtree, and meshes drawn or skipped.
+	uint32_t culledNodes{ 0 };
+	uint32_t visibleMeshes{ 0 };
+	uint32_t culledMeshes{ 0 };
+	// Entities in an EntityStore whose bounds were outside the view volume.
+	uint32_t culledEntities{ 0 };
+	// Occlusion culling: subtrees, meshes and entities skipped because occluders hide them, and the CPU
+	// time spent rasterizing the occluders.
+	uint32_t occluded{ 0 };
+	float occlusionMilliseconds{ 0 };
+	// Hardware occlusion queries: queries issued, results read back and how many of those said hidden, and
+	// the average number of frames those results took to arrive.
+	uint32_t queriesIssued{ 0 };
+	uint32_t queryResults{ 0 };
+	uint32_t queryOccluded{ 0 };
+	float queryLatencyFrames{ 0 };
+	// Render queue submission: draw calls issued, and how often the program, textures and VAO had to change.
+	uint32_t drawCalls{ 0 };
+	uint32_t programChanges{ 0 };
+	uint32_t textureChanges{ 0 };
+	uint32_t vaoChanges{ 0 };
+	// Meshes drawn through multi-draw indirect calls, and the CPU time spent submitting the queue.
+	uint32_t indirectDraws{ 0 };
+	float submitMilliseconds{ 0 };
+	// Per-frame data written to the stream buffer, and the time spent waiting for the GPU to release its
+	// region.
+	uint32_t streamBytes{ 0 };
+	float streamWaitMilliseconds{ 0 };
+	// Triangles queued at their chosen level of detail, and how many there would have been at full detail.
+	uint32_t triangles{ 0 };
+	uint32_t fullDetailTriangles{ 0 };
+	// Meshlets of meshes drawn at full detail: drawn, skipped for facing away from the camera, and skipped
+	// for being outside the view volume.
+	uint32_t meshletsVisible{ 0 };
+	uint32_t meshletsConeCulled{ 0 };
+	uint32_t meshletsFrustumCulled{ 0 };
+	// Distant objects drawn as impostor quads instead of meshes.
+	uint32_t impostors{ 0 };
+	// Copies of instanced models drawn.
+	uint32_t instances{ 0 };
+	// Forest scatter: chunks generated and ready to draw, and how many finished generating this frame.
+	uint32_t chunksLoaded{ 0 };
+	uint32_t chunksGenerated{ 0 };
+	// World streaming: cells uploaded and being loaded, the memory they take, cells uploaded and evicted this
+	// frame, and the longest latency from request to upload of the cells that finished loading this frame.
+	uint32_t cellsResident{ 0 };
+	uint32_t cellsLoading{ 0 };
+	uint32_t cellsUploaded{ 0 };
+	uint32_t cellsEvicted{ 0 };
+	float streamingRamMegabytes{ 0 };
+	float streamingVramMegabytes{ 0 };
+	float cellLoadMilliseconds{ 0 };
+
+	void reset();
+	void print(std::ostream& out) const;
+};
+
+// The stats for the frame currently being rendered.
+FrameStats& frameStats();
@@ -0,0 +1,21 @@
+#pragma once
+#include <glm/ext.hpp>
+#include "Bounds.h"
+
+/**
+ * @brief The six planes of a camera's view volume, used to reject geometry that cannot be on screen.
+ * Each plane is stored as (normal, distance), with the normal pointing into the volume.
+ */
+struct Frustum {
+	glm::vec4 planes[6]{};
+
+	// Extract the frustum planes from a combined projection * view matrix.
+	static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+	// Whether any part of the box or sphere could be inside the frustum. Conservative: boxes near a
+	// corner of the frustum may be reported visible when they are not.
+	bool intersects(const BoundingBox& box) const;
+	bool intersects(const BoundingSphere& sphere) const;
+	// Whether the box is entirely inside the frustum.
+	bool contains(const BoundingBox& box) const;
+};
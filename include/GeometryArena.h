@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include "GpuResource.h"
+
+// The vertex layouts meshes can be stored in. Each has its own arena and VAO. standard is Vertex3D; packed
+// is PackedVertex.
+enum class VertexFormat : uint8_t { standard, packed, count };
+
+// The size in bytes of one vertex of a format.
+uint32_t vertexStride(VertexFormat format);
+
+/**
+ * @brief A mesh's vertices and indices inside a GeometryArena. Indices are relative to baseVertex, so the
+ * range can be moved without rewriting them; draws add firstIndex and baseVertex to their own offsets.
+ * firstIndex counts in indices of the range's own width, indexSize bytes (2 or 4).
+ */
+struct GeometryRange {
+	uint32_t baseVertex{ 0 };
+	uint32_t vertexCount{ 0 };
+	uint32_t firstIndex{ 0 };
+	uint32_t indexCount{ 0 };
+	uint32_t indexSize{ 4 };
+};
+
+/**
+ * @brief Sub-allocates the geometry of every mesh with one vertex format out of a single vertex buffer and a
+ * single index buffer, read by a single VAO, so consecutive draws don't have to switch VAOs. The index buffer
+ * holds 16-bit and 32-bit indices side by side, each range aligned to its own width.
+ *
+ * Freed ranges go back on a free list and are reused by later allocations. When the buffers are full they
+ * are replaced by bigger ones, and when freed holes waste too much of them compact() packs the live ranges
+ * into new buffers. Either way the VAO keeps its id and every live range is updated in place. Ranges may
+ * be freed on any thread; everything else must happen on the GL thread.
+ */
+class GeometryArena {
+public:
+	explicit GeometryArena(VertexFormat format);
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+
+	// Copy a mesh's vertices (in the arena's format) and indices (indexSize bytes each) into the arena. The
+	// range is freed once the last pointer to it goes away.
+	std::shared_ptr<const GeometryRange> allocate(const void* vertices, uint32_t vertexCount,
+		const void* indices, uint32_t indexCount, uint32_t indexSize);
+
+	// The VAO that reads the arena's buffers.
+	uint32_t vao() const;
+	// Point the bound VAO's vertex attributes and element buffer at the arena's buffers, for VAOs that add
+	// attributes of their own (such as per-instance ones).
+	void bindBuffers() const;
+	// Changes each time the arena's buffers are replaced, so VAOs set up with bindBuffers() know to set up
+	// again.
+	uint32_t generation() const;
+
+	// Pack the live ranges into new buffers if the holes between them waste more than the given fraction
+	// of the space in use. Returns whether it did.
+	bool compact(float maxWaste = 0.25f);
+
+	size_t liveRanges() const;
+	// Print the arena's capacity, use and fragmentation, and how many meshes use each index width.
+	void printStats(std::ostream& out) const;
+
+private:
+	// Free space in one of the buffers, in vertices or index bytes.
+	struct Block {
+		uint32_t offset;
+		uint32_t size;
+	};
+	class FreeList {
+	public:
+		void reset(uint32_t capacity, uint32_t used);
+		// The offset of a free block of the given size and alignment, taken first-fit, or capacity if there
+		// isn't one.
+		uint32_t allocate(uint32_t size, uint32_t alignment = 1);
+		void free(uint32_t offset, uint32_t size);
+		uint32_t capacity() const;
+		uint32_t used() const;
+		// The free space that isn't at the end of the buffer.
+		uint32_t holes() const;
+		size_t blocks() const;
+
+	private:
+		std::vector<Block> m_blocks{};
+		uint32_t m_capacity{ 0 };
+		uint32_t m_used{ 0 };
+	};
+
+	void release(GeometryRange* range);
+	// Replace the buffers with ones of the given capacities (in vertices and index bytes), copying the live
+	// ranges to their start.
+	void rebuild(uint32_t vertexCapacity, uint32_t indexBytes);
+
+	VertexFormat m_format;
+	GlVertexArray m_vao{};
+	GlBuffer m_vertices{};
+	GlBuffer m_indices{};
+	FreeList m_freeVertices{};
+	FreeList m_freeIndexBytes{};
+	std::vector<GeometryRange*> m_live{};
+	uint32_t m_generation{ 0 };
+	uint32_t m_compactions{ 0 };
+	mutable std::mutex m_mutex{};
+};
+
+// The arena for a vertex format, created on first use. Needs a current GL context.
+GeometryArena& geometryArena(VertexFormat format = VertexFormat::standard);
+
+// Compact every arena that has been created, whatever its vertex format. Returns how many were packed.
+uint32_t compactGeometryArenas(float maxWaste = 0.25f);
+
+// Print the stats of every arena that has been created.
+void printGeometryArenaStats(std::ostream& out);
@@ -0,0 +1,149 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// The kinds of OpenGL object a GpuHandle can own.
+enum class GpuObjectType : uint8_t { buffer, vertexArray, texture, program, framebuffer, renderbuffer, query, count };
+
+// What the VRAM held by GPU objects is used for, for the accounting table.
+enum class VramCategory : uint8_t { vertex, index, texture, mipLevels, renderTarget, stream, count };
+
+/**
+ * @brief Tracks every OpenGL object created through a GpuHandle: how many are alive, how much VRAM they hold
+ * by category, and the ones waiting to be deleted.
+ *
+ * A handle that goes away may still be in use by commands the GPU hasn't run yet, so it is retired instead
+ * of deleted. endFrame() puts a fence after the frame's commands for everything retired during the frame,
+ * and deletes each batch once its fence has signalled. Retiring is thread-safe, so handles may be dropped
+ * on any thread; everything else must happen on the GL thread.
+ */
+class GpuResources {
+public:
+	struct Accounting {
+		VramCategory category{ VramCategory::count };
+		size_t bytes{ 0 };
+	};
+
+	// Generate a new object, and count a live one (generated here or not) in the table.
+	uint32_t generate(GpuObjectType type);
+	void track(GpuObjectType type);
+	void retire(GpuObjectType type, uint32_t id, const std::array<Accounting, 2>& accounting);
+	// Record a change in the VRAM held by a live object.
+	void account(VramCategory category, int64_t bytes);
+
+	// Fence the objects retired this frame, and delete the ones whose fences have signalled. Call once per
+	// frame after the frame's draws, on the GL thread.
+	void endFrame();
+	// Wait for the GPU and delete everything retired, e.g. before the context goes away.
+	void flush();
+
+	size_t bytes(VramCategory category) const;
+	size_t totalBytes() const;
+	size_t liveObjects(GpuObjectType type) const;
+	// Print the accounting table: live objects by type, and VRAM by category.
+	void printTable(std::ostream& out) const;
+
+private:
+	struct Retired {
+		GpuObjectType type;
+		uint32_t id;
+		std::array<Accounting, 2> accounting;
+	};
+	struct FencedBatch {
+		void* fence;
+		std::vector<Retired> objects;
+	};
+
+	void destroy(const Retired& object);
+
+	mutable std::mutex m_mutex{};
+	std::array<size_t, static_cast<size_t>(GpuObjectType::count)> m_liveObjects{};
+	std::array<size_t, static_cast<size_t>(VramCategory::count)> m_bytes{};
+	std::vector<Retired> m_retired{};
+	std::vector<FencedBatch> m_fenced{};
+};
+
+// The process-wide GPU resource table.
+GpuResources& gpuResources();
+
+/**
+ * @brief Owns one OpenGL object. Move-only: the object is retired to GpuResources when the handle is
+ * destroyed or reset, and deleted once the GPU has finished with it.
+ */
+template <GpuObjectType Type>
+class GpuHandle {
+public:
+	GpuHandle() = default;
+	// Take ownership of an object that was created directly, such as a linked program.
+	explicit GpuHandle(uint32_t id) : m_id{ id } {
+		if (m_id != 0) {
+			gpuResources().track(Type);
+		}
+	}
+	GpuHandle(const GpuHandle&) = delete;
+	GpuHandle& operator=(const GpuHandle&) = delete;
+	GpuHandle(GpuHandle&& other) noexcept : m_id{ other.m_id }, m_accounting{ other.m_accounting } {
+		other.m_id = 0;
+		other.m_accounting = {};
+	}
+	GpuHandle& operator=(GpuHandle&& other) noexcept {
+		if (this != &other) {
+			reset();
+			m_id = other.m_id;
+			m_accounting = other.m_accounting;
+			other.m_id = 0;
+			other.m_accounting = {};
+		}
+		return *this;
+	}
+	~GpuHandle() {
+		reset();
+	}
+
+	// Generate a new object of this type.
+	static GpuHandle create() {
+		return GpuHandle{ gpuResources().generate(Type) };
+	}
+
+	uint32_t id() const {
+		return m_id;
+	}
+	explicit operator bool() const {
+		return m_id != 0;
+	}
+
+	// Set how much VRAM the object holds for one category, replacing the amount recorded before. An object
+	// can be counted under two categories, e.g. a texture's base level and its mipmaps.
+	void account(VramCategory category, size_t bytes) {
+		for (auto& slot : m_accounting) {
+			if (slot.category == category || slot.category == VramCategory::count) {
+				gpuResources().account(category, static_cast<int64_t>(bytes) - static_cast<int64_t>(slot.bytes));
+				slot = GpuResources::Accounting{ category, bytes };
+				return;
+			}
+		}
+	}
+
+	void reset() {
+		if (m_id != 0) {
+			gpuResources().retire(Type, m_id, m_accounting);
+			m_id = 0;
+			m_accounting = {};
+		}
+	}
+
+private:
+	uint32_t m_id{ 0 };
+	std::array<GpuResources::Accounting, 2> m_accounting{};
+};
+
+using GlBuffer = GpuHandle<GpuObjectType::buffer>;
+using GlVertexArray = GpuHandle<GpuObjectType::vertexArray>;
+using GlTexture = GpuHandle<GpuObjectType::texture>;
+using GlProgram = GpuHandle<GpuObjectType::program>;
+using GlFramebuffer = GpuHandle<GpuObjectType::framebuffer>;
+using GlRenderbuffer = GpuHandle<GpuObjectType::renderbuffer>;
+using GlQuery = GpuHandle<GpuObjectType::query>;
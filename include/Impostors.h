@@ -0,0 +1,60 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "GpuResource.h"
+#include "SceneObject.h"
+#include "ShaderProgram.h"
+
+/**
+ * @brief A model baked into color and normal atlases, seen from a grid of directions laid out with an
+ * octahedral mapping. instances are the world-space centers and radii to draw it at this frame.
+ */
+struct Impostor {
+	GlTexture colorTexture{};
+	GlTexture normalTexture{};
+	uint32_t gridSize{ 0 };
+	uint32_t cellResolution{ 0 };
+	// The transparent border around the view in each cell, in atlas texels.
+	uint32_t cellPadding{ 0 };
+	// The radius of the model's bounds when it was baked, which is the half-size of each view.
+	float radius{ 0 };
+	std::vector<glm::vec4> instances{};
+};
+
+/**
+ * @brief Bakes models into octahedral impostors, and draws distant copies of them as one camera-facing
+ * quad each. A quad blends the four baked views nearest to the direction it is seen from, and is lit with
+ * the baked normals, so it keeps roughly the model's shading for a tiny fraction of its triangles.
+ */
+class ImpostorRenderer {
+public:
+	// Objects farther than this from the camera should be drawn as impostors.
+	float switchDistance{ 60 };
+
+	// Load the shaders and quad buffers. Needs a current GL context.
+	void load();
+	// Render an object, as currently placed in the world, from gridSize x gridSize directions into new
+	// atlases. Returns the id of the impostor.
+	uint32_t bake(SceneObject& object, uint32_t gridSize = 8, uint32_t cellResolution = 128);
+
+	// Forget last frame's instances.
+	void beginFrame();
+	// Draw an impostor this frame, centered at a world position. scale multiplies the baked size.
+	void addInstance(uint32_t impostor, const glm::vec3& center, float scale = 1);
+	// Draw every instance added this frame.
+	void draw(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos,
+		const glm::vec3& directionalLight, const glm::vec3& ambientColor);
+	// Write each impostor's atlases to <directory>/impostor<id>_color.tga and _normal.tga.
+	void dumpAtlases(const std::string& directory) const;
+
+	size_t impostorCount() const;
+
+private:
+	std::vector<Impostor> m_impostors{};
+	ShaderProgram m_bakeProgram{};
+	ShaderProgram m_drawProgram{};
+	GlVertexArray m_quadVao{};
+	GlBuffer m_quadVbo{};
+};
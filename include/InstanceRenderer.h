@@ -0,0 +1,68 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "Bounds.h"
+#include "Frustum.h"
+#include "GpuResource.h"
+#include "Mesh.h"
+#include "SceneObject.h"
+#include "ShaderProgram.h"
+
+/**
+ * @brief Draws many copies of the same models with one glDrawElementsInstanced call per mesh and level of
+ * detail, instead of one SceneObject tree and one draw per mesh per copy.
+ *
+ * A registered model is flattened into its meshes and their matrices relative to the model's root. Each
+ * frame, the instances inside the frustum are grouped by level of detail and their transforms written to
+ * the stream buffer. Each model has its own VAO per vertex format, reading that format's geometry arena plus
+ * the transforms as a per-instance mat4 attribute, so the arenas' shared VAOs stay free of instance state.
+ */
+class InstanceRenderer {
+public:
+	// Load the instanced shader program. Needs a current GL context.
+	void load();
+	// The program instanced models are drawn with, for setting the frame's lighting uniforms.
+	ShaderProgram& program();
+
+	// Register a model to be instanced. Its root position, orientation and scale are ignored: each instance's
+	// transform takes their place. Returns the model's id.
+	uint32_t registerModel(const SceneObject& model);
+	// Add an instance of a model with the given world transform. Returns the instance's index in the model.
+	uint32_t addInstance(uint32_t model, const glm::mat4& transform);
+	void setInstance(uint32_t model, uint32_t instance, const glm::mat4& transform);
+	void clearInstances(uint32_t model);
+	size_t instanceCount(uint32_t model) const;
+
+	// Draw every instance inside the frustum. cameraPos and projectionScale (projection[1][1]) choose each
+	// instance's level of detail.
+	void draw(const Frustum& frustum, const glm::vec3& cameraPos, float projectionScale);
+
+private:
+	struct Part {
+		Mesh mesh;
+		glm::mat4 matrix;
+	};
+	struct Model {
+		std::vector<Part> parts{};
+		// The model's bounds in its own space, for culling instances.
+		BoundingBox bounds{};
+		std::vector<glm::mat4> instances{};
+		// Per vertex format: the arena's vertex attributes plus the instance attribute, and the arena
+		// generation it was set up for.
+		std::array<GlVertexArray, static_cast<size_t>(VertexFormat::count)> vaos{};
+		std::array<uint32_t, static_cast<size_t>(VertexFormat::count)> arenaGenerations{};
+		// Scratch for the visible instances, grouped by level of detail.
+		std::vector<std::vector<glm::mat4>> visibleByLod{};
+		std::vector<glm::mat4> upload{};
+	};
+
+	void collectParts(Model& model, const SceneObject& object, const glm::mat4& parentMatrix);
+	// Bind the model's VAO for a vertex format, setting it up first if the arena's buffers are new to it.
+	// Leaves the buffer holding the instance transforms bound to GL_ARRAY_BUFFER, for setInstanceAttributes.
+	void bindVertexArray(Model& model, VertexFormat format, uint32_t instanceBuffer);
+
+	std::vector<Model> m_models{};
+	ShaderProgram m_program{};
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A work-stealing thread pool for spreading CPU work across cores.
+ *
+ * Each worker owns a deque of jobs: it pushes and pops its own work at the back, and when it runs dry it
+ * steals from the front of the other workers' deques. Jobs submitted from outside the pool (e.g. the main
+ * thread) go to a shared injection queue that workers steal from the same way. A job can depend on other
+ * jobs, forming a small task graph; it is only queued once all of its dependencies have finished.
+ *
+ * Threads that wait() on a job run other queued jobs in the meantime, so waiting never wastes a core, and
+ * a pool with zero workers still works: everything runs on the waiting thread, or in progress() for threads
+ * that poll instead of waiting.
+ *
+ * Jobs must not make OpenGL calls, since only the thread that owns the window has a GL context.
+ */
+class JobSystem {
+public:
+	struct Job;
+	using JobHandle = std::shared_ptr<Job>;
+
+	explicit JobSystem(uint32_t workerCount);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// Schedule work to run once every job in dependencies has finished.
+	JobHandle submit(std::function<void()> work, std::initializer_list<JobHandle> dependencies = {});
+	JobHandle submit(std::function<void()> work, const std::vector<JobHandle>& dependencies);
+	// Block until the job has finished, running other queued jobs while waiting. If the job threw, its
+	// exception is rethrown here; it still counts as finished, so jobs that depend on it run anyway.
+	void wait(const JobHandle& job);
+	static bool isDone(const JobHandle& job);
+	// For threads that poll their jobs with isDone() instead of waiting on them, once per frame or so. A pool
+	// without workers only runs jobs on threads that wait, so this runs one queued job on the calling
+	// thread; with workers it returns at once.
+	void progress();
+
+	// Call work(begin, end) over the range [0, count) in chunks of at most grainSize items, spread across
+	// the pool, and return once every chunk has finished. The calling thread runs chunks too. If any chunk
+	// throws, the first exception is rethrown after the rest have finished.
+	void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& work);
+
+	uint32_t workerCount() const;
+
+private:
+	struct WorkQueue {
+		std::mutex mutex{};
+		std::deque<JobHandle> jobs{};
+	};
+
+	void schedule(JobHandle job);
+	void finish(const JobHandle& job);
+	JobHandle takeJob(size_t queueIndex);
+	bool runOne();
+	void workerLoop(uint32_t index);
+
+	std::vector<std::thread> m_workers{};
+	// One queue per worker, followed by the injection queue for jobs submitted from other threads.
+	std::vector<std::unique_ptr<WorkQueue>> m_queues{};
+	std::atomic<uint32_t> m_queuedJobs{ 0 };
+	std::atomic<bool> m_running{ true };
+	std::mutex m_sleepMutex{};
+	std::condition_variable m_wake{};
+};
+
+// Cap the number of worker threads in the process-wide job system. Must be called before the first
+// call to jobSystem(); by default one worker is started per hardware thread, minus one for the main thread.
+void configureJobSystem(uint32_t maxWorkers);
+// The process-wide job system, started on first use.
+JobSystem& jobSystem();
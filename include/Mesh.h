@@ -1,7 +1,12 @@
 #pragma once
+#include <memory>
 #include <vector>
+#include "GeometryArena.h"
 #include "Texture.h"
 #include "ShaderProgram.h"
+#include "Bounds.h"
+
+struct MeshletSet;
 
 struct Vertex3D {
 	float x;
@@ -16,13 +21,97 @@ struct Vertex3D {
 	float nz;
 };
 
+/**
+ * @brief A 16-byte vertex: the position quantized to 16 bits per axis over the mesh's bounding box, the
+ * normal octahedral-encoded in two signed 16-bit values, and the texture coordinates as half floats.
+ */
+struct PackedVertex {
+	uint16_t x;
+	uint16_t y;
+	uint16_t z;
+	uint16_t padding;
+
+	int16_t octX;
+	int16_t octY;
+
+	uint16_t u;
+	uint16_t v;
+};
+static_assert(sizeof(PackedVertex) == 16);
+
+/**
+ * @brief How a vertex shader turns a mesh's stored vertices back into its own space: position = offset +
+ * stored * scale, with octahedral normals when offset.w is 1. Passed to shaders in vertex attributes 7 and 8:
+ * constant values set per mesh by bindDecode(), or per-instance arrays where a draw covers many meshes.
+ */
+struct VertexDecode {
+	glm::vec4 offset{ 0, 0, 0, 0 };
+	glm::vec4 scale{ 1, 1, 1, 0 };
+};
+
+/**
+ * @brief Vertex and face data for a mesh that lives in RAM and has not been uploaded to the GPU yet.
+ */
+struct MeshData {
+	std::vector<Vertex3D> vertices{};
+	std::vector<uint32_t> faces{};
+	std::vector<Texture> textures{};
+	// Simplified versions of faces, from most to least detailed, indexing the same vertices.
+	std::vector<std::vector<uint32_t>> lodFaces{};
+	// The material is drawn from both sides, so back-facing triangles can't be culled.
+	bool twoSided{ false };
+	// The full-detail triangles split into meshlets, for meshes big enough to cull in parts. May be null.
+	std::shared_ptr<const MeshletSet> meshlets{};
+};
+
+// A range of a mesh's index buffer that draws it at one level of detail.
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
 struct Mesh {
+	// Where the mesh's vertices and indices live in the geometry arena. Copies of a mesh share the range,
+	// which is freed along with the last copy. vao is the arena's vertex array, shared by every mesh in it.
+	std::shared_ptr<const GeometryRange> geometry;
 	uint32_t vao;
+	VertexFormat format;
+	VertexDecode decode;
+	uint32_t vertexCount;
 	uint32_t faceCount;
+	// The mesh's index type: GL_UNSIGNED_SHORT when every vertex can be reached with 16 bits, otherwise
+	// GL_UNSIGNED_INT.
+	uint32_t indexType;
 	std::vector<Texture> textures;
+	// The mesh's extent in its own local space.
+	BoundingBox bounds;
+	BoundingSphere boundingSphere;
+	// Every level of detail, starting with the full mesh, relative to the start of the mesh's indices.
+	std::vector<MeshLod> lods;
+	// The full-detail triangles split into meshlets, shared by copies of the mesh; null for meshes that are
+	// always drawn whole.
+	std::shared_ptr<const MeshletSet> meshlets;
+	// The level chosen by the last selectLod, remembered so the choice only changes past a margin.
+	mutable uint32_t currentLod{ 0 };
 
-	Mesh(const std::vector<Vertex3D>& vertices, const std::vector<uint32_t>& faces, std::vector<Texture> textures);
+	Mesh(const std::vector<Vertex3D>& vertices, const std::vector<uint32_t>& faces, std::vector<Texture> textures,
+		const std::vector<std::vector<uint32_t>>& lodFaces = {}, VertexFormat format = VertexFormat::standard,
+		std::shared_ptr<const MeshletSet> meshlets = {});
 	void drawMesh(ShaderProgram& program) const;
+	// Set the constant vertex attributes that tell the shader how to decode this mesh's vertices.
+	void bindDecode() const;
+	// The byte offset of a level of detail's first index in the arena's index buffer, and the vertex its
+	// indices count from, for glDrawElementsBaseVertex.
+	const void* indexOffset(const MeshLod& lod) const;
+	int32_t baseVertex() const;
+	// The size of one index, in bytes, for a mesh with the given number of vertices.
+	static uint32_t indexSizeFor(size_t vertexCount);
+	// Choose the level of detail for a mesh whose bounding sphere covers the given fraction of the screen
+	// height, with hysteresis so a mesh near a threshold doesn't flicker between levels.
+	const MeshLod& selectLod(float screenSize) const;
+	// The level of detail for a screen size without hysteresis, for callers that can't keep per-mesh state
+	// (such as instances). May be past the last level a mesh has.
+	static uint32_t lodLevelFor(float screenSize);
 
 	static Mesh square(std::vector<Texture> textures);
 };
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Mesh.h"
+
+// How well an index list uses a FIFO post-transform vertex cache. ACMR is the average number of cache misses
+// (vertex shader runs) per triangle: 3 for a triangle soup, about 0.5 at best for a regular grid. ATVR is
+// the misses per vertex referenced, where 1 means every vertex is transformed exactly once.
+struct VertexCacheStats {
+	float acmr{ 0 };
+	float atvr{ 0 };
+};
+
+// The vertex cache stats of a mesh before and after optimizeMesh.
+struct MeshOptimization {
+	VertexCacheStats before{};
+	VertexCacheStats after{};
+};
+
+// Simulate drawing an index list through a FIFO vertex cache of the given size.
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& faces, size_t vertexCount, uint32_t cacheSize = 16);
+
+// Reorder triangles for vertex cache locality with Tipsify: fan out around one vertex at a time, moving on to
+// the neighbour that is most likely still in the cache. Runs in linear time.
+std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& faces, size_t vertexCount,
+	uint32_t cacheSize = 16);
+
+// Reorder a cache-optimized index list to reduce overdraw: split it into clusters wherever the cache starts
+// over (or where the cluster so far is already within threshold of the whole cluster's ACMR), then draw the
+// clusters that face away from the mesh's centre first, since those are the ones that end up in front from
+// most directions. The ACMR gets worse by at most threshold.
+void optimizeOverdraw(const std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces, uint32_t cacheSize = 16,
+	float threshold = 1.05f);
+
+// Renumber vertices in the order the index list first uses them, so vertex fetches walk the vertex buffer
+// forwards. Vertices no triangle uses are dropped.
+void optimizeVertexFetch(std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces);
+
+/**
+ * @brief Runs optimizeVertexCache, optimizeOverdraw and optimizeVertexFetch on a mesh, in that order, and
+ * measures the vertex cache before and after. The triangles and vertices stay the same apart from their
+ * order (and unused vertices), so this must run before anything that indexes the mesh's vertices, such as
+ * simplifyMesh.
+ */
+MeshOptimization optimizeMesh(std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces, uint32_t cacheSize = 16);
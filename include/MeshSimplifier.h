@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Mesh.h"
+
+/**
+ * @brief Builds a chain of simplified index buffers for a mesh with quadric error metric edge collapses.
+ * Each ratio is a fraction of the original triangle count, in decreasing order; the result has an index
+ * list per ratio, each simplified further from the one before, except that a level that would keep more
+ * than 85% of the one before it is left out.
+ *
+ * Vertices are only ever collapsed onto existing neighbours, so every level indexes the original vertex
+ * list and can share its vertex buffer. Connectivity is taken from positions, so the split copies of a
+ * vertex on a UV or normal seam move together, each onto the copy on its own side of the seam; a seam
+ * vertex can only slide along its seam. Vertices on open edges only slide along them, and ones where open
+ * edges meet never move. A level may stop above its target if nothing else can collapse without flipping
+ * a triangle.
+ */
+std::vector<std::vector<uint32_t>> simplifyMesh(const std::vector<Vertex3D>& vertices,
+	const std::vector<uint32_t>& faces, const std::vector<float>& ratios);
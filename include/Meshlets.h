@@ -0,0 +1,51 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <cstdint>
+#include <vector>
+#include "Mesh.h"
+
+// A run of a mesh's full-detail triangles, relative to the start of its indices.
+struct Meshlet {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+/**
+ * @brief A mesh's full-detail triangles split into meshlets of a few dozen vertices each, so the parts of a
+ * big mesh that face away from the camera or are off screen can be skipped instead of drawing it whole.
+ *
+ * Each meshlet has a bounding sphere and a normal cone (the axis its triangles face around, and the sine of
+ * the cone's half angle, above 1 if the meshlet can't be culled by facing). They are stored as separate
+ * arrays per component, padded to a multiple of 4, so cullMeshlets can test 4 meshlets at a time.
+ */
+struct MeshletSet {
+	std::vector<Meshlet> meshlets{};
+	std::vector<float> centerX{}, centerY{}, centerZ{}, radius{};
+	std::vector<float> axisX{}, axisY{}, axisZ{}, coneCutoff{};
+
+	size_t size() const;
+};
+
+// How many meshlets cullMeshlets rejected, and why. Meshlets outside the frustum aren't tested for facing.
+struct MeshletCullCounts {
+	uint32_t visible{ 0 };
+	uint32_t coneCulled{ 0 };
+	uint32_t frustumCulled{ 0 };
+};
+
+// Split a mesh's triangles, in their current order, into meshlets of at most maxVertices vertices and
+// maxTriangles triangles; the order should already be optimized for the vertex cache, which keeps meshlets
+// compact. Meshes that are two-sided get no normal cones.
+MeshletSet buildMeshlets(const std::vector<Vertex3D>& vertices, const std::vector<uint32_t>& faces, bool twoSided,
+	uint32_t maxVertices = 64, uint32_t maxTriangles = 124);
+
+// Reject the meshlets that are outside the frustum or face entirely away from the camera, both given in the
+// mesh's local space (planes normalized, pointing inwards). Replaces out with the surviving index ranges,
+// merging meshlets that follow each other into one range. Uses SSE2 when the build enables it.
+MeshletCullCounts cullMeshlets(const MeshletSet& set, const glm::vec4 (&planes)[6], const glm::vec3& camera,
+	std::vector<Meshlet>& out);
+// The same, one meshlet at a time without SIMD. bench/MeshletBench checks both give the same results.
+MeshletCullCounts cullMeshletsScalar(const MeshletSet& set, const glm::vec4 (&planes)[6], const glm::vec3& camera,
+	std::vector<Meshlet>& out);
+// The instruction set cullMeshlets was compiled for: "SSE2" or "scalar".
+const char* meshletKernelName();
@@ -0,0 +1,88 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <cstdint>
+#include <vector>
+#include "Bounds.h"
+#include "JobSystem.h"
+
+/**
+ * @brief Simplified geometry for an object that hides what is behind it, in world space. Occluders must
+ * fit inside the object they stand in for, or they will hide things that should be visible.
+ */
+struct Occluder {
+	std::vector<glm::vec3> positions{};
+	std::vector<uint32_t> indices{};
+	// The world-space bounds of positions. Filled in by addOccluder if left empty.
+	BoundingBox bounds{};
+
+	// A box occluder: a box in an object's local space, placed in the world with the object's model matrix.
+	static Occluder box(const BoundingBox& localBounds, const glm::mat4& model);
+};
+
+/**
+ * @brief A CPU occlusion culler. Occluders are rasterized into a low-resolution depth buffer, which is
+ * reduced to min/max depth pyramids; bounds are then tested against the coarsest pyramid level whose
+ * texels cover them with only a few reads.
+ *
+ * Rasterization is split into horizontal bands that run as jobs on the job system, so it can overlap
+ * with other CPU work (and with the GPU still drawing the previous frame) until the results are needed.
+ * Triangles crossing the near plane are skipped, which can only make the culler hide less. So are occluders
+ * the eye is inside of or close to: the near plane would cut into them, leaving their far side to hide
+ * everything behind it.
+ */
+class OcclusionCuller {
+public:
+	// The depth buffer size. The width is rounded up to a multiple of 4.
+	OcclusionCuller(uint32_t width, uint32_t height);
+
+	void addOccluder(Occluder occluder);
+	void clearOccluders();
+	size_t occluderCount() const;
+
+	// Start rasterizing the occluders as seen through viewProjection from the eye. Occluders whose bounds
+	// are within nearMargin of the eye are left out. The returned job finishes once the depth pyramids are
+	// ready; wait on it before calling isOccluded. Occluders must not change until then.
+	JobSystem::JobHandle rasterize(JobSystem& jobs, const glm::mat4& viewProjection, const glm::vec3& eye,
+		float nearMargin);
+	// Whether world-space bounds are completely hidden behind the occluders.
+	bool isOccluded(const BoundingBox& bounds) const;
+
+	// The CPU time spent by the last rasterize(), summed over every job.
+	float lastRasterMilliseconds() const;
+
+private:
+	// Occluder vertices after projection: x and y in depth buffer pixels, z in [0, 1]. Vertices behind the
+	// near plane are marked invalid.
+	struct ScreenVertex {
+		float x;
+		float y;
+		float z;
+		bool valid;
+	};
+	struct LevelSize {
+		uint32_t width;
+		uint32_t height;
+	};
+
+	void projectVertices();
+	void rasterizeBand(uint32_t firstRow, uint32_t endRow);
+	void buildPyramids();
+
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_bandHeight{ 16 };
+	std::vector<Occluder> m_occluders{};
+	glm::mat4 m_viewProjection{ 1 };
+	glm::vec3 m_eye{ 0, 0, 0 };
+	float m_nearMargin{ 0 };
+	// Projected vertices of every occluder, in order, and the offset of each occluder's first one.
+	std::vector<ScreenVertex> m_screenVertices{};
+	std::vector<uint32_t> m_vertexOffsets{};
+	// Level 0 is the rasterized depth buffer; each further level halves the resolution.
+	std::vector<std::vector<float>> m_minDepth{};
+	std::vector<std::vector<float>> m_maxDepth{};
+	std::vector<LevelSize> m_levelSizes{};
+	// The time spent in each job of the last rasterize(): projection, every band, then the pyramids.
+	std::vector<int64_t> m_jobNanoseconds{};
+	float m_lastRasterMilliseconds{ 0 };
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <cstdint>
+#include <vector>
+#include "Bounds.h"
+#include "GpuResource.h"
+#include "ShaderProgram.h"
+
+/**
+ * @brief Temporally coherent hardware occlusion queries for a few expensive objects.
+ *
+ * Each tracked object gets a GL_ANY_SAMPLES_PASSED query drawn over its bounding box after the frame's
+ * geometry, with color and depth writes off. Results are only read once the GPU reports them available,
+ * so the CPU never stalls; until then the last known result is used. An object hidden last time is
+ * therefore drawn one frame late when it comes into view.
+ *
+ * In previousFrame mode the CPU skips objects whose last result was hidden. In conditional mode the GPU
+ * decides, with glBeginConditionalRender in no-wait mode: draws go ahead if the query hasn't finished.
+ * Everything used is core OpenGL 3.3, so this also runs on Mesa's software rasterizer.
+ */
+class OcclusionQueries {
+public:
+	enum class Mode {
+		off,
+		previousFrame,
+		conditional,
+	};
+	Mode mode{ Mode::previousFrame };
+
+	// Create the GL objects. Needs a current GL context.
+	void load();
+	// Start tracking an object, identified by any caller-chosen id.
+	void track(uint32_t id);
+	bool isTracked(uint32_t id) const;
+	// Switch to the next mode, returning its name.
+	const char* cycleMode();
+
+	// Read every query result that has become available since the last frame.
+	void beginFrame();
+	// Whether the CPU should draw a tracked object this frame. Always true outside previousFrame mode.
+	bool shouldDraw(uint32_t id) const;
+	// Note that an object is outside the view frustum, so its last result is stale.
+	void markOutside(uint32_t id);
+	// Draw-time wrappers for conditional mode: the object is only rasterized if its last query passed.
+	void beginConditional(uint32_t id);
+	void endConditional(uint32_t id);
+	// Issue a query for an object's world-space bounds, unless one is still in flight. Call after the
+	// frame's geometry is drawn, so it is tested against the final depth buffer. No query is issued while the
+	// eye is within nearMargin of the bounds; the object is treated as visible instead.
+	void issue(uint32_t id, const BoundingBox& bounds, const glm::mat4& viewProjection, const glm::vec3& eye,
+		float nearMargin);
+
+private:
+	struct TrackedQuery {
+		uint32_t id;
+		GlQuery query{};
+		// A query has been issued and its result not yet read.
+		bool pending{ false };
+		// The query object has held at least one result, so conditional rendering can use it.
+		bool issued{ false };
+		bool visible{ true };
+		// The eye was inside the bounds when the last query would have been issued.
+		bool cameraInside{ false };
+		uint64_t issuedFrame{ 0 };
+		bool conditionalActive{ false };
+	};
+
+	TrackedQuery* find(uint32_t id);
+	const TrackedQuery* find(uint32_t id) const;
+
+	std::vector<TrackedQuery> m_queries{};
+	ShaderProgram m_program{};
+	GlVertexArray m_cubeVao{};
+	GlBuffer m_cubeVertices{};
+	GlBuffer m_cubeIndices{};
+	uint64_t m_frame{ 0 };
+	bool m_loaded{ false };
+};
@@ -0,0 +1,174 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+#include "Frustum.h"
+#include "GpuResource.h"
+#include "Mesh.h"
+#include "Meshlets.h"
+#include "ShaderProgram.h"
+#include "StreamBuffer.h"
+#include "Texture.h"
+
+/**
+ * @brief One indexed draw call, with the GL state it needs. Items refer to data that must stay alive
+ * until the queue is submitted: the program, the mesh's texture list, and the model matrix and material.
+ */
+struct DrawItem {
+	// Program, texture set, VAO and depth packed so that sorting by key groups draws that share state,
+	// and orders each group front to back.
+	uint64_t sortKey;
+	ShaderProgram* program;
+	const std::vector<Texture>* textures;
+	uint32_t vao;
+	VertexFormat format;
+	// How to decode the mesh's vertices; belongs to the mesh.
+	const VertexDecode* decode;
+	// The draw's first index in the VAO's index buffer (counted in indices of its type), and the vertex its
+	// indices count from.
+	uint32_t indexType;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t baseVertex;
+	const glm::mat4* model;
+	// Phong material parameters; nullptr uses the queue's default material.
+	const glm::vec4* material;
+};
+
+// One draw of glMultiDrawElementsIndirect, laid out the way GL reads it from the indirect buffer.
+struct DrawElementsIndirectCommand {
+	uint32_t count;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t baseInstance;
+};
+
+// A sort key and the index of the item it belongs to.
+struct SortEntry {
+	uint64_t key;
+	uint32_t item;
+};
+
+// Sorts entries by key with a stable LSD radix sort, one byte per pass. Passes where every key has the
+// same byte are skipped. scratch is resized as needed and can be reused between calls.
+void radixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch);
+
+/**
+ * @brief Collects the frame's draw calls, sorts them to minimize state changes, and submits them,
+ * rebinding only the program, textures, VAO and uniforms that differ from the previous draw.
+ *
+ * With GL 4.3, submission can instead group the sorted items into batches that share textures and material,
+ * vertex format and index type, and issue each batch as one glMultiDrawElementsIndirect call. Each command's base
+ * instance picks its model matrix and vertex decode out of the frame's draw data in the stream buffer, read by an "indirect" variant
+ * of the item's program as per-instance attributes. Items whose program has no indirect variant are still
+ * drawn one at a time.
+ *
+ * Meshes split into meshlets are culled a meshlet at a time when drawn at full detail: only the index ranges
+ * of the meshlets that are in the view volume and face the camera are queued, as one item per range.
+ */
+class RenderQueue {
+public:
+	enum class SubmitMode { loop, multiDrawIndirect };
+
+	// The material set for items that don't have their own.
+	glm::vec4 defaultMaterial{ 0.1, 1.0, 0.3, 4 };
+	// How submit() issues draws. multiDrawIndirect falls back to the loop when the context doesn't
+	// support it.
+	SubmitMode mode{ SubmitMode::loop };
+	// Whether meshes with meshlets have their off-screen and back-facing meshlets skipped.
+	bool meshletCulling{ true };
+
+	// Whether the context has glMultiDrawElementsIndirect with base instances (GL 4.3).
+	static bool multiDrawIndirectSupported();
+	// Draw items queued with program through multi-draw indirect, using indirectProgram: the same shading,
+	// but with each draw's model matrix read from the per-instance mat4 at locations 3 to 6 and multiplied
+	// by its "model" uniform (as light_perspective_instanced.vert does).
+	void addIndirectProgram(ShaderProgram& program, ShaderProgram& indirectProgram);
+	// Switch to the other submit mode, staying on the loop if multi-draw indirect isn't supported. Returns
+	// the new mode's name.
+	const char* cycleMode();
+
+	// Start a new frame. Depth is measured from the camera position, and quantized over [0, maxDepth].
+	// projectionScale is projection[1][1], to turn sizes at a distance into fractions of the screen height.
+	// Meshlets are culled against the frustum.
+	void begin(const glm::vec3& cameraPos, float maxDepth, float projectionScale, const Frustum& frustum);
+	// Queue one mesh, drawn with the given model matrix at the level of detail that suits its size on screen.
+	// worldBounds are the mesh's world-space bounds, for depth sorting and choosing the level of detail.
+	void add(ShaderProgram& program, const Mesh& mesh, const glm::mat4& model, const glm::vec4* material,
+		const BoundingBox& worldBounds);
+	// Order the queued items by their sort keys.
+	void sort();
+	// Issue every queued draw in sorted order, counting state changes and the CPU time taken in the frame
+	// stats.
+	void submit();
+
+	size_t size() const;
+	// Print the average CPU time submit() has taken per frame in each mode.
+	void printTimings(std::ostream& out) const;
+
+private:
+	// The GL state left by the last draw, so the next only changes what differs.
+	struct SubmitState {
+		ShaderProgram* program{ nullptr };
+		const std::vector<Texture>* textures{ nullptr };
+		uint32_t vao{ 0 };
+		const VertexDecode* decode{ nullptr };
+		const glm::mat4* model{ nullptr };
+		const glm::vec4* material{ nullptr };
+	};
+	// A run of sorted items drawn one at a time (first and count index m_order), or a run of commands
+	// drawn by one multi-draw call (first and count index m_commands).
+	struct Batch {
+		ShaderProgram* indirectProgram;
+		VertexFormat format;
+		uint32_t indexType;
+		const std::vector<Texture>* textures;
+		const glm::vec4* material;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	void submitLoop(size_t first, size_t end, SubmitState& state);
+	void submitIndirect(SubmitState& state);
+	// Bind the indirect VAO for a vertex format, setting it up first if the arena's buffers are new to it.
+	void bindIndirectVao(VertexFormat format, SubmitState& state);
+	// Bind a program, if it isn't bound already, and its textures and material.
+	void bindState(ShaderProgram* program, const std::vector<Texture>* textures, const glm::vec4* material,
+		SubmitState& state);
+	ShaderProgram* indirectProgramFor(const ShaderProgram* program) const;
+
+	std::vector<DrawItem> m_items{};
+	std::vector<SortEntry> m_order{};
+	std::vector<SortEntry> m_scratch{};
+	glm::vec3 m_cameraPos{ 0, 0, 0 };
+	float m_maxDepth{ 1 };
+	float m_projectionScale{ 1 };
+	Frustum m_frustum{};
+	// The index ranges of a mesh's meshlets that survived culling.
+	std::vector<Meshlet> m_meshletRanges{};
+
+	std::vector<std::pair<ShaderProgram*, ShaderProgram*>> m_indirectPrograms{};
+	std::vector<Batch> m_batches{};
+	std::vector<DrawElementsIndirectCommand> m_commands{};
+	// What each indirect draw reads through its base instance.
+	struct IndirectDrawData {
+		glm::mat4 model;
+		VertexDecode decode;
+	};
+	std::vector<IndirectDrawData> m_drawData{};
+	// Per vertex format: reads the geometry arena's buffers plus the draw data in the stream buffer, set up
+	// for the arena generation and stream buffer recorded.
+	std::array<GlVertexArray, static_cast<size_t>(VertexFormat::count)> m_indirectVaos{};
+	std::array<uint32_t, static_cast<size_t>(VertexFormat::count)> m_arenaGenerations{};
+	std::array<uint32_t, static_cast<size_t>(VertexFormat::count)> m_drawDataBuffers{};
+	// This frame's commands and draw data in the stream buffer.
+	StreamAllocation m_commandAllocation{};
+	StreamAllocation m_drawDataAllocation{};
+	// Total submit() time and frames submitted, per mode.
+	std::array<double, 2> m_submitMilliseconds{};
+	std::array<uint32_t, 2> m_submitFrames{};
+};
@@ -1,8 +1,30 @@
 #pragma once
 #include <glm/ext.hpp>
+#include <memory>
 #include <vector>
 #include <string>
 #include "Mesh.h"
+#include "Bounds.h"
+#include "Frustum.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+#include "TransformBatch.h"
+
+class SceneObject;
+struct ModelAsset;
+
+/**
+ * @brief One entry of a flattened object hierarchy. Nodes are stored in depth-first order, so a
+ * node's parent always appears before it in the array.
+ */
+struct FlatNode {
+	// The object this node refers to.
+	SceneObject* object;
+	// The index of this node's parent in the flattened array, or -1 for the root.
+	int32_t parent;
+	// One past the index of this node's last descendant, so a whole subtree can be skipped at once.
+	uint32_t subtreeEnd;
+};
 
 /**
  * @brief An object placed in a scene to be rendered. 
@@ -21,6 +43,8 @@ public:
 	std::vector<SceneObject> children{};
 
 	// The object's position, orientation, and scale in world space.
+	// World matrices are cached, so call markDirty() after changing any of these (or center / baseTransform)
+	// once the object has been drawn.
 	glm::vec3 position{0, 0, 0};
 	glm::vec3 orientation{0, 0, 0};
 	glm::vec3 scale{1.0, 1.0, 1.0};
@@ -38,12 +62,72 @@ public:
 	// Some objects from Assimp imports have a "name" field, useful for debugging.
 	std::string name{};
 
+	// The shared model this object was made from, if any, which keeps its meshes and textures in VRAM.
+	std::shared_ptr<const ModelAsset> asset{};
+
 	// Construct a 4x4 model matrix from the object's position, orientation, scale, center, and base transform.
 	glm::mat4 buildModelMatrix() const;
+	// Flatten this object and all its descendants into a contiguous, parent-indexed node array, so the
+	// hierarchy can be traversed without recursion. Must be called again if any descendant's children
+	// are added or removed; the root's own children are re-checked automatically.
+	void flatten();
+	// Flag this object's local matrix for recomputation. Its descendants' world matrices follow automatically.
+	void markDirty();
+	// Bring the world-space model matrix of every node in the hierarchy up to date with a single linear pass.
+	// Only nodes that were marked dirty, or whose ancestor was, are recomputed; returns how many that was.
+	// Separate objects can be updated on different threads.
+	uint32_t updateWorldMatrices();
+	// The world-space bounds of the object and all its descendants, as of the last update.
+	const BoundingBox& worldBounds() const;
+	// The number of nodes in the flattened hierarchy, and the world-space bounds of one node's own meshes
+	// as of the last update.
+	size_t nodeCount() const;
+	const BoundingBox& nodeBounds(size_t node) const;
+	// Whether a node's world matrix changed during the last update.
+	bool nodeMoved(size_t node) const;
 	// Trigger an OpenGL rendering of the object, including its mesh and all its child objects.
-	void drawObject(ShaderProgram& program) const;
+	void drawObject(ShaderProgram& program);
+	// Render the object and its children, skipping any subtree or mesh whose bounds are outside the frustum.
+	void drawObject(ShaderProgram& program, const Frustum& frustum);
+	// Add a draw item to the queue for every mesh of the object and its children whose bounds are inside
+	// the frustum, instead of drawing them immediately. Subtrees and meshes hidden behind the occlusion
+	// culler's occluders are skipped too, if one is given.
+	void enqueue(RenderQueue& queue, ShaderProgram& program, const Frustum& frustum,
+		const OcclusionCuller* occlusion = nullptr);
+	// The same for one node's own meshes, leaving out its descendants, for callers that have already found
+	// the node in view (such as through a spatial index over nodeBounds). World matrices must be up to date.
+	void enqueueNode(size_t node, RenderQueue& queue, ShaderProgram& program, const Frustum& frustum,
+		const OcclusionCuller* occlusion = nullptr);
 
 private:
-	void drawObjectRecursive(const glm::mat4& parentModel, ShaderProgram& program) const;
+	void appendFlatNodes(SceneObject& object, int32_t parent);
+	void updateBounds();
+	void drawNodes(ShaderProgram& program, const Frustum* frustum);
+	template <typename Visit>
+	void visitVisibleMeshes(const Frustum* frustum, const OcclusionCuller* occlusion, Visit&& visit);
+	template <typename Visit>
+	void visitNodeMeshes(size_t node, const Frustum* frustum, const OcclusionCuller* occlusion, Visit&& visit);
+
+	// Set when the object's transform fields have changed since its local matrix was cached.
+	bool m_transformDirty{ true };
+
+	// The flattened hierarchy, and the cached local and world matrices of each node at the same index.
+	std::vector<FlatNode> m_nodes{};
+	std::vector<glm::mat4> m_localMatrices{};
+	std::vector<glm::mat4> m_worldMatrices{};
+	// Whether each node's world matrix changed during the current update, so its children follow.
+	std::vector<uint8_t> m_worldChanged{};
+	// Scratch space for rebuilding stale local matrices in one batch.
+	std::vector<uint32_t> m_dirtyNodes{};
+	TransformBatch m_dirtyTransforms{};
+	std::vector<glm::mat4> m_dirtyMatrices{};
+	// The bounds of each node's own meshes in its local space and in world space, and of its whole
+	// subtree in world space.
+	std::vector<BoundingBox> m_localBounds{};
+	std::vector<BoundingBox> m_nodeBounds{};
+	std::vector<BoundingBox> m_subtreeBounds{};
+	// The address of the root's children when the hierarchy was flattened. A copy of this object has
+	// its own children, so the node pointers must be rebuilt when this no longer matches.
+	const SceneObject* m_flattenedChildren{ nullptr };
 };
 
@@ -1,14 +1,18 @@
 #pragma once
 #include <glm/ext.hpp>
 #include <string>
+#include "GpuResource.h"
+
 class ShaderProgram {
-	uint32_t m_programId;
+	GlProgram m_program;
 
 public:
 	ShaderProgram();
 	void load(const std::string& vertexShaderPath, const std::string& fragmentShaderPath);
 
 	void activate();
+	// The OpenGL name of the linked program.
+	uint32_t id() const;
 
 	void setUniform(const std::string& uniformName, bool value);
 	void setUniform(const std::string& uniformName, int32_t value);
@@ -13,6 +13,8 @@ public:
     StbImage();
 
     void loadFromFile(const std::string& filepath);
+    // Decode an image file that has already been read into memory. name is only used in errors.
+    void loadFromMemory(const unsigned char* bytes, size_t size, const std::string& name);
 
     int getWidth() const;
     int getHeight() const;
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "GpuResource.h"
+
+// Space handed out by StreamBuffer::allocate for the current frame. Write up to size bytes to data and
+// commit it, then draw from buffer at offset.
+struct StreamAllocation {
+	void* data{ nullptr };
+	uint32_t buffer{ 0 };
+	size_t offset{ 0 };
+	size_t size{ 0 };
+};
+
+/**
+ * @brief A ring of frame-sized regions in one buffer, for data that is written once per frame and then thrown
+ * away: instance matrices, indirect commands and draw data, particles. Allocating is bumping an offset in
+ * the current frame's region.
+ *
+ * With GL 4.4 or ARB_buffer_storage the buffer is mapped once, persistently and coherently, and allocations
+ * are written straight into it. endFrame() fences the frame's region, and beginFrame() waits on the fence
+ * of the region it is about to reuse, so the CPU never overwrites data the GPU may still read. That wait is
+ * a stall, and its time is counted in the frame stats. Without persistent mapping, allocations are written
+ * to a copy in RAM and committed with glBufferSubData into storage that is orphaned every frame.
+ *
+ * A frame that needs more than a region replaces the buffer with a bigger one. Allocations made earlier in
+ * the frame stay valid, since each names its own buffer. Must be used on the GL thread.
+ */
+class StreamBuffer {
+public:
+	enum class Mode { persistent, orphaning };
+
+	explicit StreamBuffer(size_t regionBytes = 4 << 20, uint32_t regionCount = 3);
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// Whether the context can map buffers persistently (GL 4.4 or ARB_buffer_storage).
+	static bool persistentMappingSupported();
+
+	// Start allocating from the next region, waiting for the GPU to finish reading it first. Call once per
+	// frame before any allocations.
+	void beginFrame();
+	// Fence the frame's region. Call once per frame after its last draw.
+	void endFrame();
+
+	// Bump-allocate bytes in the frame's region at an offset that is a multiple of alignment. The alignment
+	// need not be a power of two, so an array of structs can be addressed by index from the buffer's start.
+	StreamAllocation allocate(size_t bytes, size_t alignment = 16);
+	// Make what was written to an allocation visible to the GPU.
+	void commit(const StreamAllocation& allocation);
+	// Allocate, copy the data in and commit.
+	StreamAllocation upload(const void* data, size_t bytes, size_t alignment = 16);
+
+	Mode mode() const;
+	uint32_t buffer() const;
+	// Print the mode and size, the most used in a frame, and the time spent waiting on fences.
+	void printStats(std::ostream& out) const;
+
+private:
+	// Replace the buffer with one of the given region size.
+	void create(size_t regionBytes);
+
+	GlBuffer m_buffer{};
+	Mode m_mode;
+	size_t m_regionBytes;
+	uint32_t m_regionCount;
+	uint32_t m_region{ 0 };
+	// Bytes allocated from the current region.
+	size_t m_used{ 0 };
+	std::byte* m_mapped{ nullptr };
+	// Orphaning only: this frame's data before it is committed, and the copies for buffers replaced during
+	// the frame, kept until the frame ends in case allocations from them haven't been committed yet.
+	std::vector<std::byte> m_staging{};
+	std::vector<std::vector<std::byte>> m_replacedStaging{};
+	// Persistent only: the fence after the last frame that wrote each region, or null.
+	std::vector<void*> m_fences{};
+
+	uint32_t m_frames{ 0 };
+	size_t m_peakBytes{ 0 };
+	uint32_t m_stalls{ 0 };
+	double m_waitMilliseconds{ 0 };
+	float m_maxWaitMilliseconds{ 0 };
+	uint32_t m_grown{ 0 };
+};
+
+// The process-wide stream buffer, created on first use. Needs a current GL context.
+StreamBuffer& streamBuffer();
@@ -2,11 +2,13 @@
 #include <glad/glad.h>
 #include <string>
 #include <filesystem>
+#include "GpuResource.h"
 #include "StbImage.h"
 
 /**
  * @brief Represents a texture that has been loaded into VRAM, and is expected to be bound
- * to a sampler2D with a given sampler name in the fragment shader.
+ * to a sampler2D with a given sampler name in the fragment shader. A Texture doesn't own the GL texture;
+ * whoever called loadImage keeps the GlTexture that does.
  */
 struct Texture {
 	// The ID of the texture, to be bound with glBindTexture when drawing a mesh.
@@ -15,11 +17,11 @@ struct Texture {
 	std::string samplerName;
 
 	/**
-	 * @brief Loads an SFML Image into VRAM and returns a Texture object identifying it.
+	 * @brief Loads an image into VRAM, with mipmaps, and returns the texture that owns it.
 	 */
-	static Texture loadImage(const StbImage& texture, const std::string& samplerName) {
-		uint32_t texId;
-		glGenTextures(1, &texId);
+	static GlTexture loadImage(const StbImage& texture) {
+		GlTexture tex{ GlTexture::create() };
+		uint32_t texId{ tex.id() };
 		glBindTexture(GL_TEXTURE_2D, texId);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -30,6 +32,10 @@ struct Texture {
 		glGenerateMipmap(GL_TEXTURE_2D);
 		glBindTexture(GL_TEXTURE_2D, 0);
 
-		return Texture{ texId, samplerName };
+		// RGBA8, and a third more for the mip chain.
+		size_t baseBytes{ static_cast<size_t>(texture.getWidth()) * texture.getHeight() * 4 };
+		tex.account(VramCategory::texture, baseBytes);
+		tex.account(VramCategory::mipLevels, baseBytes / 3);
+		return tex;
 	}
 };
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <vector>
+
+/**
+ * @brief The position, orientation, scale and center of many objects, stored as separate arrays per
+ * component so they can be turned into model matrices several at a time with SIMD instructions.
+ */
+struct TransformBatch {
+	std::vector<float> positionX{}, positionY{}, positionZ{};
+	std::vector<float> orientationX{}, orientationY{}, orientationZ{};
+	std::vector<float> scaleX{}, scaleY{}, scaleZ{};
+	std::vector<float> centerX{}, centerY{}, centerZ{};
+	// Applied after the rest of the transform, like SceneObject::baseTransform. Either empty, or one per
+	// transform in the batch.
+	std::vector<glm::mat4> baseTransforms{};
+
+	size_t size() const;
+	void clear();
+	void add(const glm::vec3& position, const glm::vec3& orientation, const glm::vec3& scale, const glm::vec3& center);
+	void add(const glm::vec3& position, const glm::vec3& orientation, const glm::vec3& scale, const glm::vec3& center,
+		const glm::mat4& baseTransform);
+};
+
+// Build one model matrix by composing translate, rotate (Z, then X, then Y), scale and the base transform
+// with glm, about the given center of rotation. This is what SceneObject::buildModelMatrix uses.
+glm::mat4 composeModelMatrix(const glm::vec3& position, const glm::vec3& orientation, const glm::vec3& scale,
+	const glm::vec3& center, const glm::mat4& baseTransform);
+
+// Compute the model matrix of every transform in the batch, exactly as composeModelMatrix would (to within float rounding), writing batch.size() matrices to out. Uses AVX2 or SSE2 when the
+// build enables them.
+void buildModelMatrices(const TransformBatch& batch, glm::mat4* out);
+// The same, one transform at a time without SIMD. Used for the leftovers of a SIMD batch, and to
+// compare against.
+void buildModelMatricesScalar(const TransformBatch& batch, glm::mat4* out, size_t first = 0);
+// The instruction set buildModelMatrices was compiled for: "AVX2", "SSE2" or "scalar".
+const char* modelMatrixKernelName();
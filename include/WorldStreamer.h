@@ -0,0 +1,128 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "AssimpImport.h"
+#include "Bounds.h"
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+#include "SceneObject.h"
+#include "ShaderProgram.h"
+
+/**
+ * @brief A model file placed in a world cell.
+ */
+struct CellModel {
+	std::string path{};
+	glm::vec3 position{ 0, 0, 0 };
+	glm::vec3 orientation{ 0, 0, 0 };
+	glm::vec3 scale{ 1, 1, 1 };
+};
+
+/**
+ * @brief One cell of the world partition: the region it covers, which decides when it is loaded and whether
+ * it is visible, and the models placed in it.
+ */
+struct WorldCell {
+	BoundingBox bounds{};
+	std::vector<CellModel> models{};
+};
+
+/**
+ * @brief Streams world cells in and out around the camera.
+ *
+ * Cells within loadRadius are loaded in priority order: nearest first, with cells ahead of the direction the
+ * camera is travelling counted as closer than cells behind it. Reading, decoding and simplifying a cell's
+ * models runs on the job system; only the upload happens on the main thread, a bounded number per frame.
+ * Cells beyond unloadRadius are unloaded, and when the uploaded cells go over the VRAM budget, the ones that
+ * have gone longest without being seen are evicted. Models are shared through the asset registry, so only
+ * the VRAM a load actually uploads counts against the budget: a model is charged to the cell that brought it
+ * in, and the charge is dropped when the last resident cell using it unloads. Models the registry already
+ * held for something else cost the streamer nothing. Decoded cells waiting for upload count against the RAM
+ * budget, and no new loads start while it is full.
+ */
+class WorldStreamer {
+public:
+	size_t ramBudget{ 256u << 20 };
+	size_t vramBudget{ 512u << 20 };
+	// The most cells decoding at once, and the most uploaded per update.
+	uint32_t maxPendingLoads{ 2 };
+	uint32_t maxUploadsPerFrame{ 1 };
+	ImportOptions importOptions{};
+
+	WorldStreamer(float loadRadius, float unloadRadius);
+	// Waits for the pending loads, so none is still decoding (and looking up the asset registry) once the
+	// streamer is gone. A load job holds only its own results, never the streamer, so moving it is safe.
+	~WorldStreamer();
+	WorldStreamer(WorldStreamer&&) = default;
+	WorldStreamer& operator=(WorldStreamer&&) = default;
+
+	uint32_t addCell(const WorldCell& cell);
+	// Start, finish and evict loads for the camera's new position. Needs the GL context.
+	void update(const glm::vec3& cameraPos);
+	// Queue the resident cells inside the frustum, and remember which cells were seen this frame.
+	void enqueue(RenderQueue& queue, ShaderProgram& program, const Frustum& frustum,
+		const OcclusionCuller* occlusion = nullptr);
+
+	size_t residentCells() const;
+	size_t ramBytes() const;
+	size_t vramBytes() const;
+	// Print each cell's state, memory use and load latency.
+	void printCells(std::ostream& out) const;
+
+private:
+	// Cells whose models failed to load are not retried.
+	enum class CellState { unloaded, loading, resident, failed };
+
+	// The result of a load job, written by the job and only read once it has finished.
+	struct Load {
+		std::vector<DecodedModel> models{};
+		std::string error{};
+		size_t ramBytes{ 0 };
+	};
+
+	struct Cell {
+		WorldCell description{};
+		CellState state{ CellState::unloaded };
+		JobSystem::JobHandle job{};
+		std::shared_ptr<Load> load{};
+		std::chrono::steady_clock::time_point requested{};
+		// Objects made from the cell's models, which keep them loaded.
+		std::vector<SceneObject> objects{};
+		// The VRAM the cell's last load uploaded: the models no other resident cell or object had loaded.
+		size_t vramBytes{ 0 };
+		uint64_t lastVisibleFrame{ 0 };
+		uint32_t loads{ 0 };
+		uint32_t evictions{ 0 };
+		float lastLoadMilliseconds{ 0 };
+	};
+
+	// A model used by resident cells: how many use it, and the VRAM charged when the first of them loaded it.
+	struct ModelUse {
+		uint32_t cells{ 0 };
+		size_t bytes{ 0 };
+	};
+
+	float distanceTo(const Cell& cell, const glm::vec3& cameraPos) const;
+	void startLoad(Cell& cell);
+	void finishLoad(Cell& cell);
+	void unload(Cell& cell);
+
+	float m_loadRadius;
+	float m_unloadRadius;
+	std::vector<Cell> m_cells{};
+	std::unordered_map<const ModelAsset*, ModelUse> m_modelUses{};
+	uint64_t m_frame{ 1 };
+	glm::vec3 m_lastCameraPos{ 0, 0, 0 };
+	// A smoothed camera velocity, for favouring cells in the direction of travel.
+	glm::vec3 m_travel{ 0, 0, 0 };
+	size_t m_ramBytes{ 0 };
+	size_t m_vramBytes{ 0 };
+};
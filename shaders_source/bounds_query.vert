@@ -0,0 +1,11 @@
+#version 330
+// Draws a unit cube stretched over a world-space bounding box, for occlusion queries.
+layout (location=0) in vec3 vPosition;
+
+uniform mat4 viewProjection;
+uniform vec3 boundsMin;
+uniform vec3 boundsMax;
+
+void main() {
+    gl_Position = viewProjection * vec4(mix(boundsMin, boundsMax, vPosition), 1.0);
+}
@@ -0,0 +1,39 @@
+#version 330 core
+// Blends the four baked views nearest the view direction, and lights them with the baked normals.
+layout (location = 0) out vec4 FragColor;
+
+in vec2 LocalCoord;
+flat in vec2 Cell;
+in vec2 CellBlend;
+
+uniform sampler2D colorAtlas;
+uniform sampler2D normalAtlas;
+uniform float gridSize;
+// The border around each view, as a fraction of its cell.
+uniform float cellInset;
+uniform vec4 material;
+uniform vec3 ambientColor;
+uniform vec3 directionalLight;
+uniform vec3 directionalColor;
+
+vec4 sampleCell(sampler2D atlas, vec2 cell) {
+    cell = min(cell, vec2(gridSize - 1.0));
+    return texture(atlas, (cell + cellInset + LocalCoord * (1.0 - 2.0 * cellInset)) / gridSize);
+}
+
+vec4 blendCells(sampler2D atlas) {
+    vec4 bottom = mix(sampleCell(atlas, Cell), sampleCell(atlas, Cell + vec2(1, 0)), CellBlend.x);
+    vec4 top = mix(sampleCell(atlas, Cell + vec2(0, 1)), sampleCell(atlas, Cell + vec2(1, 1)), CellBlend.x);
+    return mix(bottom, top, CellBlend.y);
+}
+
+void main() {
+    vec4 color = blendCells(colorAtlas);
+    if (color.a < 0.5) {
+        discard;
+    }
+    vec3 norm = normalize(blendCells(normalAtlas).xyz * 2.0 - 1.0);
+    float lambertFactor = max(dot(norm, normalize(-directionalLight)), 0.0);
+    vec3 lightIntensity = material.x * ambientColor + material.y * directionalColor * lambertFactor;
+    FragColor = vec4(lightIntensity * color.rgb, 1.0);
+}
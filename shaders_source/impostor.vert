@@ -0,0 +1,39 @@
+#version 330
+// Draws one camera-facing quad per impostor instance, and works out which baked views to sample.
+layout (location=0) in vec2 vCorner;      // quad corner in [-1, 1]
+layout (location=1) in vec4 vInstance;    // xyz = world-space center, w = radius
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec3 cameraPos;
+uniform float gridSize;
+
+out vec2 LocalCoord;
+// The cell of the atlas to the lower-left of the view direction, and how far toward the next cells it is.
+flat out vec2 Cell;
+out vec2 CellBlend;
+
+// Maps a direction onto the octahedron unfolded into [-1, 1]^2, with y as the octahedron's axis.
+vec2 octEncode(vec3 d) {
+    vec3 n = vec3(d.x, d.z, d.y) / (abs(d.x) + abs(d.y) + abs(d.z));
+    vec2 p = n.xy;
+    if (n.z < 0.0) {
+        p = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return p;
+}
+
+void main() {
+    vec3 center = vInstance.xyz;
+    vec3 dir = normalize(cameraPos - center);
+    // The same basis the views were baked with.
+    vec3 right = abs(dir.y) < 0.999 ? normalize(cross(vec3(0, 1, 0), dir)) : vec3(1, 0, 0);
+    vec3 up = cross(dir, right);
+    vec3 worldPos = center + (right * vCorner.x + up * vCorner.y) * vInstance.w;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+
+    LocalCoord = vCorner * 0.5 + 0.5;
+    vec2 cellCoord = clamp((octEncode(dir) * 0.5 + 0.5) * gridSize - 0.5, vec2(0.0), vec2(gridSize - 1.0));
+    Cell = floor(cellCoord);
+    CellBlend = cellCoord - Cell;
+}
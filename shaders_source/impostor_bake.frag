@@ -0,0 +1,20 @@
+#version 330 core
+// Writes a model's unlit color and world-space normal into the two impostor atlases.
+layout (location = 0) out vec4 Color;
+layout (location = 1) out vec4 NormalOut;
+
+in vec2 TexCoord;
+in vec3 Normal;
+in vec3 FragWorldPos;
+
+uniform sampler2D baseTexture;
+
+void main() {
+    vec4 color = texture(baseTexture, TexCoord);
+    if (color.a < 0.5) {
+        discard;
+    }
+    Color = vec4(color.rgb, 1.0);
+    // Pack the normal from [-1, 1] into [0, 1].
+    NormalOut = vec4(normalize(Normal) * 0.5 + 0.5, 1.0);
+}
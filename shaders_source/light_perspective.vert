@@ -4,6 +4,10 @@
 layout (location=0) in vec3 vPosition;
 layout (location=2) in vec3 vNormal;
 layout (location=1) in vec2 vTexCoord;
+// How the mesh's vertices are stored (see VertexDecode in Mesh.h): position = offset + stored * scale, and
+// octahedral-encoded normals when offset.w is 1.
+layout (location=7) in vec4 vDecodeOffset;
+layout (location=8) in vec4 vDecodeScale;
 
 uniform mat4 projection;
 uniform mat4 view;
@@ -13,18 +17,31 @@ out vec2 TexCoord;
 out vec3 Normal;
 out vec3 FragWorldPos;
 
+vec3 decodeNormal(vec3 stored) {
+    if (vDecodeOffset.w < 0.5) {
+        return stored;
+    }
+    // Unfold the octahedron: the lower half was folded over the diagonals onto the upper one.
+    vec3 n = vec3(stored.xy, 1.0 - abs(stored.x) - abs(stored.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
 void main() {
+    vec3 position = vDecodeOffset.xyz + vPosition * vDecodeScale.xyz;
     // Transform the vertex position from local space to clip space.
-    gl_Position = projection * view * model * vec4(vPosition, 1.0);
+    gl_Position = projection * view * model * vec4(position, 1.0);
 
     // Pass along the vertex texture coordinate.
     TexCoord = vTexCoord;
 
     // Transform the vertex normal from local space to world space, using the Normal matrix.
     mat3 normalMatrix = transpose(inverse(mat3(model)));
-    Normal = mat3(normalMatrix) * vNormal;
+    Normal = mat3(normalMatrix) * decodeNormal(vNormal);
     
     // TODO: transform the vertex position into world space, and assign it to FragWorldPos.
-    FragWorldPos = vec3(model * vec4(vPosition, 1.0));
+    FragWorldPos = vec3(model * vec4(position, 1.0));
 
 }
\ No newline at end of file
@@ -0,0 +1,45 @@
+#version 330
+// The instanced variant of light_perspective.vert: each instance supplies its own transform, which is
+// applied on top of the mesh's model matrix within the instanced model.
+layout (location=0) in vec3 vPosition;
+layout (location=2) in vec3 vNormal;
+layout (location=1) in vec2 vTexCoord;
+// A mat4 attribute takes four locations, 3 to 6.
+layout (location=3) in mat4 vInstance;
+// How the mesh's vertices are stored (see VertexDecode in Mesh.h): position = offset + stored * scale, and
+// octahedral-encoded normals when offset.w is 1.
+layout (location=7) in vec4 vDecodeOffset;
+layout (location=8) in vec4 vDecodeScale;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+
+out vec2 TexCoord;
+out vec3 Normal;
+out vec3 FragWorldPos;
+
+vec3 decodeNormal(vec3 stored) {
+    if (vDecodeOffset.w < 0.5) {
+        return stored;
+    }
+    // Unfold the octahedron: the lower half was folded over the diagonals onto the upper one.
+    vec3 n = vec3(stored.xy, 1.0 - abs(stored.x) - abs(stored.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
+void main() {
+    mat4 world = vInstance * model;
+    vec3 position = vDecodeOffset.xyz + vPosition * vDecodeScale.xyz;
+    gl_Position = projection * view * world * vec4(position, 1.0);
+
+    TexCoord = vTexCoord;
+
+    mat3 normalMatrix = transpose(inverse(mat3(world)));
+    Normal = normalMatrix * decodeNormal(vNormal);
+
+    FragWorldPos = vec3(world * vec4(position, 1.0));
+}
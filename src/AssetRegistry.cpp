@@ -0,0 +1,199 @@
+#include "AssetRegistry.h"
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+size_t ModelAsset::totalBytes() const {
+	size_t bytes{ meshBytes };
+	for (auto& texture : textures) {
+		bytes += texture->bytes;
+	}
+	return bytes;
+}
+
+template <typename Asset>
+std::shared_ptr<const Asset> AssetRegistry::Table<Asset>::find(const std::string& key, uint64_t contentHash) const {
+	// A key hit whose contents have changed since is stale; the new contents may still match another asset.
+	if (auto existing{ byKey.find(key) }; existing != byKey.end()) {
+		if (auto asset{ existing->second.lock() }; asset && asset->contentHash == contentHash) {
+			return asset;
+		}
+	}
+	if (contentHash == 0) {
+		return nullptr;
+	}
+	if (auto existing{ byHash.find(contentHash) }; existing != byHash.end()) {
+		return existing->second.lock();
+	}
+	return nullptr;
+}
+
+template <typename Asset>
+void AssetRegistry::Table<Asset>::insert(const std::string& key, uint64_t contentHash,
+	const std::shared_ptr<const Asset>& asset) {
+	byKey[key] = asset;
+	if (contentHash != 0) {
+		byHash[contentHash] = asset;
+	}
+}
+
+template <typename Asset>
+size_t AssetRegistry::Table<Asset>::liveCount() {
+	// Forget the assets that have gone away while counting the rest.
+	std::erase_if(byHash, [](const auto& entry) { return entry.second.expired(); });
+	std::erase_if(byKey, [](const auto& entry) { return entry.second.expired(); });
+	return byKey.size();
+}
+
+std::string AssetRegistry::canonicalKey(const std::filesystem::path& path) {
+	std::error_code error{};
+	std::filesystem::path canonical{ std::filesystem::weakly_canonical(path, error) };
+	return (error ? path.lexically_normal() : canonical).generic_string();
+}
+
+uint64_t AssetRegistry::hashBytes(const void* data, size_t size, uint64_t seed) {
+	// FNV-1a.
+	uint64_t hash{ seed };
+	const unsigned char* bytes{ static_cast<const unsigned char*>(data) };
+	for (size_t i{ 0 }; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+uint64_t AssetRegistry::hashFile(const std::filesystem::path& path) {
+	struct CachedHash {
+		std::uintmax_t size{ 0 };
+		std::filesystem::file_time_type modified{};
+		uint64_t hash{ 0 };
+	};
+	static std::mutex mutex{};
+	static std::unordered_map<std::string, CachedHash> cache{};
+
+	std::error_code sizeError{}, timeError{};
+	std::uintmax_t size{ std::filesystem::file_size(path, sizeError) };
+	std::filesystem::file_time_type modified{ std::filesystem::last_write_time(path, timeError) };
+	bool stamped{ !sizeError && !timeError };
+	std::string key{ path.lexically_normal().generic_string() };
+	if (stamped) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		if (auto cached{ cache.find(key) }; cached != cache.end()
+			&& cached->second.size == size && cached->second.modified == modified) {
+			return cached->second.hash;
+		}
+	}
+
+	std::ifstream file{ path, std::ios::binary };
+	if (!file) {
+		return 0;
+	}
+	std::vector<char> contents{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+	uint64_t hash{ hashBytes(contents.data(), contents.size()) };
+	if (stamped) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		cache[key] = CachedHash{ size, modified, hash };
+	}
+	return hash;
+}
+
+void AssetRegistry::countDuplicate(size_t bytes) {
+	++m_duplicatesPrevented;
+	m_bytesSaved += bytes;
+}
+
+TextureHandle AssetRegistry::findTexture(const std::string& key, uint64_t contentHash) {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	TextureHandle texture{ m_textures.find(key, contentHash) };
+	if (texture) {
+		countDuplicate(texture->bytes);
+	}
+	return texture;
+}
+
+TextureHandle AssetRegistry::addTexture(const std::string& key, uint64_t contentHash, const StbImage& image) {
+	if (TextureHandle existing{ findTexture(key, contentHash) }) {
+		return existing;
+	}
+	auto texture{ std::make_shared<TextureAsset>() };
+	texture->texture = Texture::loadImage(image);
+	texture->textureId = texture->texture.id();
+	// RGBA8, plus a third for the mipmaps.
+	texture->bytes = static_cast<size_t>(image.getWidth()) * image.getHeight() * 4 * 4 / 3;
+	texture->key = key;
+	texture->contentHash = contentHash;
+
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	m_textures.insert(key, contentHash, texture);
+	return texture;
+}
+
+ModelHandle AssetRegistry::findModel(const std::string& key, uint64_t contentHash) {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	ModelHandle model{ m_models.find(key, contentHash) };
+	if (model) {
+		countDuplicate(model->totalBytes());
+	}
+	return model;
+}
+
+ModelHandle AssetRegistry::addModel(const std::string& key, uint64_t contentHash, SceneObject prototype,
+	std::vector<TextureHandle> textures) {
+	auto model{ std::make_shared<ModelAsset>() };
+	model->prototype = std::move(prototype);
+	model->textures = std::move(textures);
+	model->contentHash = contentHash;
+	std::vector<const SceneObject*> stack{ &model->prototype };
+	while (!stack.empty()) {
+		const SceneObject* object{ stack.back() };
+		stack.pop_back();
+		for (auto& mesh : object->meshes) {
+			size_t indices{ 0 };
+			for (auto& lod : mesh.lods) {
+				indices += lod.indexCount;
+			}
+			model->meshBytes += indices * Mesh::indexSizeFor(mesh.vertexCount) + mesh.vertexCount * vertexStride(mesh.format);
+			model->packedBytesSaved += mesh.vertexCount * (sizeof(Vertex3D) - vertexStride(mesh.format));
+		}
+		for (auto& child : object->children) {
+			stack.push_back(&child);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	if (ModelHandle existing{ m_models.find(key, contentHash) }) {
+		// Someone else loaded the same model in the meantime; the new copy goes away with model.
+		countDuplicate(existing->totalBytes());
+		return existing;
+	}
+	m_models.insert(key, contentHash, model);
+	return model;
+}
+
+SceneObject AssetRegistry::instantiate(const ModelHandle& model) {
+	SceneObject object{ model->prototype };
+	object.asset = model;
+	object.flatten();
+	return object;
+}
+
+uint64_t AssetRegistry::duplicatesPrevented() const {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	return m_duplicatesPrevented;
+}
+
+uint64_t AssetRegistry::bytesSaved() const {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	return m_bytesSaved;
+}
+
+void AssetRegistry::printStats(std::ostream& out) {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	out << "assets: " << m_models.liveCount() << " models, " << m_textures.liveCount() << " textures resident; "
+		<< m_duplicatesPrevented << " duplicate loads prevented, " << static_cast<float>(m_bytesSaved) / (1 << 20)
+		<< " MB saved" << std::endl;
+}
+
+AssetRegistry& assetRegistry() {
+	static AssetRegistry registry{};
+	return registry;
+}
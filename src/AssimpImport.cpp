@@ -1,10 +1,20 @@
 #include "AssimpImport.h"
+#include "JobSystem.h"
+#include "Meshlets.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
 #include <iostream>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
 #include <unordered_map>
+#include <algorithm>
+#include <cctype>
+#include <unordered_set>
 
 std::vector<Texture> loadMaterialTextures(
 	aiMaterial* mat,
@@ -20,37 +30,187 @@ std::vector<Texture> loadMaterialTextures(
 		std::filesystem::path texPath{ modelPath.parent_path() / name.C_Str() };
 		std::cout << "loading " << texPath << " as " << typeName << std::endl;
 
+		// Every texture the file uses has been through preloadMaterialTextures (or decodeStaticModel), so one
+		// that isn't loaded is missing or broken.
 		auto existing{ loadedTextures.find(texPath.string()) };
 		if (existing != loadedTextures.end()) {
-			textures.push_back(existing->second);
+			textures.push_back(Texture{ existing->second.textureId, typeName });
+		}
+		else if (!std::filesystem::exists(texPath)) {
+			std::cerr << "WARNING: Texture file not found: " << texPath << std::endl;
+			std::cerr << "Skipping this texture and continuing..." << std::endl;
 		}
 		else {
-			// Check if file exists before trying to load
-			if (!std::filesystem::exists(texPath)) {
-				std::cerr << "WARNING: Texture file not found: " << texPath << std::endl;
-				std::cerr << "Skipping this texture and continuing..." << std::endl;
-				continue; // Skip this texture, don't crash
+			std::cerr << "WARNING: Failed to load texture " << texPath << std::endl;
+			std::cerr << "Continuing without this texture..." << std::endl;
+		}
+	}
+	return textures;
+}
+
+// Decodes every texture referenced by the materials of the scene's meshes that isn't in loadedTextures or the
+// asset registry yet, in parallel on the job system. Makes no GL calls.
+std::vector<DecodedModel::Image> decodeMaterialTextures(
+	const aiScene* scene,
+	const std::filesystem::path& modelPath,
+	const std::unordered_map<std::string, Texture>& loadedTextures
+) {
+	// The same texture types and sampler names that fromAssimpMesh asks for.
+	const std::pair<aiTextureType, const char*> textureTypes[]{
+		{ aiTextureType_DIFFUSE, "baseTexture" },
+		{ aiTextureType_SPECULAR, "specMap" },
+		{ aiTextureType_HEIGHT, "normalMap" },
+		{ aiTextureType_NORMALS, "normalMap" },
+	};
+
+	// Only the materials some mesh uses; files often carry others that are never drawn.
+	std::vector<bool> usedMaterials(scene->mNumMaterials, false);
+	for (uint32_t i{ 0 }; i < scene->mNumMeshes; ++i) {
+		if (scene->mMeshes[i]->mMaterialIndex < scene->mNumMaterials) {
+			usedMaterials[scene->mMeshes[i]->mMaterialIndex] = true;
+		}
+	}
+
+	std::vector<DecodedModel::Image> pending{};
+	std::unordered_set<std::string> seen{};
+	for (uint32_t m{ 0 }; m < scene->mNumMaterials; ++m) {
+		if (!usedMaterials[m]) {
+			continue;
+		}
+		const aiMaterial* material{ scene->mMaterials[m] };
+		for (auto& [type, samplerName] : textureTypes) {
+			for (uint32_t i{ 0 }; i < material->GetTextureCount(type); ++i) {
+				aiString name{};
+				material->GetTexture(type, i, &name);
+				std::filesystem::path texPath{ modelPath.parent_path() / name.C_Str() };
+				// Missing files are left for loadMaterialTextures to report.
+				if (loadedTextures.contains(texPath.string()) || !seen.insert(texPath.string()).second
+					|| !std::filesystem::exists(texPath)) {
+					continue;
+				}
+				pending.push_back(DecodedModel::Image{ texPath.string(), samplerName, AssetRegistry::canonicalKey(texPath) });
 			}
+		}
+	}
 
+	jobSystem().parallelFor(pending.size(), 1, [&pending](size_t begin, size_t end) {
+		for (size_t i{ begin }; i < end; ++i) {
+			DecodedModel::Image& p{ pending[i] };
+			std::ifstream file{ p.path, std::ios::binary };
+			std::vector<unsigned char> bytes{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+			p.contentHash = AssetRegistry::hashBytes(bytes.data(), bytes.size());
+			p.existing = assetRegistry().findTexture(p.key, p.contentHash);
+			if (p.existing) {
+				continue;
+			}
 			try {
-				StbImage image{};
-				image.loadFromFile(texPath.string());
-				Texture tex{ Texture::loadImage(image, typeName) };
-				textures.push_back(tex);
-				loadedTextures.insert(std::make_pair(texPath.string(), tex));
+				p.image.loadFromMemory(bytes.data(), bytes.size(), p.path);
+				p.decoded = true;
 			}
-			catch (const std::exception& e) {
-				std::cerr << "WARNING: Failed to load texture " << texPath
-					<< ": " << e.what() << std::endl;
-				std::cerr << "Continuing without this texture..." << std::endl;
-				// Continue loading without this texture instead of crashing
+			catch (const std::exception&) {
+				// loadMaterialTextures will report the missing texture.
 			}
 		}
+	});
+	return pending;
+}
+
+// Decodes every texture referenced by the scene's materials in parallel on the job system, then uploads
+// them on this thread (the one that owns the GL context), so loadMaterialTextures finds them already loaded.
+// Textures already in the asset registry are shared instead; handles collects what the model uses.
+void preloadMaterialTextures(
+	const aiScene* scene,
+	const std::filesystem::path& modelPath,
+	std::unordered_map<std::string, Texture>& loadedTextures,
+	std::vector<TextureHandle>& handles
+) {
+	for (auto& p : decodeMaterialTextures(scene, modelPath, loadedTextures)) {
+		TextureHandle texture{ p.existing };
+		if (!texture && p.decoded) {
+			texture = assetRegistry().addTexture(p.key, p.contentHash, p.image);
+		}
+		if (texture) {
+			loadedTextures.insert(std::make_pair(p.path, Texture{ texture->textureId, p.samplerName }));
+			handles.push_back(std::move(texture));
+		}
 	}
-	return textures;
 }
 
-Mesh fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
+// The external files a glTF document references by "uri" (buffers and images), relative to the document.
+// Embedded data: URIs are part of the document itself and are skipped.
+std::vector<std::filesystem::path> gltfDependencies(const std::filesystem::path& path, const std::string& document) {
+	std::vector<std::filesystem::path> files{};
+	const std::string tag{ "\"uri\"" };
+	for (size_t at{ document.find(tag) }; at != std::string::npos; at = document.find(tag, at)) {
+		at += tag.size();
+		while (at < document.size() && (std::isspace(static_cast<unsigned char>(document[at])) || document[at] == ':')) {
+			++at;
+		}
+		if (at >= document.size() || document[at] != '"') {
+			continue;
+		}
+		std::string uri{};
+		for (++at; at < document.size() && document[at] != '"'; ++at) {
+			if (document[at] == '\\' && at + 1 < document.size()) {
+				++at;
+			}
+			if (document[at] == '%' && at + 2 < document.size()
+				&& std::isxdigit(static_cast<unsigned char>(document[at + 1]))
+				&& std::isxdigit(static_cast<unsigned char>(document[at + 2]))) {
+				uri += static_cast<char>(std::stoi(document.substr(at + 1, 2), nullptr, 16));
+				at += 2;
+			}
+			else {
+				uri += document[at];
+			}
+		}
+		if (uri.rfind("data:", 0) != 0) {
+			files.push_back(path.parent_path() / uri);
+		}
+	}
+	return files;
+}
+
+// The hash of a model file's contents and of the external files it loads with, or 0 if it can't be read.
+// A .gltf keeps its geometry in .bin buffers and its textures in images beside it, so editing any of them
+// changes what the model loads as even though the document itself is untouched. The referenced files go
+// through AssetRegistry::hashFile, which only reads one again once it has changed.
+uint64_t hashModelFiles(const std::filesystem::path& path) {
+	std::ifstream file{ path, std::ios::binary };
+	if (!file) {
+		return 0;
+	}
+	std::string contents{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+	uint64_t hash{ AssetRegistry::hashBytes(contents.data(), contents.size()) };
+	std::string extension{ path.extension().string() };
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+		[](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	if (extension == ".gltf" || extension == ".glb") {
+		for (const auto& dependency : gltfDependencies(path, contents)) {
+			// A missing file mixes in 0, so it still differs from every file that exists.
+			uint64_t dependencyHash{ AssetRegistry::hashFile(dependency) };
+			hash = AssetRegistry::hashBytes(&dependencyHash, sizeof(dependencyHash), hash);
+		}
+	}
+	return hash;
+}
+
+// The registry key and content hash of a model file, which include the options that change what it loads as.
+std::pair<std::string, uint64_t> modelIdentity(const std::string& path, const ImportOptions& importOptions) {
+	std::string options{ "|flip=" + std::to_string(importOptions.flipTextureCoords)
+		+ "|bake=" + std::to_string(importOptions.bakeStatic)
+		+ "|format=" + std::to_string(static_cast<int>(importOptions.vertexFormat))
+		+ "|optimize=" + std::to_string(importOptions.optimizeMeshes)
+		+ "|meshlets=" + std::to_string(importOptions.meshletMinTriangles) + "|lods=" };
+	for (float ratio : importOptions.lodRatios) {
+		options += std::to_string(ratio) + ",";
+	}
+	uint64_t fileHash{ hashModelFiles(path) };
+	uint64_t contentHash{ fileHash == 0 ? 0 : AssetRegistry::hashBytes(options.data(), options.size(), fileHash) };
+	return { AssetRegistry::canonicalKey(path) + options, contentHash };
+}
+
+MeshData meshDataFromAssimp(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
 	std::unordered_map<std::string, Texture>& loadedTextures) {
 	std::vector<Vertex3D> vertices;
 
@@ -80,8 +240,10 @@ Mesh fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesys
 
 	// Load any base textures, specular maps, and normal maps associated with the mesh.
 	std::vector<Texture> textures{};
+	int twoSided{ 0 };
 	if (mesh->mMaterialIndex >= 0) {
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+		material->Get(AI_MATKEY_TWOSIDED, twoSided);
 		std::vector<Texture> diffuseMaps{
 			loadMaterialTextures(material, aiTextureType_DIFFUSE, "baseTexture", modelPath, loadedTextures)
 		};
@@ -101,14 +263,190 @@ Mesh fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesys
 		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 	}
 
-	return Mesh{ vertices, faces, std::move(textures) };
+	return MeshData{ std::move(vertices), std::move(faces), std::move(textures), {}, twoSided != 0 };
+}
+
+// Reorders a mesh for the GPU (if the options ask for it), splits it into meshlets if it is big enough, and
+// then fills in its simplified levels of detail, whose triangles get the same vertex cache ordering.
+MeshOptimization prepareMesh(MeshData& data, const ImportOptions& options) {
+	MeshOptimization optimization{};
+	if (options.optimizeMeshes) {
+		optimization = optimizeMesh(data.vertices, data.faces);
+	}
+	if (options.meshletMinTriangles > 0 && data.faces.size() / 3 >= options.meshletMinTriangles) {
+		data.meshlets = std::make_shared<const MeshletSet>(buildMeshlets(data.vertices, data.faces, data.twoSided));
+	}
+	if (!options.lodRatios.empty()) {
+		data.lodFaces = simplifyMesh(data.vertices, data.faces, options.lodRatios);
+		if (options.optimizeMeshes) {
+			for (auto& lod : data.lodFaces) {
+				lod = optimizeVertexCache(lod, data.vertices.size());
+			}
+		}
+	}
+	return optimization;
+}
+
+void reportOptimization(const std::string& path, const std::string& mesh, const MeshOptimization& optimization) {
+	std::cout << std::fixed << std::setprecision(3) << "optimized " << path << " mesh " << mesh
+		<< ": ACMR " << optimization.before.acmr << " -> " << optimization.after.acmr
+		<< ", ATVR " << optimization.before.atvr << " -> " << optimization.after.atvr << std::defaultfloat << std::endl;
+}
+
+// The share of the mesh's triangles each simplified level kept. simplifyMesh drops levels that would barely
+// be smaller than the one before, so there may be fewer than were asked for.
+void reportSimplification(const std::string& path, const std::string& mesh, const MeshData& data,
+	const ImportOptions& options) {
+	size_t triangles{ data.faces.size() / 3 };
+	if (options.lodRatios.empty() || triangles == 0) {
+		return;
+	}
+	std::cout << std::fixed << std::setprecision(2) << "simplified " << path << " mesh " << mesh << ": "
+		<< triangles << " triangles, levels at";
+	for (auto& lod : data.lodFaces) {
+		std::cout << " " << static_cast<double>(lod.size() / 3) / triangles;
+	}
+	if (data.lodFaces.size() < options.lodRatios.size()) {
+		std::cout << " (" << options.lodRatios.size() - data.lodFaces.size() << " of " << options.lodRatios.size()
+			<< " dropped)";
+	}
+	std::cout << std::defaultfloat << std::endl;
+}
+
+// prepareMesh for every mesh, spread over the job system.
+void prepareMeshes(std::vector<MeshData>& meshes, const std::string& path, const ImportOptions& options) {
+	std::vector<MeshOptimization> optimizations(meshes.size());
+	jobSystem().parallelFor(meshes.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i{ begin }; i < end; ++i) {
+			optimizations[i] = prepareMesh(meshes[i], options);
+		}
+	});
+	for (size_t i{ 0 }; i < meshes.size(); ++i) {
+		if (options.optimizeMeshes) {
+			reportOptimization(path, std::to_string(i), optimizations[i]);
+		}
+		reportSimplification(path, std::to_string(i), meshes[i], options);
+	}
+}
+
+Mesh fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
+	std::unordered_map<std::string, Texture>& loadedTextures, const ImportOptions& options) {
+	MeshData data{ meshDataFromAssimp(mesh, scene, modelPath, loadedTextures) };
+	MeshOptimization optimization{ prepareMesh(data, options) };
+	if (options.optimizeMeshes) {
+		reportOptimization(modelPath.string(), mesh->mName.C_Str(), optimization);
+	}
+	reportSimplification(modelPath.string(), mesh->mName.C_Str(), data, options);
+	return Mesh{ data.vertices, data.faces, std::move(data.textures), data.lodFaces, options.vertexFormat,
+		std::move(data.meshlets) };
+}
+
+// Reports how a model's meshes are stored: the index width each mesh got, and the memory saved by 16-bit
+// indices and a packed vertex format.
+void reportMeshStorage(const std::string& path, const ModelAsset& model) {
+	std::string widths{};
+	size_t indexBytesSaved{ 0 };
+	std::vector<const SceneObject*> stack{ &model.prototype };
+	while (!stack.empty()) {
+		const SceneObject* object{ stack.back() };
+		stack.pop_back();
+		for (auto& mesh : object->meshes) {
+			bool shortIndices{ mesh.indexType == GL_UNSIGNED_SHORT };
+			widths += shortIndices ? " 16" : " 32";
+			if (shortIndices) {
+				for (auto& lod : mesh.lods) {
+					indexBytesSaved += lod.indexCount * (sizeof(uint32_t) - sizeof(uint16_t));
+				}
+			}
+		}
+		for (auto& child : object->children) {
+			stack.push_back(&child);
+		}
+	}
+	size_t saved{ indexBytesSaved + model.packedBytesSaved };
+	std::cout << "stored " << path << ": index bits per mesh" << widths << "; " << (model.meshBytes + saved) / 1024
+		<< " KB -> " << model.meshBytes / 1024 << " KB of mesh data (" << indexBytesSaved / 1024 << " KB by indices, "
+		<< model.packedBytesSaved / 1024 << " KB by packed vertices)" << std::endl;
+}
+
+glm::mat4 fromAssimpMatrix(const aiMatrix4x4& matrix) {
+	// Assimp matrices are row-major, so they need to be transposed.
+	glm::mat4 m{};
+	for (uint32_t i{ 0 }; i < 4; ++i) {
+		for (uint32_t j{ 0 }; j < 4; ++j) {
+			m[i][j] = matrix[j][i];
+		}
+	}
+	return m;
+}
+
+bool sameTextures(const std::vector<Texture>& a, const std::vector<Texture>& b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (size_t i{ 0 }; i < a.size(); ++i) {
+		if (a[i].textureId != b[i].textureId || a[i].samplerName != b[i].samplerName) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Appends the meshes of a node and all its descendants to the batch with the same texture set, after
+// transforming their vertices by the node's accumulated base transform. Returns the number of meshes
+// visited, which is the number of draws the model would have cost without baking.
+uint32_t bakeAssimpNode(
+	const aiNode* node,
+	const aiScene* scene,
+	const glm::mat4& parentTransform,
+	const std::filesystem::path& modelPath,
+	std::unordered_map<std::string, Texture>& loadedTextures,
+	std::vector<MeshData>& batches
+) {
+	glm::mat4 transform{ parentTransform * fromAssimpMatrix(node->mTransformation) };
+	glm::mat3 normalMatrix{ glm::transpose(glm::inverse(glm::mat3{ transform })) };
+
+	uint32_t meshCount{ node->mNumMeshes };
+	for (size_t i{ 0 }; i < node->mNumMeshes; ++i) {
+		aiMesh* mesh{ scene->mMeshes[node->mMeshes[i]] };
+		MeshData data{ meshDataFromAssimp(mesh, scene, modelPath, loadedTextures) };
+
+		auto batch{ std::find_if(batches.begin(), batches.end(),
+			[&](const MeshData& b) { return sameTextures(b.textures, data.textures); }) };
+		if (batch == batches.end()) {
+			batches.push_back(MeshData{ {}, {}, data.textures });
+			batch = batches.end() - 1;
+		}
+		batch->twoSided = batch->twoSided || data.twoSided;
+
+		uint32_t firstVertex{ static_cast<uint32_t>(batch->vertices.size()) };
+		for (auto& v : data.vertices) {
+			glm::vec3 position{ transform * glm::vec4{ v.x, v.y, v.z, 1 } };
+			glm::vec3 normal{ glm::normalize(normalMatrix * glm::vec3{ v.nx, v.ny, v.nz }) };
+			batch->vertices.push_back(Vertex3D{ position.x, position.y, position.z, v.u, v.v,
+				normal.x, normal.y, normal.z });
+		}
+		for (auto face : data.faces) {
+			batch->faces.push_back(firstVertex + face);
+		}
+	}
+
+	for (size_t i{ 0 }; i < node->mNumChildren; ++i) {
+		meshCount += bakeAssimpNode(node->mChildren[i], scene, transform, modelPath, loadedTextures, batches);
+	}
+	return meshCount;
 }
 
 SceneObject assimpLoad(const std::string& path, bool flipTextureCoords) {
-	Assimp::Importer importer{};
+	ImportOptions options{};
+	options.flipTextureCoords = flipTextureCoords;
+	return assimpLoad(path, options);
+}
 
+// Reads a model file, throwing if assimp can't import it.
+const aiScene* readAssimpScene(Assimp::Importer& importer, const std::string& path, const ImportOptions& importOptions) {
 	auto options{ aiProcessPreset_TargetRealtime_MaxQuality };
-	if (flipTextureCoords) {
+	if (importOptions.flipTextureCoords) {
 		options |= aiProcess_FlipUVs;
 	}
 	const aiScene* scene{ importer.ReadFile(path, options) };
@@ -119,9 +457,125 @@ SceneObject assimpLoad(const std::string& path, bool flipTextureCoords) {
 		std::cerr << "Error loading assimp file: " + error << std::endl;
 		throw std::runtime_error("Error loading assimp file: " + error);
 	}
-	std::vector<Mesh> meshes{};
+	return scene;
+}
+
+size_t DecodedModel::ramBytes() const {
+	size_t bytes{ 0 };
+	for (auto& mesh : meshes) {
+		bytes += mesh.vertices.size() * sizeof(Vertex3D) + mesh.faces.size() * sizeof(uint32_t);
+		for (auto& lod : mesh.lodFaces) {
+			bytes += lod.size() * sizeof(uint32_t);
+		}
+	}
+	for (auto& image : images) {
+		bytes += static_cast<size_t>(image.image.getWidth()) * image.image.getHeight() * 4;
+	}
+	return bytes;
+}
+
+size_t DecodedModel::vramBytes() const {
+	size_t bytes{ 0 };
+	for (auto& mesh : meshes) {
+		uint32_t indexSize{ Mesh::indexSizeFor(mesh.vertices.size()) };
+		bytes += mesh.vertices.size() * vertexStride(vertexFormat) + mesh.faces.size() * indexSize;
+		for (auto& lod : mesh.lodFaces) {
+			bytes += lod.size() * indexSize;
+		}
+	}
+	// RGBA8 textures, plus a third for their mipmaps.
+	for (auto& image : images) {
+		bytes += static_cast<size_t>(image.image.getWidth()) * image.image.getHeight() * 4 * 4 / 3;
+	}
+	return bytes;
+}
+
+DecodedModel decodeStaticModel(const std::string& path, const ImportOptions& options) {
+	ImportOptions importOptions{ options };
+	importOptions.bakeStatic = true;
+	DecodedModel model{};
+	model.path = path;
+	model.vertexFormat = importOptions.vertexFormat;
+	std::tie(model.key, model.contentHash) = modelIdentity(path, importOptions);
+	model.existing = assetRegistry().findModel(model.key, model.contentHash);
+	if (model.existing) {
+		return model;
+	}
+
+	Assimp::Importer importer{};
+	const aiScene* scene{ readAssimpScene(importer, path, importOptions) };
+
+	// Stand in for each texture with a placeholder whose id is its index in images plus one, so the meshes can
+	// be baked and grouped by texture set before anything is uploaded.
+	std::unordered_map<std::string, Texture> placeholders{};
+	model.images = decodeMaterialTextures(scene, std::filesystem::path{ path }, placeholders);
+	for (uint32_t i{ 0 }; i < model.images.size(); ++i) {
+		if (!model.images[i].decoded && !model.images[i].existing) {
+			std::cerr << "WARNING: Failed to load texture " << model.images[i].path << std::endl;
+		}
+		placeholders.insert(std::make_pair(model.images[i].path, Texture{ i + 1, model.images[i].samplerName }));
+	}
+
+	uint32_t unbakedDraws{ bakeAssimpNode(scene->mRootNode, scene, glm::mat4{ 1 }, std::filesystem::path{ path },
+		placeholders, model.meshes) };
+	std::cout << "baked " << path << ": " << unbakedDraws << " draws -> " << model.meshes.size() << " draws" << std::endl;
+	prepareMeshes(model.meshes, path, importOptions);
+	return model;
+}
+
+ModelHandle uploadStaticModel(DecodedModel& model) {
+	if (model.existing) {
+		return model.existing;
+	}
+
+	std::vector<TextureHandle> uploaded{};
+	for (auto& image : model.images) {
+		TextureHandle texture{ image.existing };
+		if (!texture && image.decoded) {
+			texture = assetRegistry().addTexture(image.key, image.contentHash, image.image);
+		}
+		uploaded.push_back(std::move(texture));
+	}
+
+	SceneObject root{};
+	root.baseTransform = glm::mat4{ 1 };
+	for (auto& mesh : model.meshes) {
+		std::vector<Texture> textures{};
+		for (auto& placeholder : mesh.textures) {
+			if (const TextureHandle& texture{ uploaded[placeholder.textureId - 1] }) {
+				textures.push_back(Texture{ texture->textureId, placeholder.samplerName });
+			}
+		}
+		root.meshes.emplace_back(mesh.vertices, mesh.faces, std::move(textures), mesh.lodFaces, model.vertexFormat,
+			mesh.meshlets);
+	}
+	std::erase(uploaded, nullptr);
+	ModelHandle asset{ assetRegistry().addModel(model.key, model.contentHash, std::move(root), std::move(uploaded)) };
+	reportMeshStorage(model.path, *asset);
+	return asset;
+}
+
+SceneObject assimpLoad(const std::string& path, const ImportOptions& importOptions) {
+	if (importOptions.bakeStatic) {
+		DecodedModel model{ decodeStaticModel(path, importOptions) };
+		return AssetRegistry::instantiate(uploadStaticModel(model));
+	}
+
+	auto [key, contentHash] { modelIdentity(path, importOptions) };
+	if (ModelHandle existing{ assetRegistry().findModel(key, contentHash) }) {
+		return AssetRegistry::instantiate(existing);
+	}
+	Assimp::Importer importer{};
+	const aiScene* scene{ readAssimpScene(importer, path, importOptions) };
 	std::unordered_map<std::string, Texture> loadedTextures{};
-	return processAssimpNode(scene->mRootNode, scene, std::filesystem::path{ path }, loadedTextures);
+	std::vector<TextureHandle> textures{};
+	preloadMaterialTextures(scene, std::filesystem::path{ path }, loadedTextures, textures);
+	SceneObject root{ processAssimpNode(scene->mRootNode, scene, std::filesystem::path{ path }, loadedTextures,
+		importOptions) };
+	ModelHandle asset{ assetRegistry().addModel(key, contentHash, std::move(root), std::move(textures)) };
+	reportMeshStorage(path, *asset);
+	// instantiate builds the flattened node array, so rendering never has to walk the tree recursively.
+	return AssetRegistry::instantiate(asset);
 }
 
 // A "Node" in assimp is an Object3D in our framework. It has one or more meshes,
@@ -130,13 +584,14 @@ SceneObject processAssimpNode(
 	const aiNode* node, 
 	const aiScene* scene,
 	const std::filesystem::path& modelPath,
-	std::unordered_map<std::string, Texture>& loadedTextures
+	std::unordered_map<std::string, Texture>& loadedTextures,
+	const ImportOptions& options
 ) {
 	// Load the aiNode's meshes.
 	std::vector<Mesh> meshes{};
 	for (size_t i{ 0 }; i < node->mNumMeshes; ++i) {
 		aiMesh* mesh{ scene->mMeshes[node->mMeshes[i]] };
-		meshes.emplace_back(fromAssimpMesh(mesh, scene, modelPath, loadedTextures));
+		meshes.emplace_back(fromAssimpMesh(mesh, scene, modelPath, loadedTextures, options));
 	}
 
 	// Load the node's textures.
@@ -146,12 +601,7 @@ SceneObject processAssimpNode(
 	}
 
 	// Initialize the base transform of the object. (Needs to be transposed from assimp.)
-	glm::mat4 baseTransform{};
-	for (uint32_t i{ 0 }; i < 4; ++i) {
-		for (uint32_t j{ 0 }; j < 4; ++j) {
-			baseTransform[i][j] = node->mTransformation[j][i];
-		}
-	}
+	glm::mat4 baseTransform{ fromAssimpMatrix(node->mTransformation) };
 
 	// Initialize the object.
 	SceneObject parent{};
@@ -160,9 +610,69 @@ SceneObject processAssimpNode(
 
 	// Recursively process the children of the node and add them as child objects.
 	for (size_t i{ 0 }; i < node->mNumChildren; ++i) {
-		SceneObject child{ processAssimpNode(node->mChildren[i], scene, modelPath, loadedTextures) };
+		SceneObject child{ processAssimpNode(node->mChildren[i], scene, modelPath, loadedTextures, options) };
 		parent.children.push_back(std::move(child));
 	}
 
 	return parent;
 }
+
+Entity assimpLoadEntities(const std::string& path, const ImportOptions& importOptions, EntityStore& store) {
+	Assimp::Importer importer{};
+	const aiScene* scene{ readAssimpScene(importer, path, importOptions) };
+	std::unordered_map<std::string, Texture> loadedTextures{};
+	preloadMaterialTextures(scene, std::filesystem::path{ path }, loadedTextures, store.textures);
+	if (importOptions.bakeStatic) {
+		std::vector<MeshData> batches{};
+		bakeAssimpNode(scene->mRootNode, scene, glm::mat4{ 1 }, std::filesystem::path{ path }, loadedTextures, batches);
+		prepareMeshes(batches, path, importOptions);
+
+		Entity root{ store.create(Components::renderable) };
+		MeshRef& ref{ store.meshRef(root) };
+		ref.first = static_cast<uint32_t>(store.meshes.size());
+		ref.count = static_cast<uint32_t>(batches.size());
+		for (auto& batch : batches) {
+			store.meshes.emplace_back(batch.vertices, batch.faces, std::move(batch.textures), batch.lodFaces,
+				importOptions.vertexFormat, std::move(batch.meshlets));
+			store.bounds(root).local.expand(store.meshes.back().bounds);
+		}
+		return root;
+	}
+
+	return processAssimpNodeEntities(scene->mRootNode, scene, std::filesystem::path{ path }, loadedTextures, store,
+		Entity{}, importOptions);
+}
+
+// The entity version of processAssimpNode: each node becomes an entity parented to its node's parent.
+// Nodes without meshes only get a transform.
+Entity processAssimpNodeEntities(
+	const aiNode* node,
+	const aiScene* scene,
+	const std::filesystem::path& modelPath,
+	std::unordered_map<std::string, Texture>& loadedTextures,
+	EntityStore& store,
+	Entity parent,
+	const ImportOptions& options
+) {
+	Entity entity{ store.create(node->mNumMeshes > 0 ? Components::renderable : Components::transform) };
+	store.transform(entity).baseTransform = fromAssimpMatrix(node->mTransformation);
+	if (parent.isValid()) {
+		store.setParent(entity, parent);
+	}
+
+	if (node->mNumMeshes > 0) {
+		MeshRef& ref{ store.meshRef(entity) };
+		ref.first = static_cast<uint32_t>(store.meshes.size());
+		ref.count = node->mNumMeshes;
+		for (size_t i{ 0 }; i < node->mNumMeshes; ++i) {
+			aiMesh* mesh{ scene->mMeshes[node->mMeshes[i]] };
+			store.meshes.emplace_back(fromAssimpMesh(mesh, scene, modelPath, loadedTextures, options));
+			store.bounds(entity).local.expand(store.meshes.back().bounds);
+		}
+	}
+
+	for (size_t i{ 0 }; i < node->mNumChildren; ++i) {
+		processAssimpNodeEntities(node->mChildren[i], scene, modelPath, loadedTextures, store, entity, options);
+	}
+	return entity;
+}
@@ -0,0 +1,47 @@
+#include "Bounds.h"
+
+bool BoundingBox::isEmpty() const {
+	return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+glm::vec3 BoundingBox::center() const {
+	return (min + max) * 0.5f;
+}
+
+glm::vec3 BoundingBox::extents() const {
+	return (max - min) * 0.5f;
+}
+
+bool BoundingBox::contains(const glm::vec3& point, float margin) const {
+	for (int i{ 0 }; i < 3; ++i) {
+		if (point[i] < min[i] - margin || point[i] > max[i] + margin) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void BoundingBox::expand(const glm::vec3& point) {
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+}
+
+void BoundingBox::expand(const BoundingBox& box) {
+	min = glm::min(min, box.min);
+	max = glm::max(max, box.max);
+}
+
+BoundingBox BoundingBox::transformed(const glm::mat4& matrix) const {
+	if (isEmpty()) {
+		return *this;
+	}
+	// Transform the center, then find the extents of the rotated box by projecting the original
+	// extents onto each world axis. Cheaper than transforming all 8 corners.
+	glm::vec3 newCenter{ matrix * glm::vec4{ center(), 1 } };
+	glm::vec3 e{ extents() };
+	glm::vec3 newExtents{};
+	for (int i{ 0 }; i < 3; ++i) {
+		newExtents[i] = glm::abs(matrix[0][i]) * e.x + glm::abs(matrix[1][i]) * e.y + glm::abs(matrix[2][i]) * e.z;
+	}
+	return BoundingBox{ newCenter - newExtents, newCenter + newExtents };
+}
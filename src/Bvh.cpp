@@ -0,0 +1,357 @@
+#include "Bvh.h"
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+namespace {
+	// Leaves hold at most this many items; fewer if SAH says a split is not worth it.
+	constexpr uint32_t maxLeafItems{ 4 };
+	// Centroids are sorted into this many buckets per axis when evaluating splits.
+	constexpr uint32_t binCount{ 12 };
+	// Past this depth nodes become leaves regardless of size, which bounds the traversal stacks.
+	constexpr uint32_t maxDepth{ 64 };
+	constexpr uint32_t noParent{ std::numeric_limits<uint32_t>::max() };
+	// Marks a stack entry whose whole subtree is known to be inside the frustum.
+	constexpr uint32_t insideBit{ 1u << 31 };
+
+	float surfaceArea(const BoundingBox& box) {
+		if (box.isEmpty()) {
+			return 0;
+		}
+		glm::vec3 e{ box.max - box.min };
+		return 2 * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	bool sameBounds(const BoundingBox& a, const BoundingBox& b) {
+		return a.min == b.min && a.max == b.max;
+	}
+
+	// The distance along the ray at which it enters the box, or a negative value if it misses.
+	float rayEnterDistance(const Ray& ray, const glm::vec3& inverseDirection, const BoundingBox& box, float maxDistance) {
+		glm::vec3 t0{ (box.min - ray.origin) * inverseDirection };
+		glm::vec3 t1{ (box.max - ray.origin) * inverseDirection };
+		glm::vec3 tNear{ glm::min(t0, t1) };
+		glm::vec3 tFar{ glm::max(t0, t1) };
+		float enter{ glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f)) };
+		float exit{ glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, maxDistance)) };
+		return enter <= exit ? enter : -1.0f;
+	}
+
+	bool sphereIntersects(const BoundingSphere& sphere, const BoundingBox& box) {
+		glm::vec3 closest{ glm::clamp(sphere.center, box.min, box.max) };
+		glm::vec3 d{ closest - sphere.center };
+		return glm::dot(d, d) <= sphere.radius * sphere.radius;
+	}
+}
+
+void Bvh::build(const std::vector<BoundingBox>& itemBounds) {
+	m_itemBounds = itemBounds;
+	rebuild();
+}
+
+void Bvh::rebuild() {
+	uint32_t count{ static_cast<uint32_t>(m_itemBounds.size()) };
+	m_nodes.clear();
+	m_dirtyLeaves.clear();
+	m_items.resize(count);
+	std::iota(m_items.begin(), m_items.end(), 0);
+	m_itemLeaf.assign(count, 0);
+
+	if (count > 0) {
+		m_nodes.reserve(2 * static_cast<size_t>(count));
+		m_nodes.push_back(Node{ {}, 0, 0, noParent });
+		subdivide(0, 0, count, 0);
+	}
+	m_builtCost = cost();
+}
+
+void Bvh::subdivide(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth) {
+	BoundingBox bounds{};
+	BoundingBox centroidBounds{};
+	for (uint32_t i{ first }; i < first + count; ++i) {
+		const BoundingBox& b{ m_itemBounds[m_items[i]] };
+		bounds.expand(b);
+		centroidBounds.expand(b.center());
+	}
+	m_nodes[nodeIndex].bounds = bounds;
+
+	auto makeLeaf{ [&]() {
+		m_nodes[nodeIndex].first = first;
+		m_nodes[nodeIndex].count = count;
+		for (uint32_t i{ first }; i < first + count; ++i) {
+			m_itemLeaf[m_items[i]] = nodeIndex;
+		}
+	} };
+	if (count <= maxLeafItems || depth >= maxDepth) {
+		makeLeaf();
+		return;
+	}
+
+	// Evaluate the SAH cost of splitting at each bin boundary along each axis, and keep the cheapest.
+	// A split costs one traversal step plus each child's item count weighted by the chance of a query
+	// reaching it, which is proportional to its surface area.
+	float parentArea{ surfaceArea(bounds) };
+	float bestCost{ static_cast<float>(count) };
+	int bestAxis{ -1 };
+	uint32_t bestSplit{ 0 };
+	glm::vec3 centroidExtent{ centroidBounds.max - centroidBounds.min };
+	for (int axis{ 0 }; axis < 3; ++axis) {
+		if (centroidExtent[axis] <= 0) {
+			continue;
+		}
+		BoundingBox binBounds[binCount]{};
+		uint32_t binItems[binCount]{};
+		float binScale{ binCount / centroidExtent[axis] };
+		for (uint32_t i{ first }; i < first + count; ++i) {
+			const BoundingBox& b{ m_itemBounds[m_items[i]] };
+			uint32_t bin{ std::min(binCount - 1, static_cast<uint32_t>((b.center()[axis] - centroidBounds.min[axis]) * binScale)) };
+			binBounds[bin].expand(b);
+			++binItems[bin];
+		}
+
+		// Sweep from the right to get the area and item count of every possible right-hand side...
+		float rightArea[binCount]{};
+		uint32_t rightItems[binCount]{};
+		BoundingBox sweep{};
+		uint32_t sweepItems{ 0 };
+		for (uint32_t bin{ binCount - 1 }; bin > 0; --bin) {
+			sweep.expand(binBounds[bin]);
+			sweepItems += binItems[bin];
+			rightArea[bin] = surfaceArea(sweep);
+			rightItems[bin] = sweepItems;
+		}
+		// ... then from the left, combining with the right-hand side of the same boundary.
+		sweep = BoundingBox{};
+		sweepItems = 0;
+		for (uint32_t split{ 1 }; split < binCount; ++split) {
+			sweep.expand(binBounds[split - 1]);
+			sweepItems += binItems[split - 1];
+			if (sweepItems == 0 || rightItems[split] == 0) {
+				continue;
+			}
+			float splitCost{ 1.0f + (surfaceArea(sweep) * sweepItems + rightArea[split] * rightItems[split]) / parentArea };
+			if (splitCost < bestCost) {
+				bestCost = splitCost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+	if (bestAxis < 0 || parentArea <= 0) {
+		makeLeaf();
+		return;
+	}
+
+	float binScale{ binCount / centroidExtent[bestAxis] };
+	auto middle{ std::partition(m_items.begin() + first, m_items.begin() + first + count, [&](uint32_t item) {
+		uint32_t bin{ std::min(binCount - 1, static_cast<uint32_t>((m_itemBounds[item].center()[bestAxis] - centroidBounds.min[bestAxis]) * binScale)) };
+		return bin < bestSplit;
+	}) };
+	uint32_t leftCount{ static_cast<uint32_t>(middle - (m_items.begin() + first)) };
+
+	uint32_t left{ static_cast<uint32_t>(m_nodes.size()) };
+	m_nodes.push_back(Node{ {}, 0, 0, nodeIndex });
+	m_nodes.push_back(Node{ {}, 0, 0, nodeIndex });
+	m_nodes[nodeIndex].first = left;
+	m_nodes[nodeIndex].count = 0;
+	subdivide(left, first, leftCount, depth + 1);
+	subdivide(left + 1, first + leftCount, count - leftCount, depth + 1);
+}
+
+void Bvh::update(uint32_t item, const BoundingBox& bounds) {
+	m_itemBounds[item] = bounds;
+	m_dirtyLeaves.push_back(m_itemLeaf[item]);
+}
+
+bool Bvh::refit() {
+	if (m_dirtyLeaves.empty()) {
+		return false;
+	}
+
+	auto refitLeaf{ [&](Node& leaf) {
+		BoundingBox bounds{};
+		for (uint32_t i{ leaf.first }; i < leaf.first + leaf.count; ++i) {
+			bounds.expand(m_itemBounds[m_items[i]]);
+		}
+		leaf.bounds = bounds;
+	} };
+
+	if (m_dirtyLeaves.size() > m_nodes.size() / 8) {
+		// So much has moved that one bottom-up pass over every node is cheaper than walking each path.
+		// Children are always stored after their parent, so a reverse walk visits them first.
+		for (size_t i{ m_nodes.size() }; i-- > 0;) {
+			Node& node{ m_nodes[i] };
+			if (node.count > 0) {
+				refitLeaf(node);
+			}
+			else {
+				node.bounds = m_nodes[node.first].bounds;
+				node.bounds.expand(m_nodes[node.first + 1].bounds);
+			}
+		}
+	}
+	else {
+		for (uint32_t leaf : m_dirtyLeaves) {
+			refitLeaf(m_nodes[leaf]);
+			// Walk towards the root, stopping as soon as an ancestor's bounds come out unchanged.
+			for (uint32_t i{ m_nodes[leaf].parent }; i != noParent; i = m_nodes[i].parent) {
+				Node& node{ m_nodes[i] };
+				BoundingBox bounds{ m_nodes[node.first].bounds };
+				bounds.expand(m_nodes[node.first + 1].bounds);
+				if (sameBounds(bounds, node.bounds)) {
+					break;
+				}
+				node.bounds = bounds;
+			}
+		}
+	}
+	m_dirtyLeaves.clear();
+
+	if (cost() > m_builtCost * rebuildThreshold) {
+		rebuild();
+		return true;
+	}
+	return false;
+}
+
+float Bvh::cost() const {
+	if (m_nodes.empty()) {
+		return 0;
+	}
+	float rootArea{ surfaceArea(m_nodes[0].bounds) };
+	if (rootArea <= 0) {
+		return static_cast<float>(m_items.size());
+	}
+	float total{ 0 };
+	for (auto& node : m_nodes) {
+		float weight{ node.count > 0 ? static_cast<float>(node.count) : 1.0f };
+		total += weight * surfaceArea(node.bounds) / rootArea;
+	}
+	return total;
+}
+
+size_t Bvh::itemCount() const {
+	return m_itemBounds.size();
+}
+
+size_t Bvh::nodeCount() const {
+	return m_nodes.size();
+}
+
+void Bvh::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const {
+	if (m_nodes.empty()) {
+		return;
+	}
+	uint32_t stack[2 * maxDepth + 2];
+	uint32_t top{ 0 };
+	stack[top++] = 0;
+	while (top > 0) {
+		uint32_t entry{ stack[--top] };
+		bool inside{ (entry & insideBit) != 0 };
+		const Node& node{ m_nodes[entry & ~insideBit] };
+		if (!inside) {
+			if (!frustum.intersects(node.bounds)) {
+				continue;
+			}
+			// Once a node is entirely inside, nothing beneath it needs to be tested again.
+			inside = frustum.contains(node.bounds);
+		}
+
+		if (node.count > 0) {
+			for (uint32_t i{ node.first }; i < node.first + node.count; ++i) {
+				if (inside || frustum.intersects(m_itemBounds[m_items[i]])) {
+					results.push_back(m_items[i]);
+				}
+			}
+		}
+		else {
+			uint32_t flag{ inside ? insideBit : 0 };
+			stack[top++] = node.first | flag;
+			stack[top++] = (node.first + 1) | flag;
+		}
+	}
+}
+
+void Bvh::querySphere(const BoundingSphere& sphere, std::vector<uint32_t>& results) const {
+	if (m_nodes.empty()) {
+		return;
+	}
+	uint32_t stack[2 * maxDepth + 2];
+	uint32_t top{ 0 };
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node{ m_nodes[stack[--top]] };
+		if (!sphereIntersects(sphere, node.bounds)) {
+			continue;
+		}
+		if (node.count > 0) {
+			for (uint32_t i{ node.first }; i < node.first + node.count; ++i) {
+				if (sphereIntersects(sphere, m_itemBounds[m_items[i]])) {
+					results.push_back(m_items[i]);
+				}
+			}
+		}
+		else {
+			stack[top++] = node.first;
+			stack[top++] = node.first + 1;
+		}
+	}
+}
+
+bool Bvh::raycast(const Ray& ray, float maxDistance, uint32_t& hitItem, float& hitDistance) const {
+	if (m_nodes.empty()) {
+		return false;
+	}
+	glm::vec3 inverseDirection{ 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z };
+	float best{ maxDistance };
+	bool hit{ false };
+
+	struct Entry {
+		uint32_t node;
+		float distance;
+	};
+	Entry stack[2 * maxDepth + 2];
+	uint32_t top{ 0 };
+	float rootDistance{ rayEnterDistance(ray, inverseDirection, m_nodes[0].bounds, best) };
+	if (rootDistance >= 0) {
+		stack[top++] = Entry{ 0, rootDistance };
+	}
+	while (top > 0) {
+		Entry entry{ stack[--top] };
+		if (entry.distance > best) {
+			continue;
+		}
+		const Node& node{ m_nodes[entry.node] };
+		if (node.count > 0) {
+			for (uint32_t i{ node.first }; i < node.first + node.count; ++i) {
+				float d{ rayEnterDistance(ray, inverseDirection, m_itemBounds[m_items[i]], best) };
+				if (d >= 0 && (!hit || d < best)) {
+					best = d;
+					hitItem = m_items[i];
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		// Push the farther child first, so the nearer one is explored first and can shrink the search.
+		float left{ rayEnterDistance(ray, inverseDirection, m_nodes[node.first].bounds, best) };
+		float right{ rayEnterDistance(ray, inverseDirection, m_nodes[node.first + 1].bounds, best) };
+		Entry near{ node.first, left };
+		Entry far{ node.first + 1, right };
+		if (right >= 0 && (left < 0 || right < left)) {
+			std::swap(near, far);
+		}
+		if (far.distance >= 0) {
+			stack[top++] = far;
+		}
+		if (near.distance >= 0) {
+			stack[top++] = near;
+		}
+	}
+
+	if (hit) {
+		hitDistance = best;
+	}
+	return hit;
+}
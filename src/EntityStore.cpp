@@ -0,0 +1,308 @@
+#include "EntityStore.h"
+#include "FrameStats.h"
+#include <algorithm>
+
+namespace {
+	void appendRow(Archetype& archetype, Entity entity) {
+		archetype.entities.push_back(entity);
+		if (archetype.mask & Components::transform) {
+			archetype.transforms.emplace_back();
+			archetype.localMatrices.emplace_back(1.0f);
+			archetype.worldMatrices.emplace_back(1.0f);
+		}
+		if (archetype.mask & Components::meshRef) {
+			archetype.meshRefs.emplace_back();
+		}
+		if (archetype.mask & Components::material) {
+			archetype.materials.emplace_back();
+		}
+		if (archetype.mask & Components::bounds) {
+			archetype.bounds.emplace_back();
+			archetype.visible.push_back(1);
+		}
+	}
+
+	// Remove an element by moving the last one into its place.
+	template <typename T>
+	void swapRemove(std::vector<T>& column, uint32_t row) {
+		if (column.empty()) {
+			return;
+		}
+		column[row] = std::move(column.back());
+		column.pop_back();
+	}
+}
+
+Entity EntityStore::create(ComponentMask components) {
+	uint32_t index{};
+	if (!m_freeSlots.empty()) {
+		index = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else {
+		index = static_cast<uint32_t>(m_locations.size());
+		m_locations.emplace_back();
+	}
+
+	uint32_t archetype{ archetypeFor(components) };
+	Location& location{ m_locations[index] };
+	Entity entity{ index, location.generation };
+	location.archetype = archetype;
+	location.row = static_cast<uint32_t>(m_archetypes[archetype].size());
+	location.alive = true;
+	appendRow(m_archetypes[archetype], entity);
+	++m_entityCount;
+	return entity;
+}
+
+void EntityStore::destroy(Entity entity) {
+	const Location& location{ locate(entity) };
+	removeRow(location.archetype, location.row);
+
+	Location& slot{ m_locations[entity.index] };
+	slot.alive = false;
+	++slot.generation;
+	m_freeSlots.push_back(entity.index);
+	--m_entityCount;
+	// Children of this entity become roots.
+	m_hierarchyDirty = true;
+}
+
+bool EntityStore::isAlive(Entity entity) const {
+	return entity.index < m_locations.size() && m_locations[entity.index].alive
+		&& m_locations[entity.index].generation == entity.generation;
+}
+
+void EntityStore::setComponents(Entity entity, ComponentMask components) {
+	Location old{ locate(entity) };
+	if (m_archetypes[old.archetype].mask == components) {
+		return;
+	}
+
+	// Find the new archetype first: creating it may reallocate m_archetypes.
+	uint32_t target{ archetypeFor(components) };
+	Archetype& from{ m_archetypes[old.archetype] };
+	Archetype& to{ m_archetypes[target] };
+	uint32_t row{ static_cast<uint32_t>(to.size()) };
+	appendRow(to, entity);
+
+	// Carry over every component the entity keeps.
+	ComponentMask kept{ from.mask & to.mask };
+	if (kept & Components::transform) {
+		to.transforms[row] = from.transforms[old.row];
+		to.localMatrices[row] = from.localMatrices[old.row];
+		to.worldMatrices[row] = from.worldMatrices[old.row];
+	}
+	if (kept & Components::meshRef) {
+		to.meshRefs[row] = from.meshRefs[old.row];
+	}
+	if (kept & Components::material) {
+		to.materials[row] = from.materials[old.row];
+	}
+	if (kept & Components::bounds) {
+		to.bounds[row] = from.bounds[old.row];
+		to.visible[row] = from.visible[old.row];
+	}
+
+	removeRow(old.archetype, old.row);
+	Location& location{ m_locations[entity.index] };
+	location.archetype = target;
+	location.row = row;
+	m_hierarchyDirty = true;
+}
+
+ComponentMask EntityStore::components(Entity entity) const {
+	return m_archetypes[locate(entity).archetype].mask;
+}
+
+Transform& EntityStore::transform(Entity entity) {
+	const Location& location{ locate(entity) };
+	return m_archetypes[location.archetype].transforms[location.row];
+}
+
+MeshRef& EntityStore::meshRef(Entity entity) {
+	const Location& location{ locate(entity) };
+	return m_archetypes[location.archetype].meshRefs[location.row];
+}
+
+Material& EntityStore::material(Entity entity) {
+	const Location& location{ locate(entity) };
+	return m_archetypes[location.archetype].materials[location.row];
+}
+
+Bounds& EntityStore::bounds(Entity entity) {
+	const Location& location{ locate(entity) };
+	return m_archetypes[location.archetype].bounds[location.row];
+}
+
+const glm::mat4& EntityStore::worldMatrix(Entity entity) const {
+	const Location& location{ locate(entity) };
+	return m_archetypes[location.archetype].worldMatrices[location.row];
+}
+
+bool EntityStore::setParent(Entity child, Entity parent) {
+	if (!hasTransform(child) || !hasTransform(parent)) {
+		return false;
+	}
+	transform(child).parent = parent;
+	m_hierarchyDirty = true;
+	return true;
+}
+
+bool EntityStore::hasTransform(Entity entity) const {
+	return isAlive(entity) && (components(entity) & Components::transform);
+}
+
+std::vector<Archetype>& EntityStore::archetypes() {
+	return m_archetypes;
+}
+
+size_t EntityStore::entityCount() const {
+	return m_entityCount;
+}
+
+uint32_t EntityStore::archetypeFor(ComponentMask mask) {
+	for (uint32_t i{ 0 }; i < m_archetypes.size(); ++i) {
+		if (m_archetypes[i].mask == mask) {
+			return i;
+		}
+	}
+	m_archetypes.push_back(Archetype{ mask });
+	return static_cast<uint32_t>(m_archetypes.size() - 1);
+}
+
+void EntityStore::removeRow(uint32_t archetypeIndex, uint32_t row) {
+	Archetype& archetype{ m_archetypes[archetypeIndex] };
+	Entity moved{ archetype.entities.back() };
+	swapRemove(archetype.entities, row);
+	swapRemove(archetype.transforms, row);
+	swapRemove(archetype.localMatrices, row);
+	swapRemove(archetype.worldMatrices, row);
+	swapRemove(archetype.meshRefs, row);
+	swapRemove(archetype.materials, row);
+	swapRemove(archetype.bounds, row);
+	swapRemove(archetype.visible, row);
+	if (row < archetype.size()) {
+		m_locations[moved.index].row = row;
+	}
+}
+
+const EntityStore::Location& EntityStore::locate(Entity entity) const {
+	return m_locations[entity.index];
+}
+
+void updateTransforms(EntityStore& store) {
+	// Every local matrix, one archetype at a time through the batched kernel. Roots are done after this.
+	for (auto& archetype : store.m_archetypes) {
+		if (!(archetype.mask & Components::transform) || archetype.size() == 0) {
+			continue;
+		}
+		store.m_batch.clear();
+		for (auto& t : archetype.transforms) {
+			store.m_batch.add(t.position, t.orientation, t.scale, t.center, t.baseTransform);
+		}
+		buildModelMatrices(store.m_batch, archetype.localMatrices.data());
+		archetype.worldMatrices = archetype.localMatrices;
+	}
+
+	if (store.m_hierarchyDirty) {
+		// Sort every entity that has a live parent with a transform by its depth, so parents are resolved
+		// before children. A parent without one (it may have lost it since setParent) ends the chain.
+		std::vector<std::pair<uint32_t, Entity>> byDepth{};
+		for (auto& archetype : store.m_archetypes) {
+			if (!(archetype.mask & Components::transform)) {
+				continue;
+			}
+			for (uint32_t row{ 0 }; row < archetype.size(); ++row) {
+				uint32_t depth{ 0 };
+				for (Entity p{ archetype.transforms[row].parent }; store.hasTransform(p) && depth < 64; ++depth) {
+					p = store.transform(p).parent;
+				}
+				if (depth > 0) {
+					byDepth.emplace_back(depth, archetype.entities[row]);
+				}
+			}
+		}
+		std::stable_sort(byDepth.begin(), byDepth.end(),
+			[](const auto& a, const auto& b) { return a.first < b.first; });
+		store.m_hierarchyOrder.clear();
+		for (auto& [depth, entity] : byDepth) {
+			store.m_hierarchyOrder.push_back(entity);
+		}
+		store.m_hierarchyDirty = false;
+	}
+
+	for (Entity entity : store.m_hierarchyOrder) {
+		const EntityStore::Location& location{ store.locate(entity) };
+		Archetype& archetype{ store.m_archetypes[location.archetype] };
+		const glm::mat4& parentWorld{ store.worldMatrix(archetype.transforms[location.row].parent) };
+		archetype.worldMatrices[location.row] = parentWorld * archetype.localMatrices[location.row];
+	}
+}
+
+uint32_t cullEntities(EntityStore& store, const Frustum& frustum, const OcclusionCuller* occlusion) {
+	uint32_t culled{ 0 };
+	for (auto& archetype : store.archetypes()) {
+		if ((archetype.mask & (Components::transform | Components::bounds)) != (Components::transform | Components::bounds)) {
+			continue;
+		}
+		for (size_t row{ 0 }; row < archetype.size(); ++row) {
+			Bounds& b{ archetype.bounds[row] };
+			b.world = b.local.transformed(archetype.worldMatrices[row]);
+			bool visible{ frustum.intersects(b.world) };
+			culled += visible ? 0 : 1;
+			if (visible && occlusion != nullptr && occlusion->isOccluded(b.world)) {
+				visible = false;
+				++frameStats().occluded;
+			}
+			archetype.visible[row] = visible;
+		}
+	}
+	return culled;
+}
+
+void buildDrawList(EntityStore& store, std::vector<EntityDraw>& drawList) {
+	drawList.clear();
+	for (auto& archetype : store.archetypes()) {
+		if ((archetype.mask & (Components::transform | Components::meshRef)) != (Components::transform | Components::meshRef)) {
+			continue;
+		}
+		// Entities without bounds can't be culled, so they are always drawn.
+		bool hasBounds{ (archetype.mask & Components::bounds) != 0 };
+		bool hasMaterial{ (archetype.mask & Components::material) != 0 };
+		for (size_t row{ 0 }; row < archetype.size(); ++row) {
+			if (hasBounds && !archetype.visible[row]) {
+				continue;
+			}
+			const MeshRef& ref{ archetype.meshRefs[row] };
+			for (uint32_t m{ ref.first }; m < ref.first + ref.count; ++m) {
+				drawList.push_back(EntityDraw{ &store.meshes[m], &archetype.worldMatrices[row],
+					hasMaterial ? &archetype.materials[row].parameters : nullptr });
+			}
+		}
+	}
+}
+
+void drawEntities(const std::vector<EntityDraw>& drawList, ShaderProgram& program) {
+	const glm::mat4* model{ nullptr };
+	const glm::vec4* material{ nullptr };
+	for (auto& draw : drawList) {
+		if (draw.model != model) {
+			model = draw.model;
+			program.setUniform("model", *model);
+		}
+		if (draw.material != nullptr && draw.material != material) {
+			material = draw.material;
+			program.setUniform("material", *material);
+		}
+		draw.mesh->drawMesh(program);
+	}
+	frameStats().visibleMeshes += static_cast<uint32_t>(drawList.size());
+}
+
+void enqueueEntities(const std::vector<EntityDraw>& drawList, ShaderProgram& program, RenderQueue& queue) {
+	for (auto& draw : drawList) {
+		queue.add(program, *draw.mesh, *draw.model, draw.material, draw.mesh->bounds.transformed(*draw.model));
+	}
+	frameStats().visibleMeshes += static_cast<uint32_t>(drawList.size());
+}
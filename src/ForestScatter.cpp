@@ -0,0 +1,280 @@
+#include "ForestScatter.h"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include "FrameStats.h"
+
+namespace {
+	uint64_t splitMix(uint64_t x) {
+		x += 0x9e3779b97f4a7c15ull;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+		return x ^ (x >> 31);
+	}
+
+	uint64_t hashCoords(uint64_t seed, int32_t x, int32_t z, uint64_t salt) {
+		return splitMix(splitMix(splitMix(seed ^ salt) ^ static_cast<uint32_t>(x)) ^ static_cast<uint32_t>(z));
+	}
+
+	// A small generator whose output is the same with every compiler and standard library, unlike the
+	// <random> distributions, so a seed always grows the same forest.
+	struct Random {
+		uint64_t state;
+
+		float next() {
+			state = splitMix(state);
+			return static_cast<float>(state >> 40) / static_cast<float>(1 << 24);
+		}
+		float range(float low, float high) {
+			return low + (high - low) * next();
+		}
+	};
+
+	// Smooth value noise in [0, 1] with features about cellSize apart, for varying the density.
+	float densityNoise(uint64_t seed, float x, float z, float cellSize) {
+		float fx{ x / cellSize };
+		float fz{ z / cellSize };
+		int32_t ix{ static_cast<int32_t>(std::floor(fx)) };
+		int32_t iz{ static_cast<int32_t>(std::floor(fz)) };
+		float tx{ fx - ix };
+		float tz{ fz - iz };
+		tx = tx * tx * (3 - 2 * tx);
+		tz = tz * tz * (3 - 2 * tz);
+		auto corner{ [&](int32_t cx, int32_t cz) {
+			return static_cast<float>(hashCoords(seed, cx, cz, 0x6e6f697365ull) >> 40) / static_cast<float>(1 << 24);
+		} };
+		float top{ glm::mix(corner(ix, iz), corner(ix + 1, iz), tx) };
+		float bottom{ glm::mix(corner(ix, iz + 1), corner(ix + 1, iz + 1), tx) };
+		return glm::mix(top, bottom, tz);
+	}
+
+	// Bridson's Poisson-disk sampling over the square [min, min + size), keeping margin away from its edges.
+	std::vector<glm::vec2> poissonDisk(Random& random, glm::vec2 min, float size, float spacing, float margin) {
+		constexpr uint32_t attempts{ 30 };
+		std::vector<glm::vec2> samples{};
+		float inner{ size - 2 * margin };
+		if (inner <= 0) {
+			return samples;
+		}
+		min = min + glm::vec2{ margin, margin };
+
+		// Each grid cell is small enough to hold at most one sample.
+		float cellSize{ spacing / std::numbers::sqrt2_v<float> };
+		int32_t gridSize{ static_cast<int32_t>(std::ceil(inner / cellSize)) };
+		std::vector<int32_t> grid(static_cast<size_t>(gridSize) * gridSize, -1);
+		auto cellOf{ [&](glm::vec2 p) {
+			glm::vec2 cell{ (p - min) / cellSize };
+			return glm::ivec2{ std::clamp(static_cast<int32_t>(cell.x), 0, gridSize - 1),
+				std::clamp(static_cast<int32_t>(cell.y), 0, gridSize - 1) };
+		} };
+		auto fits{ [&](glm::vec2 p) {
+			if (p.x < min.x || p.y < min.y || p.x >= min.x + inner || p.y >= min.y + inner) {
+				return false;
+			}
+			glm::ivec2 cell{ cellOf(p) };
+			for (int32_t y{ std::max(cell.y - 2, 0) }; y <= std::min(cell.y + 2, gridSize - 1); ++y) {
+				for (int32_t x{ std::max(cell.x - 2, 0) }; x <= std::min(cell.x + 2, gridSize - 1); ++x) {
+					int32_t other{ grid[y * gridSize + x] };
+					if (other >= 0 && glm::distance(samples[other], p) < spacing) {
+						return false;
+					}
+				}
+			}
+			return true;
+		} };
+		auto insert{ [&](glm::vec2 p) {
+			glm::ivec2 cell{ cellOf(p) };
+			grid[cell.y * gridSize + cell.x] = static_cast<int32_t>(samples.size());
+			samples.push_back(p);
+		} };
+
+		insert(min + glm::vec2{ random.next(), random.next() } * inner);
+		std::vector<uint32_t> active{ 0 };
+		while (!active.empty()) {
+			size_t pick{ std::min(static_cast<size_t>(random.next() * active.size()), active.size() - 1) };
+			glm::vec2 origin{ samples[active[pick]] };
+			bool placed{ false };
+			for (uint32_t i{ 0 }; i < attempts; ++i) {
+				float angle{ random.next() * 2 * std::numbers::pi_v<float> };
+				float distance{ spacing * (1 + random.next()) };
+				glm::vec2 candidate{ origin + distance * glm::vec2{ std::cos(angle), std::sin(angle) } };
+				if (fits(candidate)) {
+					active.push_back(static_cast<uint32_t>(samples.size()));
+					insert(candidate);
+					placed = true;
+					break;
+				}
+			}
+			if (!placed) {
+				active[pick] = active.back();
+				active.pop_back();
+			}
+		}
+		return samples;
+	}
+}
+
+ForestScatter::ForestScatter(uint32_t seed, float chunkSize, float loadRadius, float unloadRadius)
+	: m_seed{ seed }, m_chunkSize{ chunkSize }, m_loadRadius{ loadRadius },
+	m_unloadRadius{ std::max(unloadRadius, loadRadius) } {
+}
+
+ForestScatter::~ForestScatter() {
+	for (auto& [key, chunk] : m_chunks) {
+		if (chunk->job) {
+			jobSystem().wait(chunk->job);
+		}
+	}
+}
+
+void ForestScatter::addRule(const ScatterRule& rule) {
+	m_rules.push_back(rule);
+}
+
+uint64_t ForestScatter::chunkKey(int32_t x, int32_t z) {
+	return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z);
+}
+
+std::vector<std::vector<glm::mat4>> ForestScatter::generateChunk(int32_t chunkX, int32_t chunkZ) const {
+	return scatterChunk(Layout{ m_seed, m_chunkSize, m_rules, keepOut }, chunkX, chunkZ);
+}
+
+std::vector<std::vector<glm::mat4>> ForestScatter::scatterChunk(const Layout& layout, int32_t chunkX, int32_t chunkZ) {
+	const std::vector<ScatterRule>& rules{ layout.rules };
+	std::vector<std::vector<glm::mat4>> instances(rules.size());
+	std::vector<std::vector<glm::vec2>> placed(rules.size());
+	glm::vec2 origin{ chunkX * layout.chunkSize, chunkZ * layout.chunkSize };
+
+	for (uint32_t r{ 0 }; r < rules.size(); ++r) {
+		const ScatterRule& rule{ rules[r] };
+		Random random{ hashCoords(layout.seed, chunkX, chunkZ, r) };
+		for (glm::vec2 p : poissonDisk(random, origin, layout.chunkSize, rule.spacing, rule.spacing / 2)) {
+			// Draw every random number for a sample up front, so rejecting it doesn't shift the samples after it.
+			float keep{ random.next() };
+			float yaw{ random.range(0, 2 * std::numbers::pi_v<float>) };
+			float scale{ rule.baseScale * random.range(rule.minScale, rule.maxScale) };
+
+			if (keep >= rule.density * densityNoise(layout.seed + r, p.x, p.y, 8 * rule.spacing)) {
+				continue;
+			}
+			auto blocked{ [&](const glm::vec3& disc) { return glm::distance(p, glm::vec2{ disc.x, disc.y }) < disc.z; } };
+			if (std::any_of(layout.keepOut.begin(), layout.keepOut.end(), blocked)) {
+				continue;
+			}
+			bool crowded{ false };
+			for (uint32_t earlier{ 0 }; earlier < r && !crowded; ++earlier) {
+				for (glm::vec2 other : placed[earlier]) {
+					if (glm::distance(p, other) < rule.clearance) {
+						crowded = true;
+						break;
+					}
+				}
+			}
+			if (crowded) {
+				continue;
+			}
+
+			placed[r].push_back(p);
+			glm::mat4 transform{ glm::translate(glm::mat4{ 1 }, glm::vec3{ p.x, rule.height, p.y }) };
+			transform = glm::rotate(transform, yaw, glm::vec3{ 0, 1, 0 });
+			instances[r].push_back(glm::scale(transform, glm::vec3{ scale }));
+		}
+	}
+	return instances;
+}
+
+bool ForestScatter::update(const glm::vec3& cameraPos) {
+	bool changed{ false };
+	glm::vec2 camera{ cameraPos.x, cameraPos.z };
+	auto distanceTo{ [&](int32_t x, int32_t z) {
+		glm::vec2 center{ (static_cast<float>(x) + 0.5f) * m_chunkSize, (static_cast<float>(z) + 0.5f) * m_chunkSize };
+		return glm::distance(camera, center);
+	} };
+
+	// Drop chunks that are too far away. Pending ones are kept until they finish, so the destructor can
+	// wait for them.
+	for (auto it{ m_chunks.begin() }; it != m_chunks.end();) {
+		Chunk& chunk{ *it->second };
+		if (distanceTo(chunk.x, chunk.z) > m_unloadRadius && (!chunk.job || JobSystem::isDone(chunk.job))) {
+			changed |= !chunk.job;
+			it = m_chunks.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+
+	// Collect finished chunks.
+	jobSystem().progress();
+	uint32_t pending{ 0 };
+	for (auto& [key, chunk] : m_chunks) {
+		if (chunk->job && JobSystem::isDone(chunk->job)) {
+			chunk->job.reset();
+			changed = true;
+			++frameStats().chunksGenerated;
+		}
+		pending += chunk->job ? 1 : 0;
+	}
+
+	// Start the nearest missing chunks within range.
+	std::vector<std::pair<float, glm::ivec2>> missing{};
+	int32_t reach{ static_cast<int32_t>(std::ceil(m_loadRadius / m_chunkSize)) };
+	glm::ivec2 center{ static_cast<int32_t>(std::floor(camera.x / m_chunkSize)),
+		static_cast<int32_t>(std::floor(camera.y / m_chunkSize)) };
+	for (int32_t z{ center.y - reach }; z <= center.y + reach; ++z) {
+		for (int32_t x{ center.x - reach }; x <= center.x + reach; ++x) {
+			float distance{ distanceTo(x, z) };
+			if (distance <= m_loadRadius && !m_chunks.contains(chunkKey(x, z))) {
+				missing.emplace_back(distance, glm::ivec2{ x, z });
+			}
+		}
+	}
+	std::sort(missing.begin(), missing.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	if (!m_layout && !missing.empty()) {
+		m_layout = std::make_shared<const Layout>(Layout{ m_seed, m_chunkSize, m_rules, keepOut });
+	}
+	for (auto& [distance, coords] : missing) {
+		if (pending >= maxPendingChunks) {
+			break;
+		}
+		auto chunk{ std::make_shared<Chunk>() };
+		chunk->x = coords.x;
+		chunk->z = coords.y;
+		chunk->job = jobSystem().submit([layout = m_layout, chunk]() {
+			chunk->instances = scatterChunk(*layout, chunk->x, chunk->z);
+		});
+		m_chunks.emplace(chunkKey(coords.x, coords.y), chunk);
+		++pending;
+	}
+
+	frameStats().chunksLoaded = static_cast<uint32_t>(m_chunks.size() - pending);
+	return changed;
+}
+
+void ForestScatter::fillInstances(InstanceRenderer& renderer) const {
+	for (auto& rule : m_rules) {
+		renderer.clearInstances(rule.model);
+	}
+	for (auto& [key, chunk] : m_chunks) {
+		if (chunk->job) {
+			continue;
+		}
+		for (uint32_t r{ 0 }; r < std::min(m_rules.size(), chunk->instances.size()); ++r) {
+			for (auto& transform : chunk->instances[r]) {
+				renderer.addInstance(m_rules[r].model, transform);
+			}
+		}
+	}
+}
+
+size_t ForestScatter::loadedChunks() const {
+	size_t loaded{ 0 };
+	for (auto& [key, chunk] : m_chunks) {
+		loaded += chunk->job ? 0 : 1;
+	}
+	return loaded;
+}
+
+size_t ForestScatter::pendingChunks() const {
+	return m_chunks.size() - loadedChunks();
+}
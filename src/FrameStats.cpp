@@ -0,0 +1,32 @@
+#include "FrameStats.h"
+
+void FrameStats::reset() {
+	*this = FrameStats{};
+}
+
+void FrameStats::print(std::ostream& out) const {
+	out << "recomputed nodes: " << recomputedNodes << std::endl;
+	out << "culled nodes: " << culledNodes << ", meshes visible / culled: "
+		<< visibleMeshes << " / " << culledMeshes << std::endl;
+	out << "culled entities: " << culledEntities << std::endl;
+	out << "occluded: " << occluded << " (" << occlusionMilliseconds << " ms)" << std::endl;
+	out << "queries issued / read / hidden: " << queriesIssued << " / " << queryResults << " / " << queryOccluded
+		<< ", latency " << queryLatencyFrames << " frames" << std::endl;
+	out << "draw calls: " << drawCalls << ", state changes (program / textures / VAO): " << programChanges
+		<< " / " << textureChanges << " / " << vaoChanges << std::endl;
+	out << "indirect draws: " << indirectDraws << ", submit " << submitMilliseconds << " ms" << std::endl;
+	out << "stream buffer: " << streamBytes / 1024 << " KB, fence wait " << streamWaitMilliseconds << " ms" << std::endl;
+	out << "triangles: " << triangles << " of " << fullDetailTriangles << " at full detail" << std::endl;
+	out << "meshlets visible / cone culled / frustum culled: " << meshletsVisible << " / " << meshletsConeCulled
+		<< " / " << meshletsFrustumCulled << std::endl;
+	out << "impostors: " << impostors << ", instances: " << instances << std::endl;
+	out << "forest chunks loaded: " << chunksLoaded << ", generated: " << chunksGenerated << std::endl;
+	out << "cells resident / loading: " << cellsResident << " / " << cellsLoading << ", " << streamingRamMegabytes
+		<< " MB RAM, " << streamingVramMegabytes << " MB VRAM; uploaded / evicted: " << cellsUploaded << " / "
+		<< cellsEvicted << ", load latency " << cellLoadMilliseconds << " ms" << std::endl;
+}
+
+FrameStats& frameStats() {
+	static FrameStats stats{};
+	return stats;
+}
@@ -0,0 +1,60 @@
+#include "Frustum.h"
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection) {
+	// Gribb & Hartmann: each clip plane is a sum or difference of the matrix's rows.
+	auto row{ [&](int i) {
+		return glm::vec4{ viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i] };
+	} };
+
+	Frustum f{};
+	f.planes[0] = row(3) + row(0); // left
+	f.planes[1] = row(3) - row(0); // right
+	f.planes[2] = row(3) + row(1); // bottom
+	f.planes[3] = row(3) - row(1); // top
+	f.planes[4] = row(3) + row(2); // near
+	f.planes[5] = row(3) - row(2); // far
+	for (auto& p : f.planes) {
+		p = p / glm::length(glm::vec3{ p });
+	}
+	return f;
+}
+
+bool Frustum::intersects(const BoundingBox& box) const {
+	for (auto& p : planes) {
+		// Test the corner of the box furthest along the plane's normal. If even that one is outside,
+		// the whole box is.
+		glm::vec3 corner{
+			p.x >= 0 ? box.max.x : box.min.x,
+			p.y >= 0 ? box.max.y : box.min.y,
+			p.z >= 0 ? box.max.z : box.min.z
+		};
+		if (glm::dot(glm::vec3{ p }, corner) + p.w < 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const {
+	for (auto& p : planes) {
+		if (glm::dot(glm::vec3{ p }, sphere.center) + p.w < -sphere.radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::contains(const BoundingBox& box) const {
+	for (auto& p : planes) {
+		// This time test the corner nearest to the plane; it must be inside as well.
+		glm::vec3 corner{
+			p.x >= 0 ? box.min.x : box.max.x,
+			p.y >= 0 ? box.min.y : box.max.y,
+			p.z >= 0 ? box.min.z : box.max.z
+		};
+		if (glm::dot(glm::vec3{ p }, corner) + p.w < 0) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,323 @@
+#include <glad/glad.h>
+#include "GeometryArena.h"
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include "Mesh.h"
+
+namespace {
+	// The first buffers hold this many vertices and bytes of indices; later ones at least double.
+	constexpr uint32_t initialVertices{ 1 << 17 };
+	constexpr uint32_t initialIndexBytes{ 1 << 21 };
+}
+
+uint32_t vertexStride(VertexFormat format) {
+	switch (format) {
+	case VertexFormat::standard:
+		return sizeof(Vertex3D);
+	case VertexFormat::packed:
+		return sizeof(PackedVertex);
+	default:
+		return 0;
+	}
+}
+
+void GeometryArena::FreeList::reset(uint32_t capacity, uint32_t used) {
+	m_capacity = capacity;
+	m_used = used;
+	m_blocks.clear();
+	if (used < capacity) {
+		m_blocks.push_back(Block{ used, capacity - used });
+	}
+}
+
+uint32_t GeometryArena::FreeList::allocate(uint32_t size, uint32_t alignment) {
+	for (size_t i{ 0 }; i < m_blocks.size(); ++i) {
+		Block block{ m_blocks[i] };
+		uint32_t offset{ (block.offset + alignment - 1) / alignment * alignment };
+		uint32_t padding{ offset - block.offset };
+		if (block.size < padding + size) {
+			continue;
+		}
+		// Take the aligned part of the block, leaving the padding before it and the rest after it free.
+		uint32_t rest{ block.size - padding - size };
+		if (padding > 0) {
+			m_blocks[i].size = padding;
+			if (rest > 0) {
+				m_blocks.insert(m_blocks.begin() + i + 1, Block{ offset + size, rest });
+			}
+		}
+		else if (rest > 0) {
+			m_blocks[i] = Block{ offset + size, rest };
+		}
+		else {
+			m_blocks.erase(m_blocks.begin() + i);
+		}
+		m_used += size;
+		return offset;
+	}
+	return m_capacity;
+}
+
+void GeometryArena::FreeList::free(uint32_t offset, uint32_t size) {
+	if (size == 0) {
+		return;
+	}
+	m_used -= size;
+	// Keep the blocks sorted by offset, merging the freed one with its neighbours.
+	auto next{ std::lower_bound(m_blocks.begin(), m_blocks.end(), offset,
+		[](const Block& block, uint32_t offset) { return block.offset < offset; }) };
+	if (next != m_blocks.begin()) {
+		auto previous{ next - 1 };
+		if (previous->offset + previous->size == offset) {
+			previous->size += size;
+			if (next != m_blocks.end() && offset + size == next->offset) {
+				previous->size += next->size;
+				m_blocks.erase(next);
+			}
+			return;
+		}
+	}
+	if (next != m_blocks.end() && offset + size == next->offset) {
+		next->offset = offset;
+		next->size += size;
+		return;
+	}
+	m_blocks.insert(next, Block{ offset, size });
+}
+
+uint32_t GeometryArena::FreeList::capacity() const {
+	return m_capacity;
+}
+
+uint32_t GeometryArena::FreeList::used() const {
+	return m_used;
+}
+
+uint32_t GeometryArena::FreeList::holes() const {
+	uint32_t free{ m_capacity - m_used };
+	if (!m_blocks.empty() && m_blocks.back().offset + m_blocks.back().size == m_capacity) {
+		free -= m_blocks.back().size;
+	}
+	return free;
+}
+
+size_t GeometryArena::FreeList::blocks() const {
+	return m_blocks.size();
+}
+
+GeometryArena::GeometryArena(VertexFormat format) : m_format{ format } {
+	m_vao = GlVertexArray::create();
+	rebuild(initialVertices, initialIndexBytes);
+}
+
+std::shared_ptr<const GeometryRange> GeometryArena::allocate(const void* vertices, uint32_t vertexCount,
+	const void* indices, uint32_t indexCount, uint32_t indexSize) {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	uint32_t indexBytes{ indexCount * indexSize };
+	uint32_t baseVertex{ m_freeVertices.allocate(vertexCount) };
+	uint32_t indexOffset{ m_freeIndexBytes.allocate(indexBytes, indexSize) };
+	if (baseVertex == m_freeVertices.capacity() || indexOffset == m_freeIndexBytes.capacity()) {
+		// Give back whichever half did fit, grow, and take both from the end of the packed buffers.
+		if (baseVertex != m_freeVertices.capacity()) {
+			m_freeVertices.free(baseVertex, vertexCount);
+		}
+		if (indexOffset != m_freeIndexBytes.capacity()) {
+			m_freeIndexBytes.free(indexOffset, indexBytes);
+		}
+		rebuild(std::max(m_freeVertices.capacity() * 2, m_freeVertices.used() + vertexCount),
+			std::max(m_freeIndexBytes.capacity() * 2, m_freeIndexBytes.used() + indexBytes + indexSize));
+		baseVertex = m_freeVertices.allocate(vertexCount);
+		indexOffset = m_freeIndexBytes.allocate(indexBytes, indexSize);
+	}
+
+	uint32_t stride{ vertexStride(m_format) };
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertices.id());
+	glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(baseVertex) * stride,
+		static_cast<GLsizeiptr>(vertexCount) * stride, vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_indices.id());
+	glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	auto range{ new GeometryRange{ baseVertex, vertexCount, indexOffset / indexSize, indexCount, indexSize } };
+	m_live.push_back(range);
+	return std::shared_ptr<const GeometryRange>{ range, [this](const GeometryRange* range) {
+		release(const_cast<GeometryRange*>(range));
+	} };
+}
+
+void GeometryArena::release(GeometryRange* range) {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	// Draws already issued may still read the range; GL orders the upload that reuses it after them.
+	m_freeVertices.free(range->baseVertex, range->vertexCount);
+	m_freeIndexBytes.free(range->firstIndex * range->indexSize, range->indexCount * range->indexSize);
+	auto live{ std::find(m_live.begin(), m_live.end(), range) };
+	*live = m_live.back();
+	m_live.pop_back();
+	delete range;
+}
+
+uint32_t GeometryArena::vao() const {
+	return m_vao.id();
+}
+
+void GeometryArena::bindBuffers() const {
+	uint32_t stride{ vertexStride(m_format) };
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertices.id());
+	switch (m_format) {
+	case VertexFormat::standard:
+		// Attribute 0 is position (3 floats), 1 is texture coords (2 floats), and 2 is normal (3 floats).
+		glVertexAttribPointer(0, 3, GL_FLOAT, false, stride, 0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 2, GL_FLOAT, false, stride, (void*) 12);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 3, GL_FLOAT, false, stride, (void*) 20);
+		glEnableVertexAttribArray(2);
+		break;
+	case VertexFormat::packed:
+		// Normalized 16-bit positions, half float texture coords, and an octahedral normal in two snorm16s;
+		// the shader decodes them with the mesh's VertexDecode.
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, true, stride, 0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 2, GL_HALF_FLOAT, false, stride, (void*) 12);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_SHORT, true, stride, (void*) 8);
+		glEnableVertexAttribArray(2);
+		break;
+	default:
+		break;
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indices.id());
+}
+
+uint32_t GeometryArena::generation() const {
+	return m_generation;
+}
+
+bool GeometryArena::compact(float maxWaste) {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	uint32_t vertexHoles{ m_freeVertices.holes() };
+	uint32_t indexHoles{ m_freeIndexBytes.holes() };
+	if (vertexHoles <= maxWaste * m_freeVertices.used() && indexHoles <= maxWaste * m_freeIndexBytes.used()) {
+		return false;
+	}
+	rebuild(m_freeVertices.capacity(), m_freeIndexBytes.capacity());
+	++m_compactions;
+	return true;
+}
+
+void GeometryArena::rebuild(uint32_t vertexCapacity, uint32_t indexBytes) {
+	uint32_t stride{ vertexStride(m_format) };
+	GlBuffer vertices{ GlBuffer::create() };
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vertices.id());
+	glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(vertexCapacity) * stride, nullptr, GL_STATIC_DRAW);
+	vertices.account(VramCategory::vertex, static_cast<size_t>(vertexCapacity) * stride);
+	GlBuffer indices{ GlBuffer::create() };
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indices.id());
+	glBufferData(GL_COPY_WRITE_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+	indices.account(VramCategory::index, indexBytes);
+
+	// Copy each live range to the start of the new buffers, keeping the vertices in order so neighbours stay
+	// close. Indices are packed by width, 32-bit ranges first, so none of them needs padding to stay aligned.
+	std::sort(m_live.begin(), m_live.end(), [](const GeometryRange* a, const GeometryRange* b) {
+		return a->baseVertex < b->baseVertex;
+	});
+	uint32_t vertexEnd{ 0 };
+	glBindBuffer(GL_COPY_READ_BUFFER, m_vertices.id());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vertices.id());
+	for (auto range : m_live) {
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(range->baseVertex) * stride,
+			static_cast<GLintptr>(vertexEnd) * stride, static_cast<GLsizeiptr>(range->vertexCount) * stride);
+		range->baseVertex = vertexEnd;
+		vertexEnd += range->vertexCount;
+	}
+	uint32_t indexEnd{ 0 };
+	glBindBuffer(GL_COPY_READ_BUFFER, m_indices.id());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indices.id());
+	for (uint32_t width : { 4u, 2u }) {
+		for (auto range : m_live) {
+			if (range->indexSize != width) {
+				continue;
+			}
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+				static_cast<GLintptr>(range->firstIndex) * width, indexEnd, static_cast<GLsizeiptr>(range->indexCount) * width);
+			range->firstIndex = indexEnd / width;
+			indexEnd += range->indexCount * width;
+		}
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	// The old buffers are retired, and deleted once the draws that read them have finished.
+	m_vertices = std::move(vertices);
+	m_indices = std::move(indices);
+	m_freeVertices.reset(vertexCapacity, vertexEnd);
+	m_freeIndexBytes.reset(indexBytes, indexEnd);
+
+	glBindVertexArray(m_vao.id());
+	bindBuffers();
+	glBindVertexArray(0);
+	++m_generation;
+}
+
+size_t GeometryArena::liveRanges() const {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	return m_live.size();
+}
+
+void GeometryArena::printStats(std::ostream& out) const {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	auto print{ [&](const char* name, const FreeList& list) {
+		out << "  " << std::left << std::setw(12) << name << std::right << list.used() << " / " << list.capacity()
+			<< " used, " << list.holes() << " in " << list.blocks() << " free blocks" << std::endl;
+	} };
+	out << "Geometry arena (" << (m_format == VertexFormat::packed ? "packed" : "standard") << "): "
+		<< m_live.size() << " meshes, " << m_compactions << " compactions" << std::endl;
+	print("vertices", m_freeVertices);
+	print("index bytes", m_freeIndexBytes);
+	// Which index width each mesh got, and what the 16-bit ones saved over 32-bit indices.
+	size_t shortMeshes{ 0 };
+	size_t shortIndices{ 0 };
+	for (auto range : m_live) {
+		if (range->indexSize == 2) {
+			++shortMeshes;
+			shortIndices += range->indexCount;
+		}
+	}
+	out << "  " << shortMeshes << " meshes with 16-bit indices, " << m_live.size() - shortMeshes << " with 32-bit; "
+		<< shortIndices * 2 / 1024 << " KB saved" << std::endl;
+}
+
+namespace {
+	// One slot per vertex format, filled on first use so formats nothing loads never allocate buffers.
+	std::array<std::unique_ptr<GeometryArena>, static_cast<size_t>(VertexFormat::count)>& arenaSlots() {
+		static std::array<std::unique_ptr<GeometryArena>, static_cast<size_t>(VertexFormat::count)> arenas{};
+		return arenas;
+	}
+}
+
+GeometryArena& geometryArena(VertexFormat format) {
+	auto& arena{ arenaSlots()[static_cast<size_t>(format)] };
+	if (!arena) {
+		arena = std::make_unique<GeometryArena>(format);
+	}
+	return *arena;
+}
+
+uint32_t compactGeometryArenas(float maxWaste) {
+	uint32_t compacted{ 0 };
+	for (auto& arena : arenaSlots()) {
+		if (arena && arena->compact(maxWaste)) {
+			++compacted;
+		}
+	}
+	return compacted;
+}
+
+void printGeometryArenaStats(std::ostream& out) {
+	for (auto& arena : arenaSlots()) {
+		if (arena) {
+			arena->printStats(out);
+		}
+	}
+}
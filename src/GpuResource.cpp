@@ -0,0 +1,177 @@
+#include <glad/glad.h>
+#include "GpuResource.h"
+#include <iomanip>
+
+namespace {
+	const char* typeNames[]{ "buffers", "vertex arrays", "textures", "programs", "framebuffers", "renderbuffers",
+		"queries" };
+	const char* categoryNames[]{ "vertex", "index", "texture", "mip levels", "render target", "stream" };
+
+	float toMegabytes(size_t bytes) {
+		return static_cast<float>(bytes) / (1 << 20);
+	}
+}
+
+uint32_t GpuResources::generate(GpuObjectType type) {
+	uint32_t id{ 0 };
+	switch (type) {
+	case GpuObjectType::buffer:
+		glGenBuffers(1, &id);
+		break;
+	case GpuObjectType::vertexArray:
+		glGenVertexArrays(1, &id);
+		break;
+	case GpuObjectType::texture:
+		glGenTextures(1, &id);
+		break;
+	case GpuObjectType::program:
+		id = glCreateProgram();
+		break;
+	case GpuObjectType::framebuffer:
+		glGenFramebuffers(1, &id);
+		break;
+	case GpuObjectType::renderbuffer:
+		glGenRenderbuffers(1, &id);
+		break;
+	case GpuObjectType::query:
+		glGenQueries(1, &id);
+		break;
+	default:
+		break;
+	}
+	return id;
+}
+
+void GpuResources::track(GpuObjectType type) {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	++m_liveObjects[static_cast<size_t>(type)];
+}
+
+void GpuResources::retire(GpuObjectType type, uint32_t id, const std::array<Accounting, 2>& accounting) {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	m_retired.push_back(Retired{ type, id, accounting });
+}
+
+void GpuResources::account(VramCategory category, int64_t bytes) {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	m_bytes[static_cast<size_t>(category)] += bytes;
+}
+
+void GpuResources::destroy(const Retired& object) {
+	switch (object.type) {
+	case GpuObjectType::buffer:
+		glDeleteBuffers(1, &object.id);
+		break;
+	case GpuObjectType::vertexArray:
+		glDeleteVertexArrays(1, &object.id);
+		break;
+	case GpuObjectType::texture:
+		glDeleteTextures(1, &object.id);
+		break;
+	case GpuObjectType::program:
+		glDeleteProgram(object.id);
+		break;
+	case GpuObjectType::framebuffer:
+		glDeleteFramebuffers(1, &object.id);
+		break;
+	case GpuObjectType::renderbuffer:
+		glDeleteRenderbuffers(1, &object.id);
+		break;
+	case GpuObjectType::query:
+		glDeleteQueries(1, &object.id);
+		break;
+	default:
+		break;
+	}
+	--m_liveObjects[static_cast<size_t>(object.type)];
+	for (auto& slot : object.accounting) {
+		if (slot.category != VramCategory::count) {
+			m_bytes[static_cast<size_t>(slot.category)] -= slot.bytes;
+		}
+	}
+}
+
+void GpuResources::endFrame() {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	if (!m_retired.empty()) {
+		m_fenced.push_back(FencedBatch{ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(m_retired) });
+		m_retired.clear();
+	}
+
+	// Fences signal in order, so stop at the first one that hasn't.
+	size_t finished{ 0 };
+	for (; finished < m_fenced.size(); ++finished) {
+		GLsync fence{ static_cast<GLsync>(m_fenced[finished].fence) };
+		GLenum status{ glClientWaitSync(fence, 0, 0) };
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			break;
+		}
+		glDeleteSync(fence);
+		for (auto& object : m_fenced[finished].objects) {
+			destroy(object);
+		}
+	}
+	m_fenced.erase(m_fenced.begin(), m_fenced.begin() + finished);
+}
+
+void GpuResources::flush() {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	glFinish();
+	for (auto& batch : m_fenced) {
+		glDeleteSync(static_cast<GLsync>(batch.fence));
+		for (auto& object : batch.objects) {
+			destroy(object);
+		}
+	}
+	m_fenced.clear();
+	for (auto& object : m_retired) {
+		destroy(object);
+	}
+	m_retired.clear();
+}
+
+size_t GpuResources::bytes(VramCategory category) const {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	return m_bytes[static_cast<size_t>(category)];
+}
+
+size_t GpuResources::totalBytes() const {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	size_t total{ 0 };
+	for (size_t bytes : m_bytes) {
+		total += bytes;
+	}
+	return total;
+}
+
+size_t GpuResources::liveObjects(GpuObjectType type) const {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	return m_liveObjects[static_cast<size_t>(type)];
+}
+
+void GpuResources::printTable(std::ostream& out) const {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	size_t pending{ m_retired.size() };
+	for (auto& batch : m_fenced) {
+		pending += batch.objects.size();
+	}
+	out << "GPU objects (" << pending << " waiting for deletion):" << std::endl;
+	for (size_t i{ 0 }; i < m_liveObjects.size(); ++i) {
+		out << "  " << std::left << std::setw(16) << typeNames[i] << std::right << m_liveObjects[i] << std::endl;
+	}
+	size_t total{ 0 };
+	out << "VRAM:" << std::endl;
+	for (size_t i{ 0 }; i < m_bytes.size(); ++i) {
+		out << "  " << std::left << std::setw(16) << categoryNames[i] << std::right << std::fixed
+			<< std::setprecision(2) << toMegabytes(m_bytes[i]) << " MB" << std::defaultfloat << std::endl;
+		total += m_bytes[i];
+	}
+	out << "  " << std::left << std::setw(16) << "total" << std::right << std::fixed << std::setprecision(2)
+		<< toMegabytes(total) << " MB" << std::defaultfloat << std::endl;
+}
+
+GpuResources& gpuResources() {
+	// Never destroyed, so handles held by other statics can still retire into it at exit.
+	static GpuResources* resources{ new GpuResources{} };
+	return *resources;
+}
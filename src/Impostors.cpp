@@ -0,0 +1,218 @@
+#include <glad/glad.h>
+#include "Impostors.h"
+#include "FrameStats.h"
+#include "StreamBuffer.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace {
+	// The inverse of octEncode in impostor.vert: a point of [-1, 1]^2 back to a unit direction.
+	glm::vec3 octDecode(const glm::vec2& p) {
+		glm::vec3 n{ p.x, p.y, 1 - std::abs(p.x) - std::abs(p.y) };
+		if (n.z < 0) {
+			glm::vec2 folded{ (1 - std::abs(n.y)) * (n.x >= 0 ? 1.0f : -1.0f), (1 - std::abs(n.x)) * (n.y >= 0 ? 1.0f : -1.0f) };
+			n.x = folded.x;
+			n.y = folded.y;
+		}
+		n = glm::normalize(n);
+		return glm::vec3{ n.x, n.z, n.y };
+	}
+
+	// An atlas with mipmaps down to maxLevel, which are generated once the views are baked.
+	GlTexture createAtlasTexture(uint32_t size, uint32_t maxLevel) {
+		GlTexture texture{ GlTexture::create() };
+		glBindTexture(GL_TEXTURE_2D, texture.id());
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<int32_t>(maxLevel));
+		glBindTexture(GL_TEXTURE_2D, 0);
+		// RGBA8, plus at most a third for the mipmaps.
+		texture.account(VramCategory::texture, static_cast<size_t>(size) * size * 4 * 4 / 3);
+		return texture;
+	}
+
+	// Writes a texture as an uncompressed 32-bit TGA.
+	void writeTga(const std::string& path, uint32_t texture, uint32_t size) {
+		std::vector<uint8_t> pixels(static_cast<size_t>(size) * size * 4);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_BGRA, GL_UNSIGNED_BYTE, pixels.data());
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		// Bottom-left origin, like OpenGL, so no flipping is needed.
+		uint8_t header[18]{};
+		header[2] = 2;
+		header[12] = size & 0xFF;
+		header[13] = (size >> 8) & 0xFF;
+		header[14] = size & 0xFF;
+		header[15] = (size >> 8) & 0xFF;
+		header[16] = 32;
+		header[17] = 8;
+		std::ofstream out{ path, std::ios::binary };
+		out.write(reinterpret_cast<const char*>(header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+	}
+}
+
+void ImpostorRenderer::load() {
+	m_bakeProgram.load("shaders/light_perspective.vert", "shaders/impostor_bake.frag");
+	m_drawProgram.load("shaders/impostor.vert", "shaders/impostor.frag");
+
+	const float corners[]{ -1, -1,  1, -1,  1, 1,  -1, -1,  1, 1,  -1, 1 };
+	m_quadVao = GlVertexArray::create();
+	glBindVertexArray(m_quadVao.id());
+	m_quadVbo = GlBuffer::create();
+	glBindBuffer(GL_ARRAY_BUFFER, m_quadVbo.id());
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	m_quadVbo.account(VramCategory::vertex, sizeof(corners));
+	glVertexAttribPointer(0, 2, GL_FLOAT, false, 2 * sizeof(float), 0);
+	glEnableVertexAttribArray(0);
+
+	// One vec4 per instance, written to the stream buffer every frame.
+	glEnableVertexAttribArray(1);
+	glVertexAttribDivisor(1, 1);
+	glBindVertexArray(0);
+}
+
+uint32_t ImpostorRenderer::bake(SceneObject& object, uint32_t gridSize, uint32_t cellResolution) {
+	object.updateWorldMatrices();
+	const BoundingBox& bounds{ object.worldBounds() };
+	glm::vec3 center{ bounds.center() };
+
+	Impostor impostor{};
+	impostor.gridSize = gridSize;
+	impostor.cellResolution = cellResolution;
+	impostor.radius = glm::length(bounds.extents());
+	// Each view is drawn inside a transparent border, so that filtering a mip level only reads texels of
+	// the same view. A texel of level n spans 2^n texels of the atlas, and a bilinear sample reaches one texel
+	// out, so the border sets the last level that stays within a cell.
+	impostor.cellPadding = std::max(cellResolution / 16, 1u);
+	uint32_t maxLevel{ 0 };
+	while ((2u << maxLevel) <= impostor.cellPadding) {
+		++maxLevel;
+	}
+	uint32_t atlasSize{ gridSize * cellResolution };
+	impostor.colorTexture = createAtlasTexture(atlasSize, maxLevel);
+	impostor.normalTexture = createAtlasTexture(atlasSize, maxLevel);
+
+	// The framebuffer and its depth buffer are only needed for the bake; their handles retire them after.
+	GlFramebuffer fbo{ GlFramebuffer::create() };
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo.id());
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, impostor.colorTexture.id(), 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, impostor.normalTexture.id(), 0);
+	GlRenderbuffer depth{ GlRenderbuffer::create() };
+	glBindRenderbuffer(GL_RENDERBUFFER, depth.id());
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasSize, atlasSize);
+	depth.account(VramCategory::renderTarget, static_cast<size_t>(atlasSize) * atlasSize * 4);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth.id());
+	const GLenum drawBuffers[]{ GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Impostor framebuffer is incomplete" << std::endl;
+	}
+
+	int32_t viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	float clearColor[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+	glClearColor(0, 0, 0, 0);
+	glViewport(0, 0, atlasSize, atlasSize);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	m_bakeProgram.activate();
+	float r{ impostor.radius };
+	m_bakeProgram.setUniform("projection", glm::ortho(-r, r, -r, r, 0.0f, 4 * r));
+	for (uint32_t y{ 0 }; y < gridSize; ++y) {
+		for (uint32_t x{ 0 }; x < gridSize; ++x) {
+			glm::vec2 p{ (x + 0.5f) / gridSize * 2 - 1, (y + 0.5f) / gridSize * 2 - 1 };
+			glm::vec3 dir{ octDecode(p) };
+			// The same basis impostor.vert builds its quads with.
+			glm::vec3 right{ std::abs(dir.y) < 0.999f ? glm::normalize(glm::cross(glm::vec3{ 0, 1, 0 }, dir))
+				: glm::vec3{ 1, 0, 0 } };
+			glm::vec3 up{ glm::cross(dir, right) };
+			m_bakeProgram.setUniform("view", glm::lookAt(center + dir * 2.0f * r, center, up));
+			uint32_t padding{ impostor.cellPadding };
+			glViewport(x * cellResolution + padding, y * cellResolution + padding, cellResolution - 2 * padding,
+				cellResolution - 2 * padding);
+			object.drawObject(m_bakeProgram);
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	// Distant impostors cover a few pixels each; without mipmaps they shimmer as they move.
+	for (const GlTexture* texture : { &impostor.colorTexture, &impostor.normalTexture }) {
+		glBindTexture(GL_TEXTURE_2D, texture->id());
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+
+	m_impostors.push_back(std::move(impostor));
+	return static_cast<uint32_t>(m_impostors.size() - 1);
+}
+
+void ImpostorRenderer::beginFrame() {
+	for (auto& impostor : m_impostors) {
+		impostor.instances.clear();
+	}
+}
+
+void ImpostorRenderer::addInstance(uint32_t impostor, const glm::vec3& center, float scale) {
+	Impostor& i{ m_impostors[impostor] };
+	i.instances.emplace_back(center, i.radius * scale);
+}
+
+void ImpostorRenderer::draw(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos,
+	const glm::vec3& directionalLight, const glm::vec3& ambientColor) {
+	m_drawProgram.activate();
+	m_drawProgram.setUniform("view", view);
+	m_drawProgram.setUniform("projection", projection);
+	m_drawProgram.setUniform("cameraPos", cameraPos);
+	m_drawProgram.setUniform("material", glm::vec4{ 0.2f, 0.8f, 0.4f, 32 });
+	m_drawProgram.setUniform("directionalLight", directionalLight);
+	m_drawProgram.setUniform("directionalColor", glm::vec3{ 1, 1, 1 });
+	m_drawProgram.setUniform("ambientColor", ambientColor);
+	m_drawProgram.setUniform("colorAtlas", 0);
+	m_drawProgram.setUniform("normalAtlas", 1);
+
+	glBindVertexArray(m_quadVao.id());
+	for (auto& impostor : m_impostors) {
+		if (impostor.instances.empty()) {
+			continue;
+		}
+		m_drawProgram.setUniform("gridSize", static_cast<float>(impostor.gridSize));
+		m_drawProgram.setUniform("cellInset", static_cast<float>(impostor.cellPadding) / impostor.cellResolution);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, impostor.colorTexture.id());
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, impostor.normalTexture.id());
+		StreamAllocation instances{ streamBuffer().upload(impostor.instances.data(),
+			impostor.instances.size() * sizeof(glm::vec4)) };
+		glBindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+		glVertexAttribPointer(1, 4, GL_FLOAT, false, sizeof(glm::vec4), reinterpret_cast<void*>(instances.offset));
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, static_cast<int32_t>(impostor.instances.size()));
+		frameStats().impostors += static_cast<uint32_t>(impostor.instances.size());
+		++frameStats().drawCalls;
+	}
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void ImpostorRenderer::dumpAtlases(const std::string& directory) const {
+	for (size_t i{ 0 }; i < m_impostors.size(); ++i) {
+		const Impostor& impostor{ m_impostors[i] };
+		uint32_t size{ impostor.gridSize * impostor.cellResolution };
+		std::string prefix{ directory + "/impostor" + std::to_string(i) };
+		writeTga(prefix + "_color.tga", impostor.colorTexture.id(), size);
+		writeTga(prefix + "_normal.tga", impostor.normalTexture.id(), size);
+		std::cout << "wrote " << prefix << "_color.tga and _normal.tga" << std::endl;
+	}
+}
+
+size_t ImpostorRenderer::impostorCount() const {
+	return m_impostors.size();
+}
@@ -0,0 +1,153 @@
+#include <glad/glad.h>
+#include "InstanceRenderer.h"
+#include "FrameStats.h"
+#include "StreamBuffer.h"
+#include "TransformBatch.h"
+
+namespace {
+	// Point the per-instance mat4 attribute (locations 3 to 6) of the bound VAO at the bound array buffer,
+	// starting at the given byte offset.
+	void setInstanceAttributes(size_t start) {
+		for (uint32_t column{ 0 }; column < 4; ++column) {
+			size_t offset{ start + column * sizeof(glm::vec4) };
+			glVertexAttribPointer(3 + column, 4, GL_FLOAT, false, sizeof(glm::mat4), reinterpret_cast<void*>(offset));
+		}
+	}
+}
+
+void InstanceRenderer::load() {
+	m_program.load("shaders/light_perspective_instanced.vert", "shaders/lighting.frag");
+}
+
+ShaderProgram& InstanceRenderer::program() {
+	return m_program;
+}
+
+uint32_t InstanceRenderer::registerModel(const SceneObject& object) {
+	Model model{};
+	// Only the root's center and base transform count; instance transforms stand in for the rest.
+	glm::mat4 root{ composeModelMatrix(glm::vec3{ 0 }, glm::vec3{ 0 }, glm::vec3{ 1 }, object.center, object.baseTransform) };
+	collectParts(model, object, glm::mat4{ 1 });
+	for (auto& part : model.parts) {
+		part.matrix = root * part.matrix;
+		model.bounds.expand(part.mesh.bounds.transformed(part.matrix));
+	}
+
+	m_models.push_back(std::move(model));
+	return static_cast<uint32_t>(m_models.size() - 1);
+}
+
+void InstanceRenderer::bindVertexArray(Model& model, VertexFormat format, uint32_t instanceBuffer) {
+	size_t f{ static_cast<size_t>(format) };
+	GeometryArena& arena{ geometryArena(format) };
+	if (!model.vaos[f]) {
+		model.vaos[f] = GlVertexArray::create();
+		model.arenaGenerations[f] = arena.generation() - 1;
+	}
+	glBindVertexArray(model.vaos[f].id());
+	if (model.arenaGenerations[f] != arena.generation()) {
+		// The arena replaced its buffers since the VAO last pointed at them.
+		arena.bindBuffers();
+		for (uint32_t column{ 0 }; column < 4; ++column) {
+			glEnableVertexAttribArray(3 + column);
+			glVertexAttribDivisor(3 + column, 1);
+		}
+		model.arenaGenerations[f] = arena.generation();
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+}
+
+void InstanceRenderer::collectParts(Model& model, const SceneObject& object, const glm::mat4& matrix) {
+	for (auto& mesh : object.meshes) {
+		model.parts.push_back(Part{ mesh, matrix });
+	}
+	for (auto& child : object.children) {
+		collectParts(model, child, matrix * child.buildModelMatrix());
+	}
+}
+
+uint32_t InstanceRenderer::addInstance(uint32_t model, const glm::mat4& transform) {
+	m_models[model].instances.push_back(transform);
+	return static_cast<uint32_t>(m_models[model].instances.size() - 1);
+}
+
+void InstanceRenderer::setInstance(uint32_t model, uint32_t instance, const glm::mat4& transform) {
+	m_models[model].instances[instance] = transform;
+}
+
+void InstanceRenderer::clearInstances(uint32_t model) {
+	m_models[model].instances.clear();
+}
+
+size_t InstanceRenderer::instanceCount(uint32_t model) const {
+	return m_models[model].instances.size();
+}
+
+void InstanceRenderer::draw(const Frustum& frustum, const glm::vec3& cameraPos, float projectionScale) {
+	FrameStats& stats{ frameStats() };
+	m_program.activate();
+	for (auto& model : m_models) {
+		if (model.instances.empty() || model.parts.empty()) {
+			continue;
+		}
+
+		// Cull the instances and sort the rest by level of detail, which is shared by all of the model's meshes.
+		size_t lodCount{ 0 };
+		for (auto& part : model.parts) {
+			lodCount = std::max(lodCount, part.mesh.lods.size());
+		}
+		model.visibleByLod.resize(lodCount);
+		for (auto& lod : model.visibleByLod) {
+			lod.clear();
+		}
+		for (auto& instance : model.instances) {
+			BoundingBox world{ model.bounds.transformed(instance) };
+			if (!frustum.intersects(world)) {
+				++stats.culledMeshes;
+				continue;
+			}
+			float distance{ glm::distance(cameraPos, world.center()) };
+			float radius{ glm::length(world.extents()) };
+			uint32_t level{ distance > radius ? Mesh::lodLevelFor(radius * projectionScale / distance) : 0 };
+			model.visibleByLod[std::min<size_t>(level, lodCount - 1)].push_back(instance);
+		}
+
+		model.upload.clear();
+		for (auto& lod : model.visibleByLod) {
+			model.upload.insert(model.upload.end(), lod.begin(), lod.end());
+		}
+		if (model.upload.empty()) {
+			continue;
+		}
+		stats.instances += static_cast<uint32_t>(model.upload.size());
+		StreamAllocation transforms{ streamBuffer().upload(model.upload.data(), model.upload.size() * sizeof(glm::mat4)) };
+
+		for (auto& part : model.parts) {
+			for (uint32_t i{ 0 }; i < part.mesh.textures.size(); ++i) {
+				glActiveTexture(GL_TEXTURE0 + i);
+				glBindTexture(GL_TEXTURE_2D, part.mesh.textures[i].textureId);
+				m_program.setUniform(part.mesh.textures[i].samplerName, static_cast<int32_t>(i));
+			}
+			m_program.setUniform("model", part.matrix);
+			bindVertexArray(model, part.mesh.format, transforms.buffer);
+			part.mesh.bindDecode();
+
+			size_t first{ 0 };
+			for (size_t level{ 0 }; level < lodCount; ++level) {
+				size_t count{ model.visibleByLod[level].size() };
+				if (count == 0) {
+					continue;
+				}
+				const MeshLod& lod{ part.mesh.lods[std::min(level, part.mesh.lods.size() - 1)] };
+				setInstanceAttributes(transforms.offset + first * sizeof(glm::mat4));
+				glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lod.indexCount, part.mesh.indexType,
+					part.mesh.indexOffset(lod), static_cast<int32_t>(count), part.mesh.baseVertex());
+				++stats.drawCalls;
+				stats.triangles += static_cast<uint32_t>(lod.indexCount / 3 * count);
+				stats.fullDetailTriangles += static_cast<uint32_t>(part.mesh.faceCount / 3 * count);
+				first += count;
+			}
+		}
+	}
+	glBindVertexArray(0);
+}
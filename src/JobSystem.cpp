@@ -0,0 +1,238 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <exception>
+
+struct JobSystem::Job {
+	std::function<void()> work;
+	// Dependencies that have not finished yet, plus one held by submit() until the job is fully wired up.
+	std::atomic<uint32_t> unfinishedDependencies{ 1 };
+	std::atomic<bool> done{ false };
+	// What the work threw, rethrown by wait(). Written before done is set.
+	std::exception_ptr exception{};
+	// Guards finished and continuations, so a dependent either registers before we finish or sees we have.
+	std::mutex mutex{};
+	bool finished{ false };
+	std::vector<JobHandle> continuations{};
+};
+
+namespace {
+	// The pool and queue index of the current thread, if it is a worker.
+	thread_local const JobSystem* t_pool{ nullptr };
+	thread_local size_t t_queueIndex{ 0 };
+
+	uint32_t g_maxWorkers{ std::max(1u, std::thread::hardware_concurrency()) - 1 };
+}
+
+JobSystem::JobSystem(uint32_t workerCount) {
+	for (uint32_t i{ 0 }; i <= workerCount; ++i) {
+		m_queues.push_back(std::make_unique<WorkQueue>());
+	}
+	for (uint32_t i{ 0 }; i < workerCount; ++i) {
+		m_workers.emplace_back([this, i]() { workerLoop(i); });
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock{ m_sleepMutex };
+		m_running = false;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+uint32_t JobSystem::workerCount() const {
+	return static_cast<uint32_t>(m_workers.size());
+}
+
+JobSystem::JobHandle JobSystem::submit(std::function<void()> work, std::initializer_list<JobHandle> dependencies) {
+	return submit(std::move(work), std::vector<JobHandle>{ dependencies });
+}
+
+JobSystem::JobHandle JobSystem::submit(std::function<void()> work, const std::vector<JobHandle>& dependencies) {
+	auto job{ std::make_shared<Job>() };
+	job->work = std::move(work);
+	job->unfinishedDependencies = static_cast<uint32_t>(dependencies.size()) + 1;
+
+	for (auto& dependency : dependencies) {
+		bool alreadyFinished{ true };
+		if (dependency != nullptr) {
+			std::lock_guard<std::mutex> lock{ dependency->mutex };
+			if (!dependency->finished) {
+				dependency->continuations.push_back(job);
+				alreadyFinished = false;
+			}
+		}
+		if (alreadyFinished) {
+			--job->unfinishedDependencies;
+		}
+	}
+
+	// Release the reference held while wiring; whoever drops the count to zero queues the job.
+	if (--job->unfinishedDependencies == 0) {
+		schedule(job);
+	}
+	return job;
+}
+
+void JobSystem::schedule(JobHandle job) {
+	// Workers keep their own follow-up work local; everyone else goes through the injection queue.
+	size_t queueIndex{ t_pool == this ? t_queueIndex : m_queues.size() - 1 };
+	{
+		WorkQueue& queue{ *m_queues[queueIndex] };
+		std::lock_guard<std::mutex> lock{ queue.mutex };
+		queue.jobs.push_back(std::move(job));
+	}
+	++m_queuedJobs;
+	{
+		// Taking the lock orders this with a worker checking m_queuedJobs before it sleeps.
+		std::lock_guard<std::mutex> lock{ m_sleepMutex };
+	}
+	m_wake.notify_one();
+}
+
+JobSystem::JobHandle JobSystem::takeJob(size_t queueIndex) {
+	// A thread's own queue is used as a stack, for cache locality with the job that just spawned the work;
+	// everyone else's is stolen from the other end, taking the oldest and usually largest work first.
+	bool own{ t_pool == this && t_queueIndex == queueIndex };
+	WorkQueue& queue{ *m_queues[queueIndex] };
+	std::lock_guard<std::mutex> lock{ queue.mutex };
+	if (queue.jobs.empty()) {
+		return nullptr;
+	}
+	JobHandle job{};
+	if (own) {
+		job = std::move(queue.jobs.back());
+		queue.jobs.pop_back();
+	}
+	else {
+		job = std::move(queue.jobs.front());
+		queue.jobs.pop_front();
+	}
+	--m_queuedJobs;
+	return job;
+}
+
+bool JobSystem::runOne() {
+	size_t start{ t_pool == this ? t_queueIndex : m_queues.size() - 1 };
+	for (size_t i{ 0 }; i < m_queues.size(); ++i) {
+		JobHandle job{ takeJob((start + i) % m_queues.size()) };
+		if (job != nullptr) {
+			// A job that throws still finishes, so nothing waiting on it hangs.
+			try {
+				job->work();
+			}
+			catch (...) {
+				job->exception = std::current_exception();
+			}
+			finish(job);
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::finish(const JobHandle& job) {
+	std::vector<JobHandle> continuations{};
+	{
+		std::lock_guard<std::mutex> lock{ job->mutex };
+		job->finished = true;
+		continuations.swap(job->continuations);
+	}
+	job->work = nullptr;
+	job->done.store(true, std::memory_order_release);
+
+	for (auto& continuation : continuations) {
+		if (--continuation->unfinishedDependencies == 0) {
+			schedule(std::move(continuation));
+		}
+	}
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+	t_pool = this;
+	t_queueIndex = index;
+	while (true) {
+		if (runOne()) {
+			continue;
+		}
+		std::unique_lock<std::mutex> lock{ m_sleepMutex };
+		m_wake.wait(lock, [this]() { return !m_running || m_queuedJobs > 0; });
+		if (!m_running) {
+			return;
+		}
+	}
+}
+
+bool JobSystem::isDone(const JobHandle& job) {
+	return job == nullptr || job->done.load(std::memory_order_acquire);
+}
+
+void JobSystem::wait(const JobHandle& job) {
+	while (!isDone(job)) {
+		if (!runOne()) {
+			std::this_thread::yield();
+		}
+	}
+	if (job != nullptr && job->exception) {
+		std::rethrow_exception(job->exception);
+	}
+}
+
+void JobSystem::progress() {
+	if (m_workers.empty()) {
+		runOne();
+	}
+}
+
+void JobSystem::parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& work) {
+	grainSize = std::max<size_t>(grainSize, 1);
+	size_t chunks{ (count + grainSize - 1) / grainSize };
+	if (chunks <= 1 || m_workers.empty()) {
+		if (count > 0) {
+			work(0, count);
+		}
+		return;
+	}
+
+	std::vector<JobHandle> jobs{};
+	jobs.reserve(chunks - 1);
+	for (size_t chunk{ 1 }; chunk < chunks; ++chunk) {
+		size_t begin{ chunk * grainSize };
+		size_t end{ std::min(count, begin + grainSize) };
+		jobs.push_back(submit([&work, begin, end]() { work(begin, end); }));
+	}
+	// Do the first chunk ourselves rather than sit idle. Every chunk refers to work, so all of them must
+	// finish before an exception from any of them leaves this function.
+	std::exception_ptr exception{};
+	try {
+		work(0, std::min(count, grainSize));
+	}
+	catch (...) {
+		exception = std::current_exception();
+	}
+	for (auto& job : jobs) {
+		try {
+			wait(job);
+		}
+		catch (...) {
+			if (!exception) {
+				exception = std::current_exception();
+			}
+		}
+	}
+	if (exception) {
+		std::rethrow_exception(exception);
+	}
+}
+
+void configureJobSystem(uint32_t maxWorkers) {
+	g_maxWorkers = maxWorkers;
+}
+
+JobSystem& jobSystem() {
+	static JobSystem system{ g_maxWorkers };
+	return system;
+}
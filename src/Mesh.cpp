@@ -1,6 +1,52 @@
 #include <glad/glad.h>
 #include "Mesh.h"
+#include <cmath>
 #include <cstdint>
+#include <glm/gtc/packing.hpp>
+
+namespace {
+	// Level i + 1 is used once a mesh covers less than lodScreenSizes[i] of the screen height.
+	constexpr float lodScreenSizes[]{ 0.5f, 0.25f, 0.1f, 0.04f };
+	// How far past a threshold the screen size must go before the level changes.
+	constexpr float lodHysteresis{ 0.15f };
+
+	int16_t toSnorm16(float value) {
+		return static_cast<int16_t>(std::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	// Quantize vertices into PackedVertex over the given bounds, and fill in how to decode them.
+	std::vector<PackedVertex> packVertices(const std::vector<Vertex3D>& vertices, const BoundingBox& bounds,
+		VertexDecode& decode) {
+		glm::vec3 size{ bounds.max - bounds.min };
+		decode.offset = glm::vec4{ bounds.min.x, bounds.min.y, bounds.min.z, 1 };
+		decode.scale = glm::vec4{ size.x, size.y, size.z, 0 };
+		auto quantize{ [](float value, float min, float size) {
+			float t{ size > 0 ? (value - min) / size : 0.0f };
+			return static_cast<uint16_t>(std::round(glm::clamp(t, 0.0f, 1.0f) * 65535.0f));
+		} };
+
+		std::vector<PackedVertex> packed{};
+		packed.reserve(vertices.size());
+		for (auto& v : vertices) {
+			// Project the normal onto the octahedron |x| + |y| + |z| = 1, and fold the lower half over the upper.
+			float length{ std::abs(v.nx) + std::abs(v.ny) + std::abs(v.nz) };
+			float ox{ length > 0 ? v.nx / length : 0.0f };
+			float oy{ length > 0 ? v.ny / length : 0.0f };
+			if (v.nz < 0) {
+				float fx{ (1 - std::abs(oy)) * (ox >= 0 ? 1.0f : -1.0f) };
+				float fy{ (1 - std::abs(ox)) * (oy >= 0 ? 1.0f : -1.0f) };
+				ox = fx;
+				oy = fy;
+			}
+			packed.push_back(PackedVertex{
+				quantize(v.x, bounds.min.x, size.x), quantize(v.y, bounds.min.y, size.y),
+				quantize(v.z, bounds.min.z, size.z), 0,
+				toSnorm16(ox), toSnorm16(oy),
+				glm::packHalf1x16(v.u), glm::packHalf1x16(v.v) });
+		}
+		return packed;
+	}
+}
 
 Mesh Mesh::square(std::vector<Texture> textures) {
 	Mesh m{
@@ -20,43 +66,45 @@ Mesh Mesh::square(std::vector<Texture> textures) {
 }
 
 Mesh::Mesh(const std::vector<Vertex3D> &vertices, const std::vector<uint32_t> &faces, 
-	std::vector<Texture> meshTextures)
-	: faceCount{ static_cast<uint32_t>(faces.size()) }, textures{std::move(meshTextures)}
+	std::vector<Texture> meshTextures, const std::vector<std::vector<uint32_t>>& lodFaces, VertexFormat vertexFormat,
+	std::shared_ptr<const MeshletSet> meshletSet)
+	: format{ vertexFormat }, vertexCount{ static_cast<uint32_t>(vertices.size()) }, faceCount{ static_cast<uint32_t>(faces.size()) }, textures{std::move(meshTextures)},
+	meshlets{ std::move(meshletSet) }
 {
-	// Generate a vertex array object on the GPU.
-	glGenVertexArrays(1, &vao);
-	// "Bind" the newly-generated vao, which makes future functions operate on that specific object.
-	glBindVertexArray(vao);
-
-	// Generate a vertex buffer object on the GPU.
-	uint32_t vbo;
-	glGenBuffers(1, &vbo);
-
-	// "Bind" the newly-generated vbo, which makes future functions operate on that specific object.
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	// This vbo is now associated with m_vao.
-	// Copy the contents of the vertices list to the buffer that lives on the GPU.
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex3D), &vertices[0], GL_STATIC_DRAW);
-
-
-	// TODO: use glVertexAttribPointer and glEnableVertexAttribArray to inform OpenGL about our
-	// vertex attributes. Attribute 0 is position (3 floats), 1 is texture coords (2 floats), and 
-	// 2 is normal (3 floats), 
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vertex3D), 0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 2, GL_FLOAT, false, sizeof(Vertex3D), (void*) 12);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 3, GL_FLOAT, false, sizeof(Vertex3D), (void*) 20);
-	glEnableVertexAttribArray(2);
+	// Record the mesh's bounds, so it can be culled without looking at its vertices again.
+	for (auto& v : vertices) {
+		bounds.expand(glm::vec3{ v.x, v.y, v.z });
+	}
+	boundingSphere.center = bounds.center();
+	for (auto& v : vertices) {
+		boundingSphere.radius = glm::max(boundingSphere.radius, glm::distance(boundingSphere.center, glm::vec3{ v.x, v.y, v.z }));
+	}
 
-	// Generate a second buffer, to store the indices of each triangle in the mesh.
-	uint32_t ebo;
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(uint32_t), &faces[0], GL_STATIC_DRAW);
+	// Copy the vertices and the indices of each triangle into the geometry arena, followed by the indices
+	// of each simplified level of detail.
+	lods.push_back(MeshLod{ 0, faceCount });
+	std::vector<uint32_t> allFaces{ faces };
+	for (auto& lod : lodFaces) {
+		lods.push_back(MeshLod{ static_cast<uint32_t>(allFaces.size()), static_cast<uint32_t>(lod.size()) });
+		allFaces.insert(allFaces.end(), lod.begin(), lod.end());
+	}
+	// Small meshes store their indices in 16 bits, halving their index memory.
+	uint32_t indexSize{ indexSizeFor(vertices.size()) };
+	indexType = indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	std::vector<uint16_t> shortFaces{};
+	if (indexSize == 2) {
+		shortFaces.assign(allFaces.begin(), allFaces.end());
+	}
+	const void* indices{ indexSize == 2 ? static_cast<const void*>(shortFaces.data()) : allFaces.data() };
 
-	// Unbind the vertex array, so no one else can accidentally mess with it.
-	glBindVertexArray(0);
+	GeometryArena& arena{ geometryArena(format) };
+	std::vector<PackedVertex> packed{};
+	if (format == VertexFormat::packed) {
+		packed = packVertices(vertices, bounds, decode);
+	}
+	const void* vertexData{ format == VertexFormat::packed ? static_cast<const void*>(packed.data()) : vertices.data() };
+	geometry = arena.allocate(vertexData, vertexCount, indices, static_cast<uint32_t>(allFaces.size()), indexSize);
+	vao = arena.vao();
 }
 
 void Mesh::drawMesh(ShaderProgram& program) const {
@@ -66,12 +114,52 @@ void Mesh::drawMesh(ShaderProgram& program) const {
 		program.setUniform(textures[i].samplerName, 0);
 	}
 	
+	bindDecode();
 	glBindVertexArray(vao);
-	// Draw the vertex array, using is "element buffer" to identify the faces, and whatever ShaderProgram
-	// has been activated prior to this.
-	glDrawElements(GL_TRIANGLES, faceCount, GL_UNSIGNED_INT, nullptr);
+	// Draw the mesh's range of the arena, using its "element buffer" to identify the faces, and whatever
+	// ShaderProgram has been activated prior to this.
+	glDrawElementsBaseVertex(GL_TRIANGLES, faceCount, indexType, indexOffset(lods[0]), baseVertex());
 	// Deactivate the mesh's vertex array.
 	glBindVertexArray(0);
 	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void Mesh::bindDecode() const {
+	glVertexAttrib4fv(7, &decode.offset.x);
+	glVertexAttrib4fv(8, &decode.scale.x);
+}
+
+const void* Mesh::indexOffset(const MeshLod& lod) const {
+	return reinterpret_cast<const void*>(static_cast<uintptr_t>(geometry->firstIndex + lod.firstIndex) * geometry->indexSize);
+}
+
+int32_t Mesh::baseVertex() const {
+	return static_cast<int32_t>(geometry->baseVertex);
+}
+
+uint32_t Mesh::indexSizeFor(size_t vertexCount) {
+	return vertexCount <= 0x10000 ? 2 : 4;
+}
+
+const MeshLod& Mesh::selectLod(float screenSize) const {
+	uint32_t last{ static_cast<uint32_t>(lods.size()) - 1 };
+	// Coarser while the mesh is clearly smaller than the current level's threshold...
+	while (currentLod < last && currentLod < std::size(lodScreenSizes)
+		&& screenSize < lodScreenSizes[currentLod] * (1 - lodHysteresis)) {
+		++currentLod;
+	}
+	// ... and finer while it is clearly bigger than the previous one's.
+	while (currentLod > 0 && screenSize > lodScreenSizes[currentLod - 1] * (1 + lodHysteresis)) {
+		--currentLod;
+	}
+	currentLod = std::min(currentLod, last);
+	return lods[currentLod];
+}
+
+uint32_t Mesh::lodLevelFor(float screenSize) {
+	uint32_t level{ 0 };
+	while (level < std::size(lodScreenSizes) && screenSize < lodScreenSizes[level]) {
+		++level;
+	}
+	return level;
+}
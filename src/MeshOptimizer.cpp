@@ -0,0 +1,278 @@
+#include "MeshOptimizer.h"
+#include <glm/ext.hpp>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace {
+	// The triangles around each vertex, stored as one list with an offset per vertex.
+	struct Adjacency {
+		std::vector<uint32_t> offsets{};
+		std::vector<uint32_t> triangles{};
+
+		Adjacency(const std::vector<uint32_t>& faces, size_t vertexCount) : offsets(vertexCount + 1, 0) {
+			for (uint32_t index : faces) {
+				++offsets[index + 1];
+			}
+			std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+			triangles.resize(faces.size());
+			std::vector<uint32_t> next{ offsets.begin(), offsets.end() - 1 };
+			for (size_t i{ 0 }; i < faces.size(); ++i) {
+				triangles[next[faces[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		uint32_t count(uint32_t vertex) const {
+			return offsets[vertex + 1] - offsets[vertex];
+		}
+	};
+
+	// A FIFO post-transform cache. A vertex is in it if fewer than size misses have happened since it was
+	// loaded, which is tracked with a timestamp per vertex instead of an actual queue.
+	class FifoCache {
+	public:
+		FifoCache(size_t vertexCount, uint32_t size) : m_loaded(vertexCount, 0), m_time{ size + 1 }, m_size{ size } {}
+
+		// Misses since the vertex was loaded.
+		uint32_t age(uint32_t vertex) const {
+			return m_time - m_loaded[vertex];
+		}
+
+		// Use a vertex, loading it if it isn't cached. Returns whether it missed.
+		bool access(uint32_t vertex) {
+			if (age(vertex) <= m_size) {
+				return false;
+			}
+			m_loaded[vertex] = m_time++;
+			return true;
+		}
+
+		void clear() {
+			m_time += m_size + 1;
+		}
+
+	private:
+		std::vector<uint32_t> m_loaded;
+		uint32_t m_time;
+		uint32_t m_size;
+	};
+
+	glm::vec3 position(const Vertex3D& v) {
+		return glm::vec3{ v.x, v.y, v.z };
+	}
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& faces, size_t vertexCount, uint32_t cacheSize) {
+	FifoCache cache{ vertexCount, cacheSize };
+	std::vector<bool> used(vertexCount, false);
+	size_t misses{ 0 };
+	size_t usedVertices{ 0 };
+	for (uint32_t index : faces) {
+		misses += cache.access(index);
+		if (!used[index]) {
+			used[index] = true;
+			++usedVertices;
+		}
+	}
+	size_t triangleCount{ faces.size() / 3 };
+	return VertexCacheStats{
+		triangleCount == 0 ? 0 : static_cast<float>(misses) / triangleCount,
+		usedVertices == 0 ? 0 : static_cast<float>(misses) / usedVertices,
+	};
+}
+
+std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& faces, size_t vertexCount,
+	uint32_t cacheSize) {
+	Adjacency adjacency{ faces, vertexCount };
+	// The triangles around each vertex that haven't been emitted yet.
+	std::vector<uint32_t> live(vertexCount);
+	for (uint32_t v{ 0 }; v < vertexCount; ++v) {
+		live[v] = adjacency.count(v);
+	}
+	std::vector<bool> emitted(faces.size() / 3, false);
+	FifoCache cache{ vertexCount, cacheSize };
+
+	// Vertices of recently emitted triangles, the first place to look for a new fan once the current one is
+	// done and none of its neighbours are worth fanning around.
+	std::vector<uint32_t> deadEnds{};
+	uint32_t cursor{ 0 };
+	auto skipDeadEnd{ [&]() -> int64_t {
+		while (!deadEnds.empty()) {
+			uint32_t vertex{ deadEnds.back() };
+			deadEnds.pop_back();
+			if (live[vertex] > 0) {
+				return vertex;
+			}
+		}
+		for (; cursor < vertexCount; ++cursor) {
+			if (live[cursor] > 0) {
+				return cursor;
+			}
+		}
+		return -1;
+	} };
+
+	std::vector<uint32_t> result{};
+	result.reserve(faces.size());
+	std::vector<uint32_t> candidates{};
+	int64_t fan{ skipDeadEnd() };
+	while (fan >= 0) {
+		candidates.clear();
+		for (uint32_t i{ adjacency.offsets[fan] }; i < adjacency.offsets[fan + 1]; ++i) {
+			uint32_t triangle{ adjacency.triangles[i] };
+			if (emitted[triangle]) {
+				continue;
+			}
+			emitted[triangle] = true;
+			for (uint32_t k{ 0 }; k < 3; ++k) {
+				uint32_t vertex{ faces[triangle * 3 + k] };
+				result.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				--live[vertex];
+				cache.access(vertex);
+			}
+		}
+
+		// Fan around the oldest neighbour whose remaining triangles can still be emitted before it leaves the
+		// cache; each of them can load at most two new vertices.
+		int64_t next{ -1 };
+		int64_t bestPriority{ -1 };
+		for (uint32_t vertex : candidates) {
+			if (live[vertex] == 0) {
+				continue;
+			}
+			int64_t priority{ 0 };
+			if (cache.age(vertex) + 2 * live[vertex] <= cacheSize) {
+				priority = cache.age(vertex);
+			}
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+		fan = next >= 0 ? next : skipDeadEnd();
+	}
+	return result;
+}
+
+void optimizeOverdraw(const std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces, uint32_t cacheSize,
+	float threshold) {
+	uint32_t triangleCount{ static_cast<uint32_t>(faces.size() / 3) };
+	if (triangleCount == 0) {
+		return;
+	}
+	FifoCache cache{ vertices.size(), cacheSize };
+	auto misses{ [&](uint32_t triangle) {
+		return cache.access(faces[triangle * 3]) + cache.access(faces[triangle * 3 + 1])
+			+ cache.access(faces[triangle * 3 + 2]);
+	} };
+
+	// Hard boundaries: triangles where every vertex misses, which is where the cache optimizer jumped to a
+	// new part of the mesh. Reordering whole clusters between them leaves the ACMR as it is.
+	std::vector<uint32_t> hard{};
+	for (uint32_t t{ 0 }; t < triangleCount; ++t) {
+		if (misses(t) == 3 || t == 0) {
+			hard.push_back(t);
+		}
+	}
+	hard.push_back(triangleCount);
+
+	// Soft boundaries: split a hard cluster as soon as the part of it so far has an ACMR within threshold of
+	// the whole cluster's, drawn with a cold cache. Smaller clusters sort better.
+	std::vector<uint32_t> clusters{};
+	for (size_t c{ 0 }; c + 1 < hard.size(); ++c) {
+		uint32_t begin{ hard[c] };
+		uint32_t end{ hard[c + 1] };
+		cache.clear();
+		uint32_t clusterMisses{ 0 };
+		for (uint32_t t{ begin }; t < end; ++t) {
+			clusterMisses += misses(t);
+		}
+		float limit{ threshold * clusterMisses / (end - begin) };
+
+		cache.clear();
+		clusters.push_back(begin);
+		uint32_t start{ begin };
+		uint32_t running{ 0 };
+		for (uint32_t t{ begin }; t < end; ++t) {
+			running += misses(t);
+			if (t + 1 < end && running <= limit * (t + 1 - start)) {
+				clusters.push_back(t + 1);
+				start = t + 1;
+				running = 0;
+				cache.clear();
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	// Each cluster's area-weighted centre and normal.
+	size_t clusterCount{ clusters.size() - 1 };
+	std::vector<glm::vec3> centres(clusterCount);
+	std::vector<glm::vec3> normals(clusterCount);
+	glm::vec3 meshCentre{ 0 };
+	float meshArea{ 0 };
+	for (size_t c{ 0 }; c < clusterCount; ++c) {
+		glm::vec3 centre{ 0 };
+		glm::vec3 normal{ 0 };
+		float area{ 0 };
+		for (uint32_t t{ clusters[c] }; t < clusters[c + 1]; ++t) {
+			glm::vec3 p0{ position(vertices[faces[t * 3]]) };
+			glm::vec3 p1{ position(vertices[faces[t * 3 + 1]]) };
+			glm::vec3 p2{ position(vertices[faces[t * 3 + 2]]) };
+			glm::vec3 cross{ glm::cross(p1 - p0, p2 - p0) };
+			float triangleArea{ glm::length(cross) };
+			centre += (p0 + p1 + p2) * (triangleArea / 3);
+			normal += cross;
+			area += triangleArea;
+		}
+		meshCentre += centre;
+		meshArea += area;
+		centres[c] = area > 0 ? centre / area : centre;
+		normals[c] = glm::length(normal) > 0 ? glm::normalize(normal) : normal;
+	}
+	if (meshArea > 0) {
+		meshCentre /= meshArea;
+	}
+
+	std::vector<float> outwardness(clusterCount);
+	for (size_t c{ 0 }; c < clusterCount; ++c) {
+		outwardness[c] = glm::dot(centres[c] - meshCentre, normals[c]);
+	}
+	std::vector<uint32_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return outwardness[a] > outwardness[b]; });
+
+	std::vector<uint32_t> sorted{};
+	sorted.reserve(faces.size());
+	for (uint32_t c : order) {
+		sorted.insert(sorted.end(), faces.begin() + clusters[c] * 3, faces.begin() + clusters[c + 1] * 3);
+	}
+	faces = std::move(sorted);
+}
+
+void optimizeVertexFetch(std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces) {
+	constexpr uint32_t unused{ std::numeric_limits<uint32_t>::max() };
+	std::vector<uint32_t> remap(vertices.size(), unused);
+	std::vector<Vertex3D> ordered{};
+	ordered.reserve(vertices.size());
+	for (uint32_t& index : faces) {
+		if (remap[index] == unused) {
+			remap[index] = static_cast<uint32_t>(ordered.size());
+			ordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices = std::move(ordered);
+}
+
+MeshOptimization optimizeMesh(std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces, uint32_t cacheSize) {
+	MeshOptimization result{};
+	result.before = analyzeVertexCache(faces, vertices.size(), cacheSize);
+	faces = optimizeVertexCache(faces, vertices.size(), cacheSize);
+	optimizeOverdraw(vertices, faces, cacheSize);
+	optimizeVertexFetch(vertices, faces);
+	result.after = analyzeVertexCache(faces, vertices.size(), cacheSize);
+	return result;
+}
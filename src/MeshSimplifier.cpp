@@ -0,0 +1,335 @@
+#include "MeshSimplifier.h"
+#include <glm/ext.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+	// A symmetric 4x4 matrix measuring the summed squared distance to a set of planes.
+	struct Quadric {
+		double a2{ 0 }, ab{ 0 }, ac{ 0 }, ad{ 0 };
+		double b2{ 0 }, bc{ 0 }, bd{ 0 };
+		double c2{ 0 }, cd{ 0 };
+		double d2{ 0 };
+
+		static Quadric fromPlane(const glm::dvec3& n, double d, double weight) {
+			return Quadric{ n.x * n.x * weight, n.x * n.y * weight, n.x * n.z * weight, n.x * d * weight,
+				n.y * n.y * weight, n.y * n.z * weight, n.y * d * weight,
+				n.z * n.z * weight, n.z * d * weight,
+				d * d * weight };
+		}
+
+		void add(const Quadric& q) {
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd;
+			d2 += q.d2;
+		}
+
+		double error(const glm::dvec3& p) const {
+			return a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x
+				+ b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+				+ c2 * p.z * p.z + 2 * cd * p.z
+				+ d2;
+		}
+	};
+
+	struct Collapse {
+		double cost;
+		uint32_t from;
+		uint32_t to;
+
+		bool operator>(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	// A level is only kept if it has at most this fraction of the triangles of the level before it.
+	constexpr double minShrink{ 0.85 };
+	// How much more a border's own plane weighs against moving it than the surface's planes do.
+	constexpr double borderWeight{ 10 };
+
+	glm::dvec3 position(const Vertex3D& v) {
+		return glm::dvec3{ v.x, v.y, v.z };
+	}
+}
+
+std::vector<std::vector<uint32_t>> simplifyMesh(const std::vector<Vertex3D>& vertices,
+	const std::vector<uint32_t>& faces, const std::vector<float>& ratios) {
+	std::vector<uint32_t> indices{ faces };
+	size_t triangleCount{ indices.size() / 3 };
+
+	// Weld vertices by position: split copies of a seam vertex share one id, which is what collapses, costs
+	// and the edge topology work on. weld[v] is the first vertex at v's position; copies[w] lists them all.
+	std::vector<uint32_t> weld(vertices.size());
+	std::vector<std::vector<uint32_t>> copies(vertices.size());
+	{
+		std::vector<uint32_t> order(vertices.size());
+		for (uint32_t v{ 0 }; v < vertices.size(); ++v) {
+			order[v] = v;
+		}
+		auto place{ [&](uint32_t v) { return std::make_tuple(vertices[v].x, vertices[v].y, vertices[v].z); } };
+		std::sort(order.begin(), order.end(),
+			[&](uint32_t a, uint32_t b) { return std::make_pair(place(a), a) < std::make_pair(place(b), b); });
+		for (size_t i{ 0 }; i < order.size(); ++i) {
+			bool same{ i > 0 && place(order[i - 1]) == place(order[i]) };
+			weld[order[i]] = same ? weld[order[i - 1]] : order[i];
+			copies[weld[order[i]]].push_back(order[i]);
+		}
+	}
+
+	// Triangles around each vertex, and each welded vertex's quadric from the planes of those triangles.
+	std::vector<std::vector<uint32_t>> vertexTriangles(vertices.size());
+	std::vector<Quadric> quadrics(vertices.size());
+	for (uint32_t t{ 0 }; t < triangleCount; ++t) {
+		glm::dvec3 p0{ position(vertices[indices[t * 3]]) };
+		glm::dvec3 p1{ position(vertices[indices[t * 3 + 1]]) };
+		glm::dvec3 p2{ position(vertices[indices[t * 3 + 2]]) };
+		glm::dvec3 cross{ glm::cross(p1 - p0, p2 - p0) };
+		double length{ glm::length(cross) };
+		if (length > 0) {
+			glm::dvec3 n{ cross / length };
+			// Weighted by area, so big triangles resist change more than slivers.
+			Quadric q{ Quadric::fromPlane(n, -glm::dot(n, p0), length * 0.5) };
+			for (uint32_t k{ 0 }; k < 3; ++k) {
+				quadrics[weld[indices[t * 3 + k]]].add(q);
+			}
+		}
+		for (uint32_t k{ 0 }; k < 3; ++k) {
+			vertexTriangles[indices[t * 3 + k]].push_back(t);
+		}
+	}
+
+	// Classify the welded vertices by the edges around them, counted once seams are welded. A vertex with two
+	// open edges (used by one triangle) is on a border and may only slide along it; one where more open
+	// edges meet, or on an edge used by more than two triangles, is locked. Open edges also add a plane
+	// through the edge, perpendicular to its triangle, to their vertices' quadrics so borders keep their shape.
+	std::vector<uint8_t> locked(vertices.size(), 0);
+	std::vector<uint8_t> border(vertices.size(), 0);
+	{
+		struct EdgeUse {
+			uint32_t uses{ 0 };
+			uint32_t triangle{ 0 };
+			uint32_t corner{ 0 };
+		};
+		std::unordered_map<uint64_t, EdgeUse> edgeUses{};
+		auto edgeKey{ [](uint32_t a, uint32_t b) {
+			return static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+		} };
+		for (uint32_t t{ 0 }; t < triangleCount; ++t) {
+			for (uint32_t k{ 0 }; k < 3; ++k) {
+				EdgeUse& use{ edgeUses[edgeKey(weld[indices[t * 3 + k]], weld[indices[t * 3 + (k + 1) % 3]])] };
+				use = EdgeUse{ use.uses + 1, t, k };
+			}
+		}
+		std::vector<uint8_t> openEdges(vertices.size(), 0);
+		for (auto& [key, use] : edgeUses) {
+			uint32_t a{ static_cast<uint32_t>(key >> 32) };
+			uint32_t b{ static_cast<uint32_t>(key & 0xFFFFFFFF) };
+			if (use.uses > 2) {
+				locked[a] = 1;
+				locked[b] = 1;
+			}
+			else if (use.uses == 1) {
+				openEdges[a] = static_cast<uint8_t>(std::min(openEdges[a] + 1, 3));
+				openEdges[b] = static_cast<uint8_t>(std::min(openEdges[b] + 1, 3));
+				const uint32_t* tri{ &indices[use.triangle * 3] };
+				glm::dvec3 p0{ position(vertices[tri[use.corner]]) };
+				glm::dvec3 p1{ position(vertices[tri[(use.corner + 1) % 3]]) };
+				glm::dvec3 p2{ position(vertices[tri[(use.corner + 2) % 3]]) };
+				glm::dvec3 normal{ glm::cross(p1 - p0, p2 - p0) };
+				glm::dvec3 side{ glm::cross(p1 - p0, normal) };
+				double length{ glm::length(side) };
+				if (length > 0) {
+					glm::dvec3 n{ side / length };
+					double edgeLength{ glm::length(p1 - p0) };
+					Quadric q{ Quadric::fromPlane(n, -glm::dot(n, p0), edgeLength * edgeLength * borderWeight) };
+					quadrics[a].add(q);
+					quadrics[b].add(q);
+				}
+			}
+		}
+		for (uint32_t v{ 0 }; v < vertices.size(); ++v) {
+			locked[v] = locked[v] || (openEdges[v] != 0 && openEdges[v] != 2);
+			border[v] = openEdges[v] == 2;
+		}
+	}
+
+	std::vector<uint8_t> deadTriangle(triangleCount, 0);
+	std::vector<uint8_t> deadVertex(vertices.size(), 0);
+	auto collapseCost{ [&](uint32_t from, uint32_t to) {
+		Quadric q{ quadrics[from] };
+		q.add(quadrics[to]);
+		return q.error(position(vertices[to]));
+	} };
+
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap{};
+	std::vector<uint32_t> neighbours{};
+	auto pushCollapses{ [&](uint32_t w) {
+		neighbours.clear();
+		for (uint32_t v : copies[w]) {
+			for (uint32_t t : vertexTriangles[v]) {
+				if (deadTriangle[t]) {
+					continue;
+				}
+				for (uint32_t k{ 0 }; k < 3; ++k) {
+					if (weld[indices[t * 3 + k]] != w) {
+						neighbours.push_back(weld[indices[t * 3 + k]]);
+					}
+				}
+			}
+		}
+		// Each edge is shared by two triangles; only queue it once.
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+		for (uint32_t other : neighbours) {
+			if (!locked[w]) {
+				heap.push(Collapse{ collapseCost(w, other), w, other });
+			}
+			if (!locked[other]) {
+				heap.push(Collapse{ collapseCost(other, w), other, w });
+			}
+		}
+	} };
+	for (uint32_t v{ 0 }; v < vertices.size(); ++v) {
+		if (weld[v] == v) {
+			pushCollapses(v);
+		}
+	}
+
+	// Every copy of the welded vertex that moves is replaced by the one copy of the target it shares a
+	// triangle with, so texture coordinates and normals stay those of its own side of a seam. A seam vertex
+	// can therefore only slide along its seam; if any copy has no such neighbour, or more than one, the
+	// collapse would cross a seam and isn't made. Fills pairs with (copy, replacement).
+	std::vector<std::pair<uint32_t, uint32_t>> pairs{};
+	uint32_t sharedTriangles{ 0 };
+	auto pairCopies{ [&](uint32_t from, uint32_t to) {
+		pairs.clear();
+		sharedTriangles = 0;
+		for (uint32_t v : copies[from]) {
+			uint32_t target{ UINT32_MAX };
+			bool live{ false };
+			for (uint32_t t : vertexTriangles[v]) {
+				if (deadTriangle[t]) {
+					continue;
+				}
+				live = true;
+				for (uint32_t k{ 0 }; k < 3; ++k) {
+					uint32_t other{ indices[t * 3 + k] };
+					if (weld[other] == to) {
+						if (target != UINT32_MAX && target != other) {
+							return false;
+						}
+						target = other;
+						++sharedTriangles;
+					}
+				}
+			}
+			if (live && target == UINT32_MAX) {
+				return false;
+			}
+			if (live) {
+				pairs.emplace_back(v, target);
+			}
+		}
+		return !pairs.empty();
+	} };
+
+	// Moving a vertex must not flip or collapse any triangle that doesn't contain the edge.
+	auto collapseIsValid{ [&](uint32_t to) {
+		glm::dvec3 target{ position(vertices[to]) };
+		for (auto [from, replacement] : pairs) {
+			for (uint32_t t : vertexTriangles[from]) {
+				if (deadTriangle[t]) {
+					continue;
+				}
+				uint32_t* tri{ &indices[t * 3] };
+				if (tri[0] == replacement || tri[1] == replacement || tri[2] == replacement) {
+					continue;
+				}
+				glm::dvec3 p[3]{ position(vertices[tri[0]]), position(vertices[tri[1]]), position(vertices[tri[2]]) };
+				glm::dvec3 before{ glm::cross(p[1] - p[0], p[2] - p[0]) };
+				for (uint32_t k{ 0 }; k < 3; ++k) {
+					if (tri[k] == from) {
+						p[k] = target;
+					}
+				}
+				glm::dvec3 after{ glm::cross(p[1] - p[0], p[2] - p[0]) };
+				if (glm::dot(before, after) <= 0.2 * glm::length(before) * glm::length(after)) {
+					return false;
+				}
+			}
+		}
+		return true;
+	} };
+
+	std::vector<std::vector<uint32_t>> lods{};
+	size_t liveTriangles{ triangleCount };
+	size_t previousTriangles{ triangleCount };
+	for (float ratio : ratios) {
+		size_t target{ static_cast<size_t>(triangleCount * ratio) };
+		while (liveTriangles > target && !heap.empty()) {
+			Collapse c{ heap.top() };
+			heap.pop();
+			if (deadVertex[c.from] || deadVertex[c.to]) {
+				continue;
+			}
+			// Costs go stale as quadrics merge; requeue instead of trusting an old one.
+			double cost{ collapseCost(c.from, c.to) };
+			if (cost > c.cost * 1.0001 + 1e-12) {
+				heap.push(Collapse{ cost, c.from, c.to });
+				continue;
+			}
+			// The pair may no longer share a triangle, in which case no copy finds a replacement. A border
+			// vertex only moves along its border, to a neighbour across an edge with one triangle.
+			if (!pairCopies(c.from, c.to) || (border[c.from] && sharedTriangles != 1) || !collapseIsValid(c.to)) {
+				continue;
+			}
+
+			for (auto [from, replacement] : pairs) {
+				for (uint32_t t : vertexTriangles[from]) {
+					if (deadTriangle[t]) {
+						continue;
+					}
+					uint32_t* tri{ &indices[t * 3] };
+					if (tri[0] == replacement || tri[1] == replacement || tri[2] == replacement) {
+						deadTriangle[t] = 1;
+						--liveTriangles;
+						continue;
+					}
+					for (uint32_t k{ 0 }; k < 3; ++k) {
+						if (tri[k] == from) {
+							tri[k] = replacement;
+						}
+					}
+					vertexTriangles[replacement].push_back(t);
+				}
+				vertexTriangles[from].clear();
+			}
+			deadVertex[c.from] = 1;
+			quadrics[c.to].add(quadrics[c.from]);
+			// Drop dead triangles from the target's lists now and then, so they don't keep growing.
+			for (uint32_t v : copies[c.to]) {
+				auto& around{ vertexTriangles[v] };
+				around.erase(std::remove_if(around.begin(), around.end(),
+					[&](uint32_t t) { return deadTriangle[t] != 0; }), around.end());
+			}
+			pushCollapses(c.to);
+		}
+
+		// A level that barely shrank the one before it would cost index memory without saving much drawing.
+		if (liveTriangles > previousTriangles * minShrink) {
+			continue;
+		}
+		previousTriangles = liveTriangles;
+		std::vector<uint32_t> lod{};
+		lod.reserve(liveTriangles * 3);
+		for (size_t t{ 0 }; t < triangleCount; ++t) {
+			if (!deadTriangle[t]) {
+				lod.insert(lod.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+			}
+		}
+		lods.push_back(std::move(lod));
+	}
+	return lods;
+}
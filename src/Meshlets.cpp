@@ -0,0 +1,219 @@
+#include "Meshlets.h"
+#include "Bounds.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHLETS_SSE2
+#include <immintrin.h>
+#endif
+
+namespace {
+	// The cone cutoff of a meshlet that can't be culled by facing.
+	constexpr float noCone{ 2.0f };
+
+	glm::vec3 position(const Vertex3D& v) {
+		return glm::vec3{ v.x, v.y, v.z };
+	}
+
+	// Fill in the bounds and normal cone of the meshlet drawing triangles [begin, end).
+	void addMeshlet(MeshletSet& set, const std::vector<Vertex3D>& vertices, const std::vector<uint32_t>& faces,
+		uint32_t begin, uint32_t end, bool twoSided) {
+		BoundingBox box{};
+		for (uint32_t i{ begin * 3 }; i < end * 3; ++i) {
+			box.expand(position(vertices[faces[i]]));
+		}
+		glm::vec3 center{ box.center() };
+		float radius{ 0 };
+		for (uint32_t i{ begin * 3 }; i < end * 3; ++i) {
+			radius = glm::max(radius, glm::distance(center, position(vertices[faces[i]])));
+		}
+
+		// The cone's axis is the average of the triangles' normals, and its half angle reaches the normal
+		// furthest from it. Past 90 degrees some triangle faces the camera from anywhere.
+		std::vector<glm::vec3> normals{};
+		glm::vec3 axis{ 0 };
+		for (uint32_t t{ begin }; t < end; ++t) {
+			glm::vec3 p0{ position(vertices[faces[t * 3]]) };
+			glm::vec3 cross{ glm::cross(position(vertices[faces[t * 3 + 1]]) - p0, position(vertices[faces[t * 3 + 2]]) - p0) };
+			float length{ glm::length(cross) };
+			if (length > 0) {
+				normals.push_back(cross / length);
+				axis += normals.back();
+			}
+		}
+		float cutoff{ noCone };
+		if (!twoSided && glm::length(axis) > 0) {
+			axis = glm::normalize(axis);
+			float minDot{ 1 };
+			for (auto& n : normals) {
+				minDot = glm::min(minDot, glm::dot(axis, n));
+			}
+			if (minDot > 0) {
+				cutoff = std::sqrt(1 - minDot * minDot);
+			}
+		}
+
+		set.meshlets.push_back(Meshlet{ begin * 3, (end - begin) * 3 });
+		set.centerX.push_back(center.x);
+		set.centerY.push_back(center.y);
+		set.centerZ.push_back(center.z);
+		set.radius.push_back(radius);
+		set.axisX.push_back(axis.x);
+		set.axisY.push_back(axis.y);
+		set.axisZ.push_back(axis.z);
+		set.coneCutoff.push_back(cutoff);
+	}
+
+	enum class Cull : uint8_t { visible, cone, frustum };
+
+	// Whether a sphere is outside the frustum, or all of a cone of normals around it faces away from the
+	// camera: for every point p in the sphere and normal n in the cone, dot(n, p - camera) >= 0.
+	Cull testMeshlet(const MeshletSet& set, size_t i, const glm::vec4 (&planes)[6], const glm::vec3& camera) {
+		glm::vec3 center{ set.centerX[i], set.centerY[i], set.centerZ[i] };
+		float radius{ set.radius[i] };
+		for (auto& plane : planes) {
+			if (glm::dot(glm::vec3{ plane }, center) + plane.w < -radius) {
+				return Cull::frustum;
+			}
+		}
+		float cutoff{ set.coneCutoff[i] };
+		glm::vec3 view{ center - camera };
+		glm::vec3 axis{ set.axisX[i], set.axisY[i], set.axisZ[i] };
+		if (cutoff <= 1 && glm::dot(view, axis) >= cutoff * glm::length(view) + radius * (1 + cutoff)) {
+			return Cull::cone;
+		}
+		return Cull::visible;
+	}
+
+	void count(Cull result, const Meshlet& meshlet, MeshletCullCounts& counts, std::vector<Meshlet>& out) {
+		if (result == Cull::frustum) {
+			++counts.frustumCulled;
+		}
+		else if (result == Cull::cone) {
+			++counts.coneCulled;
+		}
+		else {
+			++counts.visible;
+			if (!out.empty() && out.back().firstIndex + out.back().indexCount == meshlet.firstIndex) {
+				out.back().indexCount += meshlet.indexCount;
+			}
+			else {
+				out.push_back(meshlet);
+			}
+		}
+	}
+}
+
+size_t MeshletSet::size() const {
+	return meshlets.size();
+}
+
+MeshletSet buildMeshlets(const std::vector<Vertex3D>& vertices, const std::vector<uint32_t>& faces, bool twoSided,
+	uint32_t maxVertices, uint32_t maxTriangles) {
+	MeshletSet set{};
+	uint32_t triangleCount{ static_cast<uint32_t>(faces.size() / 3) };
+	// The meshlet each vertex was last added to, to count a meshlet's distinct vertices as it grows.
+	constexpr uint32_t none{ std::numeric_limits<uint32_t>::max() };
+	std::vector<uint32_t> lastMeshlet(vertices.size(), none);
+	uint32_t current{ 0 };
+	uint32_t begin{ 0 };
+	uint32_t vertexCount{ 0 };
+	auto newVertices{ [&](uint32_t t) {
+		uint32_t a{ faces[t * 3] }, b{ faces[t * 3 + 1] }, c{ faces[t * 3 + 2] };
+		return (lastMeshlet[a] != current) + (lastMeshlet[b] != current && b != a)
+			+ (lastMeshlet[c] != current && c != a && c != b);
+	} };
+	// A triangle that shares no vertex with the meshlet is where the order jumps to another part of the mesh
+	// (as it does between the overdraw optimizer's clusters). Once the meshlet is a quarter full it ends there
+	// rather than taking in a far-away patch, which would widen both its bounds and its cone.
+	for (uint32_t t{ 0 }; t < triangleCount; ++t) {
+		uint32_t added{ static_cast<uint32_t>(newVertices(t)) };
+		if (t > begin && (vertexCount + added > maxVertices || t - begin >= maxTriangles
+			|| (added == 3 && t - begin >= maxTriangles / 4))) {
+			addMeshlet(set, vertices, faces, begin, t, twoSided);
+			++current;
+			begin = t;
+			vertexCount = 0;
+			added = static_cast<uint32_t>(newVertices(t));
+		}
+		for (uint32_t k{ 0 }; k < 3; ++k) {
+			lastMeshlet[faces[t * 3 + k]] = current;
+		}
+		vertexCount += added;
+	}
+	if (triangleCount > begin) {
+		addMeshlet(set, vertices, faces, begin, triangleCount, twoSided);
+	}
+
+	size_t padded{ (set.size() + 3) / 4 * 4 };
+	for (auto* v : { &set.centerX, &set.centerY, &set.centerZ, &set.radius, &set.axisX, &set.axisY, &set.axisZ }) {
+		v->resize(padded, 0.0f);
+	}
+	set.coneCutoff.resize(padded, noCone);
+	return set;
+}
+
+MeshletCullCounts cullMeshlets(const MeshletSet& set, const glm::vec4 (&planes)[6], const glm::vec3& camera,
+	std::vector<Meshlet>& out) {
+#if defined(MESHLETS_SSE2)
+	out.clear();
+	MeshletCullCounts counts{};
+	const __m128 zero{ _mm_setzero_ps() };
+	const __m128 one{ _mm_set1_ps(1.0f) };
+	const __m128 cameraX{ _mm_set1_ps(camera.x) }, cameraY{ _mm_set1_ps(camera.y) }, cameraZ{ _mm_set1_ps(camera.z) };
+	for (size_t i{ 0 }; i < set.size(); i += 4) {
+		__m128 x{ _mm_loadu_ps(&set.centerX[i]) };
+		__m128 y{ _mm_loadu_ps(&set.centerY[i]) };
+		__m128 z{ _mm_loadu_ps(&set.centerZ[i]) };
+		__m128 radius{ _mm_loadu_ps(&set.radius[i]) };
+		__m128 negativeRadius{ _mm_sub_ps(zero, radius) };
+
+		__m128 outside{ zero };
+		for (auto& plane : planes) {
+			__m128 distance{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), z), _mm_set1_ps(plane.w))) };
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+		}
+
+		__m128 viewX{ _mm_sub_ps(x, cameraX) }, viewY{ _mm_sub_ps(y, cameraY) }, viewZ{ _mm_sub_ps(z, cameraZ) };
+		__m128 length{ _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(viewX, viewX), _mm_mul_ps(viewY, viewY)),
+			_mm_mul_ps(viewZ, viewZ))) };
+		__m128 facing{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(viewX, _mm_loadu_ps(&set.axisX[i])),
+			_mm_mul_ps(viewY, _mm_loadu_ps(&set.axisY[i]))), _mm_mul_ps(viewZ, _mm_loadu_ps(&set.axisZ[i]))) };
+		__m128 cutoff{ _mm_loadu_ps(&set.coneCutoff[i]) };
+		__m128 limit{ _mm_add_ps(_mm_mul_ps(cutoff, length), _mm_mul_ps(radius, _mm_add_ps(one, cutoff))) };
+		__m128 backFacing{ _mm_and_ps(_mm_cmpge_ps(facing, limit), _mm_cmple_ps(cutoff, one)) };
+
+		int frustumBits{ _mm_movemask_ps(outside) };
+		int coneBits{ _mm_movemask_ps(_mm_andnot_ps(outside, backFacing)) };
+		size_t lanes{ std::min<size_t>(4, set.size() - i) };
+		for (size_t lane{ 0 }; lane < lanes; ++lane) {
+			Cull result{ (frustumBits >> lane & 1) ? Cull::frustum : (coneBits >> lane & 1) ? Cull::cone : Cull::visible };
+			count(result, set.meshlets[i + lane], counts, out);
+		}
+	}
+	return counts;
+#else
+	return cullMeshletsScalar(set, planes, camera, out);
+#endif
+}
+
+MeshletCullCounts cullMeshletsScalar(const MeshletSet& set, const glm::vec4 (&planes)[6], const glm::vec3& camera,
+	std::vector<Meshlet>& out) {
+	out.clear();
+	MeshletCullCounts counts{};
+	for (size_t i{ 0 }; i < set.size(); ++i) {
+		count(testMeshlet(set, i, planes, camera), set.meshlets[i], counts, out);
+	}
+	return counts;
+}
+
+const char* meshletKernelName() {
+#if defined(MESHLETS_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,310 @@
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+	// Records the time from construction to destruction.
+	class ScopedTimer {
+	public:
+		explicit ScopedTimer(int64_t& nanoseconds)
+			: m_nanoseconds{ nanoseconds }, m_start{ std::chrono::steady_clock::now() } {
+		}
+		~ScopedTimer() {
+			m_nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - m_start).count();
+		}
+
+	private:
+		int64_t& m_nanoseconds;
+		std::chrono::steady_clock::time_point m_start;
+	};
+}
+
+Occluder Occluder::box(const BoundingBox& localBounds, const glm::mat4& model) {
+	glm::vec3 c{ localBounds.center() };
+	glm::vec3 e{ localBounds.extents() };
+	Occluder occluder{};
+	for (uint32_t i{ 0 }; i < 8; ++i) {
+		glm::vec3 corner{ c + e * glm::vec3{ i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f } };
+		occluder.positions.push_back(glm::vec3{ model * glm::vec4{ corner, 1 } });
+		occluder.bounds.expand(occluder.positions.back());
+	}
+	// Two triangles per face; winding doesn't matter, both sides are rasterized.
+	occluder.indices = {
+		0, 1, 3, 0, 3, 2,  4, 5, 7, 4, 7, 6,
+		0, 1, 5, 0, 5, 4,  2, 3, 7, 2, 7, 6,
+		0, 2, 6, 0, 6, 4,  1, 3, 7, 1, 7, 5,
+	};
+	return occluder;
+}
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+	: m_width{ (std::max(width, 4u) + 3) & ~3u }, m_height{ std::max(height, 1u) } {
+	uint32_t w{ m_width };
+	uint32_t h{ m_height };
+	while (true) {
+		m_levelSizes.push_back(LevelSize{ w, h });
+		m_minDepth.emplace_back(static_cast<size_t>(w) * h, 1.0f);
+		m_maxDepth.emplace_back(static_cast<size_t>(w) * h, 1.0f);
+		if (w == 1 && h == 1) {
+			break;
+		}
+		w = std::max((w + 1) / 2, 1u);
+		h = std::max((h + 1) / 2, 1u);
+	}
+}
+
+void OcclusionCuller::addOccluder(Occluder occluder) {
+	if (occluder.bounds.isEmpty()) {
+		for (auto& p : occluder.positions) {
+			occluder.bounds.expand(p);
+		}
+	}
+	m_occluders.push_back(std::move(occluder));
+}
+
+void OcclusionCuller::clearOccluders() {
+	m_occluders.clear();
+}
+
+size_t OcclusionCuller::occluderCount() const {
+	return m_occluders.size();
+}
+
+JobSystem::JobHandle OcclusionCuller::rasterize(JobSystem& jobs, const glm::mat4& viewProjection, const glm::vec3& eye,
+	float nearMargin) {
+	m_viewProjection = viewProjection;
+	m_eye = eye;
+	m_nearMargin = nearMargin;
+	uint32_t bandCount{ (m_height + m_bandHeight - 1) / m_bandHeight };
+	m_jobNanoseconds.assign(bandCount + 2, 0);
+
+	JobSystem::JobHandle project{ jobs.submit([this]() {
+		ScopedTimer timer{ m_jobNanoseconds[0] };
+		projectVertices();
+	}) };
+	std::vector<JobSystem::JobHandle> bands{};
+	for (uint32_t band{ 0 }; band < bandCount; ++band) {
+		bands.push_back(jobs.submit([this, band]() {
+			ScopedTimer timer{ m_jobNanoseconds[band + 1] };
+			rasterizeBand(band * m_bandHeight, std::min((band + 1) * m_bandHeight, m_height));
+		}, { project }));
+	}
+	return jobs.submit([this]() {
+		{
+			ScopedTimer timer{ m_jobNanoseconds.back() };
+			buildPyramids();
+		}
+		int64_t total{ 0 };
+		for (int64_t ns : m_jobNanoseconds) {
+			total += ns;
+		}
+		m_lastRasterMilliseconds = static_cast<float>(total) / 1e6f;
+	}, bands);
+}
+
+void OcclusionCuller::projectVertices() {
+	m_screenVertices.clear();
+	m_vertexOffsets.clear();
+	for (auto& occluder : m_occluders) {
+		m_vertexOffsets.push_back(static_cast<uint32_t>(m_screenVertices.size()));
+		if (occluder.bounds.contains(m_eye, m_nearMargin)) {
+			// Every triangle with an invalid vertex is skipped.
+			m_screenVertices.insert(m_screenVertices.end(), occluder.positions.size(), ScreenVertex{ 0, 0, 0, false });
+			continue;
+		}
+		for (auto& p : occluder.positions) {
+			glm::vec4 clip{ m_viewProjection * glm::vec4{ p, 1 } };
+			if (clip.w <= 1e-5f) {
+				m_screenVertices.push_back(ScreenVertex{ 0, 0, 0, false });
+				continue;
+			}
+			glm::vec3 ndc{ glm::vec3{ clip } / clip.w };
+			m_screenVertices.push_back(ScreenVertex{
+				(ndc.x * 0.5f + 0.5f) * m_width,
+				(ndc.y * 0.5f + 0.5f) * m_height,
+				ndc.z * 0.5f + 0.5f,
+				ndc.z >= -1.0f
+			});
+		}
+	}
+}
+
+void OcclusionCuller::rasterizeBand(uint32_t firstRow, uint32_t endRow) {
+	float* depth{ m_minDepth[0].data() };
+	std::fill(depth + static_cast<size_t>(firstRow) * m_width, depth + static_cast<size_t>(endRow) * m_width, 1.0f);
+
+	for (size_t o{ 0 }; o < m_occluders.size(); ++o) {
+		const ScreenVertex* vertices{ m_screenVertices.data() + m_vertexOffsets[o] };
+		const std::vector<uint32_t>& indices{ m_occluders[o].indices };
+		for (size_t t{ 0 }; t + 2 < indices.size(); t += 3) {
+			ScreenVertex a{ vertices[indices[t]] };
+			ScreenVertex b{ vertices[indices[t + 1]] };
+			ScreenVertex c{ vertices[indices[t + 2]] };
+			if (!a.valid || !b.valid || !c.valid) {
+				continue;
+			}
+			float area{ (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) };
+			if (std::abs(area) < 1e-8f) {
+				continue;
+			}
+			if (area < 0) {
+				std::swap(b, c);
+				area = -area;
+			}
+
+			// The pixels whose centers may be covered, limited to this band.
+			int32_t minX{ std::max(static_cast<int32_t>(std::floor(std::min({ a.x, b.x, c.x }) - 0.5f)), 0) };
+			int32_t maxX{ std::min(static_cast<int32_t>(std::ceil(std::max({ a.x, b.x, c.x }) - 0.5f)), static_cast<int32_t>(m_width) - 1) };
+			int32_t minY{ std::max(static_cast<int32_t>(std::floor(std::min({ a.y, b.y, c.y }) - 0.5f)), static_cast<int32_t>(firstRow)) };
+			int32_t maxY{ std::min(static_cast<int32_t>(std::ceil(std::max({ a.y, b.y, c.y }) - 0.5f)), static_cast<int32_t>(endRow) - 1) };
+			if (minX > maxX || minY > maxY) {
+				continue;
+			}
+			// Rows are processed 4 pixels at a time, so start on a multiple of 4.
+			minX &= ~3;
+
+			// Edge functions e(x, y) = dx * x + dy * y + e0, positive inside, and the depth plane.
+			float e0dx{ b.y - c.y }, e0dy{ c.x - b.x }, e00{ b.x * c.y - b.y * c.x };
+			float e1dx{ c.y - a.y }, e1dy{ a.x - c.x }, e10{ c.x * a.y - c.y * a.x };
+			float e2dx{ a.y - b.y }, e2dy{ b.x - a.x }, e20{ a.x * b.y - a.y * b.x };
+			float zdx{ (e0dx * a.z + e1dx * b.z + e2dx * c.z) / area };
+			float zdy{ (e0dy * a.z + e1dy * b.z + e2dy * c.z) / area };
+			float z0{ (e00 * a.z + e10 * b.z + e20 * c.z) / area };
+
+			for (int32_t y{ minY }; y <= maxY; ++y) {
+				float py{ y + 0.5f };
+				float* row{ depth + static_cast<size_t>(y) * m_width };
+#if defined(OCCLUSION_SSE2)
+				const __m128 offsets{ _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f) };
+				const __m128 zero{ _mm_setzero_ps() };
+				for (int32_t x{ minX }; x <= maxX; x += 4) {
+					__m128 px{ _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets) };
+					__m128 w0{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e0dx), px), _mm_set1_ps(e0dy * py + e00)) };
+					__m128 w1{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e1dx), px), _mm_set1_ps(e1dy * py + e10)) };
+					__m128 w2{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e2dx), px), _mm_set1_ps(e2dy * py + e20)) };
+					__m128 inside{ _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)),
+						_mm_cmpge_ps(w2, zero)) };
+					if (_mm_movemask_ps(inside) == 0) {
+						continue;
+					}
+					__m128 z{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zdx), px), _mm_set1_ps(zdy * py + z0)) };
+					__m128 old{ _mm_loadu_ps(row + x) };
+					__m128 nearer{ _mm_min_ps(old, z) };
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+				}
+#else
+				for (int32_t x{ minX }; x <= maxX; ++x) {
+					float px{ x + 0.5f };
+					if (e0dx * px + e0dy * py + e00 >= 0 && e1dx * px + e1dy * py + e10 >= 0
+						&& e2dx * px + e2dy * py + e20 >= 0) {
+						row[x] = std::min(row[x], zdx * px + zdy * py + z0);
+					}
+				}
+#endif
+			}
+		}
+	}
+}
+
+void OcclusionCuller::buildPyramids() {
+	m_maxDepth[0] = m_minDepth[0];
+	for (size_t level{ 1 }; level < m_levelSizes.size(); ++level) {
+		LevelSize size{ m_levelSizes[level] };
+		LevelSize below{ m_levelSizes[level - 1] };
+		for (uint32_t y{ 0 }; y < size.height; ++y) {
+			for (uint32_t x{ 0 }; x < size.width; ++x) {
+				float lo{ 1.0f };
+				float hi{ 0.0f };
+				// Odd sizes leave the last texel of a row or column with only one source.
+				for (uint32_t sy{ y * 2 }; sy < std::min(y * 2 + 2, below.height); ++sy) {
+					for (uint32_t sx{ x * 2 }; sx < std::min(x * 2 + 2, below.width); ++sx) {
+						lo = std::min(lo, m_minDepth[level - 1][sy * below.width + sx]);
+						hi = std::max(hi, m_maxDepth[level - 1][sy * below.width + sx]);
+					}
+				}
+				m_minDepth[level][y * size.width + x] = lo;
+				m_maxDepth[level][y * size.width + x] = hi;
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::isOccluded(const BoundingBox& bounds) const {
+	if (m_occluders.empty() || bounds.isEmpty()) {
+		return false;
+	}
+
+	glm::vec2 lo{ FLT_MAX, FLT_MAX };
+	glm::vec2 hi{ -FLT_MAX, -FLT_MAX };
+	float nearest{ 1.0f };
+	for (uint32_t i{ 0 }; i < 8; ++i) {
+		glm::vec3 corner{ i & 1 ? bounds.max.x : bounds.min.x, i & 2 ? bounds.max.y : bounds.min.y,
+			i & 4 ? bounds.max.z : bounds.min.z };
+		glm::vec4 clip{ m_viewProjection * glm::vec4{ corner, 1 } };
+		if (clip.w <= 1e-5f) {
+			// Part of the box is behind the camera.
+			return false;
+		}
+		glm::vec3 ndc{ glm::vec3{ clip } / clip.w };
+		glm::vec2 screen{ (ndc.x * 0.5f + 0.5f) * m_width, (ndc.y * 0.5f + 0.5f) * m_height };
+		lo = glm::min(lo, screen);
+		hi = glm::max(hi, screen);
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+	if (nearest < 0) {
+		return false;
+	}
+
+	int32_t x0{ std::max(static_cast<int32_t>(std::floor(lo.x)), 0) };
+	int32_t y0{ std::max(static_cast<int32_t>(std::floor(lo.y)), 0) };
+	int32_t x1{ std::min(static_cast<int32_t>(std::floor(hi.x)), static_cast<int32_t>(m_width) - 1) };
+	int32_t y1{ std::min(static_cast<int32_t>(std::floor(hi.y)), static_cast<int32_t>(m_height) - 1) };
+	if (x0 > x1 || y0 > y1) {
+		// Off screen; frustum culling handles that.
+		return false;
+	}
+
+	// The finest level at which the rectangle spans at most 2x2 texels (plus one for misalignment).
+	size_t level{ 0 };
+	while (level + 1 < m_levelSizes.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+		++level;
+	}
+
+	// First try two levels coarser, where there are fewer texels to read: the box is hidden if it's behind
+	// the farthest occluder depth everywhere, and visible if it's in front of the nearest anywhere.
+	size_t coarse{ std::min(level + 2, m_levelSizes.size() - 1) };
+	bool hidden{ true };
+	for (int32_t y{ y0 >> coarse }; y <= (y1 >> coarse); ++y) {
+		for (int32_t x{ x0 >> coarse }; x <= (x1 >> coarse); ++x) {
+			size_t texel{ static_cast<size_t>(y) * m_levelSizes[coarse].width + x };
+			if (nearest <= m_minDepth[coarse][texel]) {
+				return false;
+			}
+			hidden = hidden && nearest > m_maxDepth[coarse][texel];
+		}
+	}
+	if (hidden) {
+		return true;
+	}
+
+	for (int32_t y{ y0 >> level }; y <= (y1 >> level); ++y) {
+		for (int32_t x{ x0 >> level }; x <= (x1 >> level); ++x) {
+			size_t texel{ static_cast<size_t>(y) * m_levelSizes[level].width + x };
+			if (nearest <= m_maxDepth[level][texel]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+float OcclusionCuller::lastRasterMilliseconds() const {
+	return m_lastRasterMilliseconds;
+}
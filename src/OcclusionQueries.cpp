@@ -0,0 +1,175 @@
+#include <glad/glad.h>
+#include "OcclusionQueries.h"
+#include "FrameStats.h"
+
+void OcclusionQueries::load() {
+	m_program.load("shaders/bounds_query.vert", "shaders/uniform_color.frag");
+
+	// A unit cube; the vertex shader stretches it over the bounds.
+	const float corners[]{
+		0, 0, 0,  1, 0, 0,  0, 1, 0,  1, 1, 0,
+		0, 0, 1,  1, 0, 1,  0, 1, 1,  1, 1, 1,
+	};
+	const uint8_t faces[]{
+		0, 1, 3, 0, 3, 2,  4, 5, 7, 4, 7, 6,
+		0, 1, 5, 0, 5, 4,  2, 3, 7, 2, 7, 6,
+		0, 2, 6, 0, 6, 4,  1, 3, 7, 1, 7, 5,
+	};
+	m_cubeVao = GlVertexArray::create();
+	glBindVertexArray(m_cubeVao.id());
+	m_cubeVertices = GlBuffer::create();
+	glBindBuffer(GL_ARRAY_BUFFER, m_cubeVertices.id());
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	m_cubeVertices.account(VramCategory::vertex, sizeof(corners));
+	glVertexAttribPointer(0, 3, GL_FLOAT, false, 3 * sizeof(float), 0);
+	glEnableVertexAttribArray(0);
+	m_cubeIndices = GlBuffer::create();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_cubeIndices.id());
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+	m_cubeIndices.account(VramCategory::index, sizeof(faces));
+	glBindVertexArray(0);
+
+	for (auto& q : m_queries) {
+		q.query = GlQuery::create();
+	}
+	m_loaded = true;
+}
+
+void OcclusionQueries::track(uint32_t id) {
+	if (isTracked(id)) {
+		return;
+	}
+	TrackedQuery q{ id };
+	if (m_loaded) {
+		q.query = GlQuery::create();
+	}
+	m_queries.push_back(std::move(q));
+}
+
+bool OcclusionQueries::isTracked(uint32_t id) const {
+	return find(id) != nullptr;
+}
+
+const char* OcclusionQueries::cycleMode() {
+	switch (mode) {
+	case Mode::off:
+		mode = Mode::previousFrame;
+		return "previous frame";
+	case Mode::previousFrame:
+		mode = Mode::conditional;
+		return "conditional render";
+	default:
+		mode = Mode::off;
+		return "off";
+	}
+}
+
+void OcclusionQueries::beginFrame() {
+	++m_frame;
+	FrameStats& stats{ frameStats() };
+	uint64_t latencyTotal{ 0 };
+	for (auto& q : m_queries) {
+		if (!q.pending) {
+			continue;
+		}
+		int32_t available{ 0 };
+		glGetQueryObjectiv(q.query.id(), GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			continue;
+		}
+		uint32_t passed{ 0 };
+		glGetQueryObjectuiv(q.query.id(), GL_QUERY_RESULT, &passed);
+		// A result from before the camera moved into the bounds no longer applies.
+		q.visible = passed != 0 || q.cameraInside;
+		q.pending = false;
+		++stats.queryResults;
+		stats.queryOccluded += q.visible ? 0 : 1;
+		latencyTotal += m_frame - q.issuedFrame;
+	}
+	if (stats.queryResults > 0) {
+		stats.queryLatencyFrames = static_cast<float>(latencyTotal) / stats.queryResults;
+	}
+}
+
+bool OcclusionQueries::shouldDraw(uint32_t id) const {
+	const TrackedQuery* q{ find(id) };
+	return mode != Mode::previousFrame || q == nullptr || q->visible;
+}
+
+void OcclusionQueries::markOutside(uint32_t id) {
+	if (TrackedQuery* q{ find(id) }) {
+		q->visible = true;
+	}
+}
+
+void OcclusionQueries::beginConditional(uint32_t id) {
+	TrackedQuery* q{ find(id) };
+	if (mode == Mode::conditional && q != nullptr && q->issued && !q->cameraInside) {
+		glBeginConditionalRender(q->query.id(), GL_QUERY_NO_WAIT);
+		q->conditionalActive = true;
+	}
+}
+
+void OcclusionQueries::endConditional(uint32_t id) {
+	TrackedQuery* q{ find(id) };
+	if (q != nullptr && q->conditionalActive) {
+		glEndConditionalRender();
+		q->conditionalActive = false;
+	}
+}
+
+void OcclusionQueries::issue(uint32_t id, const BoundingBox& bounds, const glm::mat4& viewProjection,
+	const glm::vec3& eye, float nearMargin) {
+	TrackedQuery* q{ find(id) };
+	if (mode == Mode::off || q == nullptr || bounds.isEmpty()) {
+		return;
+	}
+	// From inside the bounds only the box's far faces are drawn, and they lie behind the object itself, so
+	// the query would report it hidden. The camera is surrounded by the object, so it counts as visible.
+	q->cameraInside = bounds.contains(eye, nearMargin);
+	if (q->cameraInside) {
+		q->visible = true;
+		return;
+	}
+	if (q->pending) {
+		return;
+	}
+
+	m_program.activate();
+	m_program.setUniform("viewProjection", viewProjection);
+	m_program.setUniform("boundsMin", bounds.min);
+	m_program.setUniform("boundsMax", bounds.max);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	glBindVertexArray(m_cubeVao.id());
+
+	glBeginQuery(GL_ANY_SAMPLES_PASSED, q->query.id());
+	glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, nullptr);
+	glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+	glBindVertexArray(0);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	q->pending = true;
+	q->issued = true;
+	q->issuedFrame = m_frame;
+	++frameStats().queriesIssued;
+}
+
+OcclusionQueries::TrackedQuery* OcclusionQueries::find(uint32_t id) {
+	for (auto& q : m_queries) {
+		if (q.id == id) {
+			return &q;
+		}
+	}
+	return nullptr;
+}
+
+const OcclusionQueries::TrackedQuery* OcclusionQueries::find(uint32_t id) const {
+	for (auto& q : m_queries) {
+		if (q.id == id) {
+			return &q;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,344 @@
+#include <glad/glad.h>
+#include "RenderQueue.h"
+#include "FrameStats.h"
+#include "StreamBuffer.h"
+#include <array>
+#include <cfloat>
+#include <chrono>
+
+namespace {
+	// Key layout, high to low: program (8 bits), texture set (16), VAO (16), depth (24).
+	constexpr uint32_t depthBits{ 24 };
+
+	// A 16-bit digest of a texture set. Different sets can share a digest; that only costs a rebind.
+	uint64_t textureSetKey(const std::vector<Texture>& textures) {
+		uint32_t hash{ 2166136261u };
+		for (auto& t : textures) {
+			hash = (hash ^ t.textureId) * 16777619u;
+		}
+		return (hash ^ (hash >> 16)) & 0xFFFF;
+	}
+
+	bool sameTextureIds(const std::vector<Texture>& a, const std::vector<Texture>& b) {
+		if (a.size() != b.size()) {
+			return false;
+		}
+		for (size_t i{ 0 }; i < a.size(); ++i) {
+			if (a[i].textureId != b[i].textureId) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+void radixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch) {
+	scratch.resize(entries.size());
+	// Count every byte of every key in one pass.
+	std::array<std::array<uint32_t, 256>, 8> counts{};
+	for (auto& e : entries) {
+		for (uint32_t pass{ 0 }; pass < 8; ++pass) {
+			++counts[pass][(e.key >> (pass * 8)) & 0xFF];
+		}
+	}
+
+	SortEntry* from{ entries.data() };
+	SortEntry* to{ scratch.data() };
+	for (uint32_t pass{ 0 }; pass < 8; ++pass) {
+		auto& count{ counts[pass] };
+		uint32_t shift{ pass * 8 };
+		if (!entries.empty() && count[(entries[0].key >> shift) & 0xFF] == entries.size()) {
+			// Every key has the same byte here; this pass wouldn't move anything.
+			continue;
+		}
+		uint32_t offset{ 0 };
+		for (auto& c : count) {
+			uint32_t n{ c };
+			c = offset;
+			offset += n;
+		}
+		for (size_t i{ 0 }; i < entries.size(); ++i) {
+			to[count[(from[i].key >> shift) & 0xFF]++] = from[i];
+		}
+		std::swap(from, to);
+	}
+	if (from != entries.data()) {
+		entries.swap(scratch);
+	}
+}
+
+void RenderQueue::begin(const glm::vec3& cameraPos, float maxDepth, float projectionScale, const Frustum& frustum) {
+	m_items.clear();
+	m_cameraPos = cameraPos;
+	m_maxDepth = maxDepth;
+	m_projectionScale = projectionScale;
+	m_frustum = frustum;
+}
+
+void RenderQueue::add(ShaderProgram& program, const Mesh& mesh, const glm::mat4& model, const glm::vec4* material,
+	const BoundingBox& worldBounds) {
+	float distance{ glm::distance(m_cameraPos, worldBounds.center()) };
+	float depth{ glm::clamp(distance / m_maxDepth, 0.0f, 1.0f) };
+	// The diameter of the bounding sphere as a fraction of the screen height; a camera inside the bounds
+	// always gets full detail.
+	float radius{ glm::length(worldBounds.extents()) };
+	float screenSize{ distance > radius ? radius * m_projectionScale / distance : FLT_MAX };
+	const MeshLod& lod{ mesh.selectLod(screenSize) };
+	uint64_t key{ static_cast<uint64_t>(program.id() & 0xFF) << 56
+		| textureSetKey(mesh.textures) << 40
+		| static_cast<uint64_t>(mesh.vao & 0xFFFF) << depthBits
+		| static_cast<uint64_t>(depth * ((1 << depthBits) - 1)) };
+	FrameStats& stats{ frameStats() };
+	stats.fullDetailTriangles += mesh.faceCount / 3;
+
+	// At full detail a mesh with meshlets draws only the ones that survive culling, tested in its own space.
+	if (meshletCulling && mesh.meshlets && &lod == &mesh.lods[0]) {
+		glm::mat4 transposed{ glm::transpose(model) };
+		glm::vec4 planes[6]{};
+		for (uint32_t i{ 0 }; i < 6; ++i) {
+			planes[i] = transposed * m_frustum.planes[i];
+			planes[i] = planes[i] / glm::length(glm::vec3{ planes[i] });
+		}
+		glm::vec3 camera{ glm::inverse(model) * glm::vec4{ m_cameraPos, 1 } };
+		MeshletCullCounts counts{ cullMeshlets(*mesh.meshlets, planes, camera, m_meshletRanges) };
+		stats.meshletsVisible += counts.visible;
+		stats.meshletsConeCulled += counts.coneCulled;
+		stats.meshletsFrustumCulled += counts.frustumCulled;
+		for (auto& range : m_meshletRanges) {
+			m_items.push_back(DrawItem{ key, &program, &mesh.textures, mesh.vao, mesh.format, &mesh.decode,
+				mesh.indexType, mesh.geometry->firstIndex + range.firstIndex, range.indexCount, mesh.baseVertex(),
+				&model, material });
+			stats.triangles += range.indexCount / 3;
+		}
+		return;
+	}
+
+	m_items.push_back(DrawItem{ key, &program, &mesh.textures, mesh.vao, mesh.format, &mesh.decode, mesh.indexType,
+		mesh.geometry->firstIndex + lod.firstIndex, lod.indexCount, mesh.baseVertex(), &model, material });
+	stats.triangles += lod.indexCount / 3;
+}
+
+void RenderQueue::sort() {
+	m_order.clear();
+	for (uint32_t i{ 0 }; i < m_items.size(); ++i) {
+		m_order.push_back(SortEntry{ m_items[i].sortKey, i });
+	}
+	radixSort(m_order, m_scratch);
+}
+
+bool RenderQueue::multiDrawIndirectSupported() {
+	return GLAD_GL_VERSION_4_3 != 0;
+}
+
+void RenderQueue::addIndirectProgram(ShaderProgram& program, ShaderProgram& indirectProgram) {
+	m_indirectPrograms.emplace_back(&program, &indirectProgram);
+}
+
+const char* RenderQueue::cycleMode() {
+	if (mode == SubmitMode::loop && multiDrawIndirectSupported()) {
+		mode = SubmitMode::multiDrawIndirect;
+		return "multi-draw indirect";
+	}
+	mode = SubmitMode::loop;
+	return "draw loop";
+}
+
+void RenderQueue::submit() {
+	auto start{ std::chrono::steady_clock::now() };
+	SubmitState state{};
+	bool indirect{ mode == SubmitMode::multiDrawIndirect && multiDrawIndirectSupported() };
+	if (indirect) {
+		submitIndirect(state);
+	}
+	else {
+		submitLoop(0, m_order.size(), state);
+	}
+	// Leave no VAO bound, so later buffer setup can't modify the last one drawn.
+	glBindVertexArray(0);
+
+	float milliseconds{ std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() };
+	frameStats().submitMilliseconds += milliseconds;
+	m_submitMilliseconds[indirect] += milliseconds;
+	++m_submitFrames[indirect];
+}
+
+void RenderQueue::bindState(ShaderProgram* program, const std::vector<Texture>* textures, const glm::vec4* material,
+	SubmitState& state) {
+	FrameStats& stats{ frameStats() };
+	if (program != state.program) {
+		state.program = program;
+		program->activate();
+		++stats.programChanges;
+		// Uniforms belong to the program, so they have to be set again.
+		state.textures = nullptr;
+		state.model = nullptr;
+		state.material = nullptr;
+	}
+	if (state.textures == nullptr || (textures != state.textures && !sameTextureIds(*textures, *state.textures))) {
+		for (uint32_t i{ 0 }; i < textures->size(); ++i) {
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D, (*textures)[i].textureId);
+			program->setUniform((*textures)[i].samplerName, static_cast<int32_t>(i));
+		}
+		++stats.textureChanges;
+	}
+	state.textures = textures;
+	const glm::vec4* itemMaterial{ material != nullptr ? material : &defaultMaterial };
+	if (itemMaterial != state.material) {
+		state.material = itemMaterial;
+		program->setUniform("material", *itemMaterial);
+	}
+}
+
+void RenderQueue::submitLoop(size_t first, size_t end, SubmitState& state) {
+	FrameStats& stats{ frameStats() };
+	for (size_t i{ first }; i < end; ++i) {
+		const DrawItem& item{ m_items[m_order[i].item] };
+		bindState(item.program, item.textures, item.material, state);
+		if (item.vao != state.vao) {
+			state.vao = item.vao;
+			glBindVertexArray(state.vao);
+			++stats.vaoChanges;
+		}
+		if (item.decode != state.decode) {
+			state.decode = item.decode;
+			glVertexAttrib4fv(7, &item.decode->offset.x);
+			glVertexAttrib4fv(8, &item.decode->scale.x);
+		}
+		if (item.model != state.model) {
+			state.model = item.model;
+			item.program->setUniform("model", *state.model);
+		}
+
+		uintptr_t indexSize{ item.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t) };
+		glDrawElementsBaseVertex(GL_TRIANGLES, item.indexCount, item.indexType,
+			reinterpret_cast<const void*>(item.firstIndex * indexSize), item.baseVertex);
+		++stats.drawCalls;
+	}
+}
+
+void RenderQueue::submitIndirect(SubmitState& state) {
+	FrameStats& stats{ frameStats() };
+
+	// Split the sorted items into batches. Multi-draw batches end wherever the vertex format, index type,
+	// textures or material change; items whose program has no indirect variant are drawn one by one.
+	m_batches.clear();
+	m_commands.clear();
+	m_drawData.clear();
+	for (size_t i{ 0 }; i < m_order.size(); ++i) {
+		const DrawItem& item{ m_items[m_order[i].item] };
+		ShaderProgram* indirectProgram{ indirectProgramFor(item.program) };
+		Batch* batch{ m_batches.empty() ? nullptr : &m_batches.back() };
+		if (indirectProgram == nullptr) {
+			if (batch == nullptr || batch->indirectProgram != nullptr) {
+				m_batches.push_back(Batch{ nullptr, item.format, item.indexType, nullptr, nullptr,
+					static_cast<uint32_t>(i), 0 });
+				batch = &m_batches.back();
+			}
+			++batch->count;
+			continue;
+		}
+		if (batch == nullptr || batch->indirectProgram != indirectProgram || batch->format != item.format
+			|| batch->indexType != item.indexType || batch->material != item.material
+			|| (batch->textures != item.textures && !sameTextureIds(*batch->textures, *item.textures))) {
+			m_batches.push_back(Batch{ indirectProgram, item.format, item.indexType, item.textures, item.material,
+				static_cast<uint32_t>(m_commands.size()), 0 });
+			batch = &m_batches.back();
+		}
+		// The base instance selects the draw's model matrix and vertex decode.
+		m_commands.push_back(DrawElementsIndirectCommand{ item.indexCount, 1, item.firstIndex, item.baseVertex,
+			static_cast<uint32_t>(m_drawData.size()) });
+		m_drawData.push_back(IndirectDrawData{ *item.model, *item.decode });
+		++batch->count;
+	}
+
+	if (!m_commands.empty()) {
+		// The draw data goes at a multiple of its own size, so the per-instance attributes can read it from
+		// the start of the stream buffer and each command's base instance just moves past what came before.
+		StreamBuffer& stream{ streamBuffer() };
+		m_drawDataAllocation = stream.upload(m_drawData.data(), m_drawData.size() * sizeof(IndirectDrawData),
+			sizeof(IndirectDrawData));
+		uint32_t firstInstance{ static_cast<uint32_t>(m_drawDataAllocation.offset / sizeof(IndirectDrawData)) };
+		for (auto& command : m_commands) {
+			command.baseInstance += firstInstance;
+		}
+		m_commandAllocation = stream.upload(m_commands.data(), m_commands.size() * sizeof(DrawElementsIndirectCommand),
+			sizeof(DrawElementsIndirectCommand));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandAllocation.buffer);
+	}
+
+	const glm::mat4 identity{ 1 };
+	for (auto& batch : m_batches) {
+		if (batch.indirectProgram == nullptr) {
+			submitLoop(batch.first, batch.first + batch.count, state);
+			continue;
+		}
+		bindState(batch.indirectProgram, batch.textures, batch.material, state);
+		if (state.model != &identity) {
+			// Each command's matrix is the whole model matrix.
+			state.model = &identity;
+			batch.indirectProgram->setUniform("model", identity);
+		}
+		bindIndirectVao(batch.format, state);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, batch.indexType,
+			reinterpret_cast<const void*>(m_commandAllocation.offset + batch.first * sizeof(DrawElementsIndirectCommand)),
+			static_cast<int32_t>(batch.count), 0);
+		++stats.drawCalls;
+		stats.indirectDraws += batch.count;
+		// The decode attributes came from arrays, which leaves their constant values undefined.
+		state.decode = nullptr;
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void RenderQueue::bindIndirectVao(VertexFormat format, SubmitState& state) {
+	size_t f{ static_cast<size_t>(format) };
+	GeometryArena& arena{ geometryArena(format) };
+	if (!m_indirectVaos[f]) {
+		m_indirectVaos[f] = GlVertexArray::create();
+		m_arenaGenerations[f] = arena.generation() - 1;
+	}
+	bool newDrawDataBuffer{ m_drawDataBuffers[f] != m_drawDataAllocation.buffer };
+	if (state.vao != m_indirectVaos[f].id()) {
+		state.vao = m_indirectVaos[f].id();
+		glBindVertexArray(state.vao);
+		++frameStats().vaoChanges;
+	}
+	if (m_arenaGenerations[f] != arena.generation() || newDrawDataBuffer) {
+		// Set up for the arena's current buffers, and the draw data as per-instance attributes: the model
+		// matrix at 3 to 6, and the decode at 7 and 8. The stream buffer only changes when it grows.
+		arena.bindBuffers();
+		glBindBuffer(GL_ARRAY_BUFFER, m_drawDataAllocation.buffer);
+		for (uint32_t column{ 0 }; column < 6; ++column) {
+			glVertexAttribPointer(3 + column, 4, GL_FLOAT, false, sizeof(IndirectDrawData),
+				reinterpret_cast<void*>(static_cast<uintptr_t>(column) * sizeof(glm::vec4)));
+			glEnableVertexAttribArray(3 + column);
+			glVertexAttribDivisor(3 + column, 1);
+		}
+		m_arenaGenerations[f] = arena.generation();
+		m_drawDataBuffers[f] = m_drawDataAllocation.buffer;
+	}
+}
+
+ShaderProgram* RenderQueue::indirectProgramFor(const ShaderProgram* program) const {
+	for (auto& [queued, indirect] : m_indirectPrograms) {
+		if (queued == program) {
+			return indirect;
+		}
+	}
+	return nullptr;
+}
+
+size_t RenderQueue::size() const {
+	return m_items.size();
+}
+
+void RenderQueue::printTimings(std::ostream& out) const {
+	const char* names[]{ "draw loop", "multi-draw indirect" };
+	for (size_t i{ 0 }; i < m_submitFrames.size(); ++i) {
+		if (m_submitFrames[i] > 0) {
+			out << names[i] << ": " << m_submitMilliseconds[i] / m_submitFrames[i] << " ms per frame submitting, over "
+				<< m_submitFrames[i] << " frames" << std::endl;
+		}
+	}
+}
@@ -1,49 +1,204 @@
 #include "SceneObject.h"
 #include "ShaderProgram.h"
+#include "FrameStats.h"
+#include "TransformBatch.h"
 #include <glm/ext.hpp>
 
 glm::mat4 SceneObject::buildModelMatrix() const {
-	auto m{ glm::translate(glm::mat4{ 1 }, position) };
-	m = glm::translate(m, center * scale);
-	m = glm::rotate(m, orientation[2], glm::vec3{ 0, 0, 1 });
-	m = glm::rotate(m, orientation[0], glm::vec3{ 1, 0, 0 });
-	m = glm::rotate(m, orientation[1], glm::vec3{ 0, 1, 0 });
-	m = glm::scale(m, scale);
-	m = glm::translate(m, -center);
-	m = m * baseTransform;
-	return m;
+	return composeModelMatrix(position, orientation, scale, center, baseTransform);
 }
 
-void SceneObject::drawObject(ShaderProgram& program) const {
-	drawObjectRecursive(glm::mat4{ 1 }, program);
+void SceneObject::flatten() {
+	m_nodes.clear();
+	appendFlatNodes(*this, -1);
+	m_localMatrices.assign(m_nodes.size(), glm::mat4{ 1 });
+	m_worldMatrices.assign(m_nodes.size(), glm::mat4{ 1 });
+	m_worldChanged.assign(m_nodes.size(), 0);
+	m_nodeBounds.assign(m_nodes.size(), BoundingBox{});
+	m_subtreeBounds.assign(m_nodes.size(), BoundingBox{});
+	m_localBounds.assign(m_nodes.size(), BoundingBox{});
+	for (size_t i{ 0 }; i < m_nodes.size(); ++i) {
+		for (auto& mesh : m_nodes[i].object->meshes) {
+			m_localBounds[i].expand(mesh.bounds);
+		}
+	}
+	m_flattenedChildren = children.data();
 }
 
-void SceneObject::drawObjectRecursive(const glm::mat4& parentModel, ShaderProgram& program) const {
-	glm::mat4 localModel{ buildModelMatrix() };
+void SceneObject::appendFlatNodes(SceneObject& object, int32_t parent) {
+	int32_t index{ static_cast<int32_t>(m_nodes.size()) };
+	m_nodes.push_back(FlatNode{ &object, parent, 0 });
+	// Nothing is cached for a freshly flattened node yet.
+	object.m_transformDirty = true;
+	for (auto& child : object.children) {
+		appendFlatNodes(child, index);
+	}
+	m_nodes[index].subtreeEnd = static_cast<uint32_t>(m_nodes.size());
+}
 
-	// TODO: to render a hierarchical mesh, we must build the "true" model matrix for htis object,
-	// which is the combination of its parent's model matrix and the local model matrix.
-	// At the moment, we assume that localModel == trueModel, which is only true for the root 
-	// of a hierarchy. So this code only draws a mesh correctly if it has no children at all.
+void SceneObject::markDirty() {
+	m_transformDirty = true;
+}
 
-	/*glm::mat4 trueModel{ localModel };*/
+uint32_t SceneObject::updateWorldMatrices() {
+	if (m_nodes.empty() || m_flattenedChildren != children.data()) {
+		flatten();
+	}
+	// The root may have been moved since it was flattened; its children were moved along with it.
+	m_nodes[0].object = this;
 
-	// TODO: you must change the calculation above, so that parentModel is combined with localModel to 
-	// make trueModel. We want localModel's transformations to happen BEFORE parentModel's.
-	glm::mat4 trueModel = parentModel * localModel;
-	program.setUniform("model", trueModel);
+	// Gather every node whose local matrix is stale, and rebuild them all at once with the batched kernel.
+	// The scratch arrays keep their capacity between frames, so this doesn't allocate once warmed up.
+	m_dirtyNodes.clear();
+	m_dirtyTransforms.clear();
+	for (size_t i{ 0 }; i < m_nodes.size(); ++i) {
+		SceneObject& object{ *m_nodes[i].object };
+		m_worldChanged[i] = object.m_transformDirty;
+		if (object.m_transformDirty) {
+			m_dirtyNodes.push_back(static_cast<uint32_t>(i));
+			m_dirtyTransforms.add(object.position, object.orientation, object.scale, object.center, object.baseTransform);
+			object.m_transformDirty = false;
+		}
+	}
+	if (!m_dirtyNodes.empty()) {
+		m_dirtyMatrices.resize(m_dirtyNodes.size());
+		buildModelMatrices(m_dirtyTransforms, m_dirtyMatrices.data());
+		for (size_t i{ 0 }; i < m_dirtyNodes.size(); ++i) {
+			m_localMatrices[m_dirtyNodes[i]] = m_dirtyMatrices[i];
+		}
+	}
 
+	// Parents precede their children, so each parent's world matrix is ready by the time we need it.
+	uint32_t recomputed{ 0 };
+	for (size_t i{ 0 }; i < m_nodes.size(); ++i) {
+		const FlatNode& node{ m_nodes[i] };
+		bool parentChanged{ node.parent >= 0 && m_worldChanged[node.parent] };
+		if (!m_worldChanged[i] && !parentChanged) {
+			continue;
+		}
 
-	// Render each *mesh* in the object.
-	for (auto& mesh : meshes) {
-		mesh.drawMesh(program);
+		m_worldMatrices[i] = node.parent < 0 ? m_localMatrices[i] : m_worldMatrices[node.parent] * m_localMatrices[i];
+		m_worldChanged[i] = true;
+		++recomputed;
+	}
+	if (recomputed > 0) {
+		updateBounds();
+	}
+	return recomputed;
+}
+
+void SceneObject::updateBounds() {
+	for (size_t i{ 0 }; i < m_nodes.size(); ++i) {
+		m_nodeBounds[i] = m_localBounds[i].transformed(m_worldMatrices[i]);
+		m_subtreeBounds[i] = m_nodeBounds[i];
+	}
+	// Walking backwards visits every node after all of its descendants, so each subtree is complete
+	// by the time it is merged into its parent.
+	for (size_t i{ m_nodes.size() }; i-- > 1;) {
+		m_subtreeBounds[m_nodes[i].parent].expand(m_subtreeBounds[i]);
+	}
+}
+
+const BoundingBox& SceneObject::worldBounds() const {
+	static const BoundingBox empty{};
+	return m_subtreeBounds.empty() ? empty : m_subtreeBounds[0];
+}
+
+size_t SceneObject::nodeCount() const {
+	return m_nodes.size();
+}
+
+const BoundingBox& SceneObject::nodeBounds(size_t node) const {
+	return m_nodeBounds[node];
+}
+
+bool SceneObject::nodeMoved(size_t node) const {
+	return m_worldChanged[node] != 0;
+}
+
+void SceneObject::drawObject(ShaderProgram& program) {
+	frameStats().recomputedNodes += updateWorldMatrices();
+	drawNodes(program, nullptr);
+}
+
+void SceneObject::drawObject(ShaderProgram& program, const Frustum& frustum) {
+	frameStats().recomputedNodes += updateWorldMatrices();
+	drawNodes(program, &frustum);
+}
+
+// Calls visit(mesh, model, worldBounds) for every mesh in the hierarchy that isn't culled by the frustum,
+// in depth-first order.
+template <typename Visit>
+void SceneObject::visitVisibleMeshes(const Frustum* frustum, const OcclusionCuller* occlusion, Visit&& visit) {
+	FrameStats& stats{ frameStats() };
+	size_t i{ 0 };
+	while (i < m_nodes.size()) {
+		const FlatNode& node{ m_nodes[i] };
+		if (frustum != nullptr && !frustum->intersects(m_subtreeBounds[i])) {
+			// Nothing below this node can be visible either.
+			stats.culledNodes += node.subtreeEnd - static_cast<uint32_t>(i);
+			i = node.subtreeEnd;
+			continue;
+		}
+		if (occlusion != nullptr && occlusion->isOccluded(m_subtreeBounds[i])) {
+			stats.occluded += 1;
+			i = node.subtreeEnd;
+			continue;
+		}
+
+		visitNodeMeshes(i, frustum, occlusion, visit);
+		++i;
 	}
+}
 
-	// TODO: to render the rest of the hierarchy, you must loop through each element of "children",
-	// and have them render themselves recursively. The parent model matrix for your children is your own
-	// true model matrix.
-	for (auto child : children) {
-		child.drawObjectRecursive(trueModel, program);
+// Calls visit(mesh, model, worldBounds) for every mesh of one node, not counting its descendants, that isn't
+// culled by the frustum.
+template <typename Visit>
+void SceneObject::visitNodeMeshes(size_t node, const Frustum* frustum, const OcclusionCuller* occlusion, Visit&& visit) {
+	FrameStats& stats{ frameStats() };
+	const glm::mat4& model{ m_worldMatrices[node] };
+	for (auto& mesh : m_nodes[node].object->meshes) {
+		BoundingBox worldBounds{ mesh.bounds.transformed(model) };
+		if (frustum != nullptr && !frustum->intersects(worldBounds)) {
+			++stats.culledMeshes;
+			continue;
+		}
+		if (occlusion != nullptr && occlusion->isOccluded(worldBounds)) {
+			++stats.occluded;
+			continue;
+		}
+		visit(mesh, model, worldBounds);
+		++stats.visibleMeshes;
 	}
+}
+
+void SceneObject::drawNodes(ShaderProgram& program, const Frustum* frustum) {
+	const glm::mat4* modelSet{ nullptr };
+	visitVisibleMeshes(frustum, nullptr, [&](const Mesh& mesh, const glm::mat4& model, const BoundingBox&) {
+		if (&model != modelSet) {
+			program.setUniform("model", model);
+			modelSet = &model;
+		}
+		// Render each *mesh* in the object.
+		mesh.drawMesh(program);
+	});
+}
 
-}
\ No newline at end of file
+void SceneObject::enqueue(RenderQueue& queue, ShaderProgram& program, const Frustum& frustum,
+	const OcclusionCuller* occlusion) {
+	frameStats().recomputedNodes += updateWorldMatrices();
+	visitVisibleMeshes(&frustum, occlusion, [&](const Mesh& mesh, const glm::mat4& model, const BoundingBox& worldBounds) {
+		queue.add(program, mesh, model, nullptr, worldBounds);
+	});
+}
+
+void SceneObject::enqueueNode(size_t node, RenderQueue& queue, ShaderProgram& program, const Frustum& frustum,
+	const OcclusionCuller* occlusion) {
+	if (occlusion != nullptr && occlusion->isOccluded(m_nodeBounds[node])) {
+		++frameStats().occluded;
+		return;
+	}
+	visitNodeMeshes(node, &frustum, occlusion, [&](const Mesh& mesh, const glm::mat4& model, const BoundingBox& worldBounds) {
+		queue.add(program, mesh, model, nullptr, worldBounds);
+	});
+}
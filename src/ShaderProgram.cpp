@@ -5,7 +5,7 @@
 #include <iostream>
 
 ShaderProgram::ShaderProgram()
-	: m_programId(-1) {
+	: m_program{} {
 }
 
 void ShaderProgram::load(const std::string& vertexShaderPath, const std::string& fragmentShaderPath) {
@@ -66,16 +66,17 @@ void ShaderProgram::load(const std::string& vertexShaderPath, const std::string&
 	};
 
 	// shader Program
-	m_programId = glCreateProgram();
-	glAttachShader(m_programId, vertex);
-	glAttachShader(m_programId, fragment);
-	glLinkProgram(m_programId);
+	GlProgram program{ GlProgram::create() };
+	glAttachShader(program.id(), vertex);
+	glAttachShader(program.id(), fragment);
+	glLinkProgram(program.id());
 	// print linking errors if any
-	glGetProgramiv(m_programId, GL_LINK_STATUS, &success);
+	glGetProgramiv(program.id(), GL_LINK_STATUS, &success);
 	if (!success) {
-		glGetProgramInfoLog(m_programId, 512, NULL, infoLog);
+		glGetProgramInfoLog(program.id(), 512, NULL, infoLog);
 		throw std::runtime_error(infoLog);
 	}
+	m_program = std::move(program);
 
 	// delete the shaders as they're linked into our program now and no longer necessary
 	glDeleteShader(vertex);
@@ -83,41 +84,45 @@ void ShaderProgram::load(const std::string& vertexShaderPath, const std::string&
 }
 
 void ShaderProgram::activate() {
-	glUseProgram(m_programId);
+	glUseProgram(m_program.id());
+}
+
+uint32_t ShaderProgram::id() const {
+	return m_program.id();
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, bool value) {
-	glUniform1i(glGetUniformLocation(m_programId, uniformName.c_str()), (int32_t)value);
+	glUniform1i(glGetUniformLocation(m_program.id(), uniformName.c_str()), (int32_t)value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, int32_t value) {
-	glUniform1i(glGetUniformLocation(m_programId, uniformName.c_str()), value);
+	glUniform1i(glGetUniformLocation(m_program.id(), uniformName.c_str()), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, float value) {
-	glUniform1f(glGetUniformLocation(m_programId, uniformName.c_str()), value);
+	glUniform1f(glGetUniformLocation(m_program.id(), uniformName.c_str()), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec2& value) {
-	glUniform2fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+	glUniform2fv(glGetUniformLocation(m_program.id(), uniformName.c_str()), 1, &value[0]);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec3& value) {
-	glUniform3fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+	glUniform3fv(glGetUniformLocation(m_program.id(), uniformName.c_str()), 1, &value[0]);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec4& value) {
-	glUniform4fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+	glUniform4fv(glGetUniformLocation(m_program.id(), uniformName.c_str()), 1, &value[0]);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat2& value) {
-	glUniformMatrix2fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+	glUniformMatrix2fv(glGetUniformLocation(m_program.id(), uniformName.c_str()), 1, false, &value[0][0]);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat3& value) {
-	glUniformMatrix3fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+	glUniformMatrix3fv(glGetUniformLocation(m_program.id(), uniformName.c_str()), 1, false, &value[0][0]);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat4& value) {
-	glUniformMatrix4fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+	glUniformMatrix4fv(glGetUniformLocation(m_program.id(), uniformName.c_str()), 1, false, &value[0][0]);
 }
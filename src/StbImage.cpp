@@ -17,6 +17,16 @@ void StbImage::loadFromFile(const std::string& filepath) {
     m_data = std::unique_ptr<unsigned char[]>(data);
 }
 
+void StbImage::loadFromMemory(const unsigned char* bytes, size_t size, const std::string& name) {
+    unsigned char* data{ stbi_load_from_memory(bytes, static_cast<int>(size), &m_width, &m_height, &m_bpp, 4) };
+
+    if (data == nullptr) {
+        throw std::runtime_error("Could not load file " + name);
+    }
+
+    m_data = std::unique_ptr<unsigned char[]>(data);
+}
+
 int StbImage::getWidth() const { return m_width; }
 
 int StbImage::getHeight() const { return m_height; }
@@ -0,0 +1,153 @@
+#include <glad/glad.h>
+#include "StreamBuffer.h"
+#include "FrameStats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+
+StreamBuffer::StreamBuffer(size_t regionBytes, uint32_t regionCount)
+	: m_mode{ persistentMappingSupported() ? Mode::persistent : Mode::orphaning }, m_regionBytes{ regionBytes },
+	m_regionCount{ regionCount } {
+	create(regionBytes);
+}
+
+bool StreamBuffer::persistentMappingSupported() {
+#ifdef GL_ARB_buffer_storage
+	if (GLAD_GL_ARB_buffer_storage) {
+		return true;
+	}
+#endif
+	return GLAD_GL_VERSION_4_4 != 0;
+}
+
+void StreamBuffer::create(size_t regionBytes) {
+	// Nothing in flight uses the new buffer, so the old fences no longer guard anything.
+	for (void*& fence : m_fences) {
+		if (fence != nullptr) {
+			glDeleteSync(static_cast<GLsync>(fence));
+		}
+	}
+	m_fences.assign(m_regionCount, nullptr);
+	if (!m_staging.empty()) {
+		m_replacedStaging.push_back(std::move(m_staging));
+	}
+
+	m_regionBytes = regionBytes;
+	m_region = 0;
+	m_used = 0;
+	// The old buffer is deleted once the GPU has finished with it; a persistent mapping goes with it.
+	m_buffer = GlBuffer::create();
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer.id());
+	if (m_mode == Mode::persistent) {
+		size_t total{ m_regionBytes * m_regionCount };
+		GLbitfield flags{ GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT };
+		glBufferStorage(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(total), nullptr, flags);
+		m_mapped = static_cast<std::byte*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, static_cast<GLsizeiptr>(total), flags));
+		m_buffer.account(VramCategory::stream, total);
+	}
+	else {
+		glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(m_regionBytes), nullptr, GL_STREAM_DRAW);
+		m_staging = std::vector<std::byte>(m_regionBytes);
+		m_buffer.account(VramCategory::stream, m_regionBytes);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StreamBuffer::beginFrame() {
+	m_used = 0;
+	if (m_mode == Mode::orphaning) {
+		// New storage for the frame; the driver keeps the old one alive for draws still reading it.
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer.id());
+		glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(m_regionBytes), nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return;
+	}
+
+	GLsync fence{ static_cast<GLsync>(m_fences[m_region]) };
+	if (fence == nullptr) {
+		return;
+	}
+	auto start{ std::chrono::steady_clock::now() };
+	GLenum status{ glClientWaitSync(fence, 0, 0) };
+	if (status == GL_TIMEOUT_EXPIRED) {
+		// The GPU is still reading this region, regionCount frames on: a stall.
+		++m_stalls;
+		do {
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000);
+		} while (status == GL_TIMEOUT_EXPIRED);
+	}
+	glDeleteSync(fence);
+	m_fences[m_region] = nullptr;
+
+	float milliseconds{ std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() };
+	frameStats().streamWaitMilliseconds += milliseconds;
+	m_waitMilliseconds += milliseconds;
+	m_maxWaitMilliseconds = std::max(m_maxWaitMilliseconds, milliseconds);
+}
+
+void StreamBuffer::endFrame() {
+	frameStats().streamBytes += static_cast<uint32_t>(m_used);
+	m_peakBytes = std::max(m_peakBytes, m_used);
+	++m_frames;
+	m_replacedStaging.clear();
+	if (m_mode == Mode::persistent) {
+		m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_region = (m_region + 1) % m_regionCount;
+	}
+}
+
+StreamAllocation StreamBuffer::allocate(size_t bytes, size_t alignment) {
+	// Orphaned storage is a single region.
+	size_t regionStart{ m_mode == Mode::persistent ? m_region * m_regionBytes : 0 };
+	size_t offset{ (regionStart + m_used + alignment - 1) / alignment * alignment };
+	if (offset + bytes > regionStart + m_regionBytes) {
+		++m_grown;
+		create(std::max(m_regionBytes * 2, (bytes + alignment) * 2));
+		regionStart = 0;
+		offset = 0;
+	}
+	m_used = offset + bytes - regionStart;
+
+	std::byte* data{ m_mode == Mode::persistent ? m_mapped + offset : m_staging.data() + offset };
+	return StreamAllocation{ data, m_buffer.id(), offset, bytes };
+}
+
+void StreamBuffer::commit(const StreamAllocation& allocation) {
+	// Persistent mappings are coherent, so writes are already visible to commands issued after them.
+	if (m_mode == Mode::orphaning && allocation.size > 0) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, allocation.buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(allocation.offset),
+			static_cast<GLsizeiptr>(allocation.size), allocation.data);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+}
+
+StreamAllocation StreamBuffer::upload(const void* data, size_t bytes, size_t alignment) {
+	StreamAllocation allocation{ allocate(bytes, alignment) };
+	std::memcpy(allocation.data, data, bytes);
+	commit(allocation);
+	return allocation;
+}
+
+StreamBuffer::Mode StreamBuffer::mode() const {
+	return m_mode;
+}
+
+uint32_t StreamBuffer::buffer() const {
+	return m_buffer.id();
+}
+
+void StreamBuffer::printStats(std::ostream& out) const {
+	out << "Stream buffer: " << (m_mode == Mode::persistent ? "persistently mapped, " : "orphaned, ")
+		<< (m_mode == Mode::persistent ? m_regionCount : 1) << " x " << m_regionBytes / 1024 << " KB, grew "
+		<< m_grown << " times" << std::endl;
+	out << "  peak " << m_peakBytes / 1024 << " KB per frame; fence waits " << std::fixed << std::setprecision(3)
+		<< (m_frames > 0 ? m_waitMilliseconds / m_frames : 0.0) << " ms per frame, " << m_maxWaitMilliseconds
+		<< " ms at most, " << m_stalls << " stalls over " << m_frames << " frames" << std::defaultfloat << std::endl;
+}
+
+StreamBuffer& streamBuffer() {
+	static StreamBuffer buffer{};
+	return buffer;
+}
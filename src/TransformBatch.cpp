@@ -0,0 +1,342 @@
+#include "TransformBatch.h"
+#include <cmath>
+
+#if defined(__AVX2__)
+#define TRANSFORM_BATCH_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_BATCH_SSE2
+#endif
+
+#if defined(TRANSFORM_BATCH_AVX2) || defined(TRANSFORM_BATCH_SSE2)
+#include <immintrin.h>
+#endif
+
+glm::mat4 composeModelMatrix(const glm::vec3& position, const glm::vec3& orientation, const glm::vec3& scale,
+	const glm::vec3& center, const glm::mat4& baseTransform) {
+	auto m{ glm::translate(glm::mat4{ 1 }, position) };
+	m = glm::translate(m, center * scale);
+	m = glm::rotate(m, orientation[2], glm::vec3{ 0, 0, 1 });
+	m = glm::rotate(m, orientation[0], glm::vec3{ 1, 0, 0 });
+	m = glm::rotate(m, orientation[1], glm::vec3{ 0, 1, 0 });
+	m = glm::scale(m, scale);
+	m = glm::translate(m, -center);
+	m = m * baseTransform;
+	return m;
+}
+
+size_t TransformBatch::size() const {
+	return positionX.size();
+}
+
+void TransformBatch::clear() {
+	for (auto* v : { &positionX, &positionY, &positionZ, &orientationX, &orientationY, &orientationZ,
+		&scaleX, &scaleY, &scaleZ, &centerX, &centerY, &centerZ }) {
+		v->clear();
+	}
+	baseTransforms.clear();
+}
+
+void TransformBatch::add(const glm::vec3& position, const glm::vec3& orientation, const glm::vec3& scale,
+	const glm::vec3& center) {
+	positionX.push_back(position.x);
+	positionY.push_back(position.y);
+	positionZ.push_back(position.z);
+	orientationX.push_back(orientation.x);
+	orientationY.push_back(orientation.y);
+	orientationZ.push_back(orientation.z);
+	scaleX.push_back(scale.x);
+	scaleY.push_back(scale.y);
+	scaleZ.push_back(scale.z);
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+}
+
+void TransformBatch::add(const glm::vec3& position, const glm::vec3& orientation, const glm::vec3& scale,
+	const glm::vec3& center, const glm::mat4& baseTransform) {
+	add(position, orientation, scale, center);
+	baseTransforms.push_back(baseTransform);
+}
+
+namespace {
+	/*
+	 * buildModelMatrix composes T(position) * T(center * scale) * Rz * Rx * Ry * S * T(-center). Multiplying
+	 * the rotations out by hand gives R = Rz * Rx * Ry directly from the sines and cosines of the three
+	 * angles, and the translations collapse into one column:
+	 *     t = position + center * scale - R * S * center
+	 * so the kernels below never build the intermediate matrices at all.
+	 */
+	template <typename F>
+	void rotationTerms(const F& sx, const F& cx, const F& sy, const F& cy, const F& sz, const F& cz, F (&r)[3][3]) {
+		F szsx{ sz * sx };
+		F czsx{ cz * sx };
+		r[0][0] = cz * cy - szsx * sy;
+		r[0][1] = F{ 0.0f } - sz * cx;
+		r[0][2] = cz * sy + szsx * cy;
+		r[1][0] = sz * cy + czsx * sy;
+		r[1][1] = cz * cx;
+		r[1][2] = sz * sy - czsx * cy;
+		r[2][0] = F{ 0.0f } - cx * sy;
+		r[2][1] = sx;
+		r[2][2] = cx * cy;
+	}
+
+	// A single float, so the scalar path can share the rotation math with the SIMD ones.
+	struct F1 {
+		float v;
+		F1(float f) : v{ f } {}
+		friend F1 operator+(F1 a, F1 b) { return a.v + b.v; }
+		friend F1 operator-(F1 a, F1 b) { return a.v - b.v; }
+		friend F1 operator*(F1 a, F1 b) { return a.v * b.v; }
+	};
+
+#if defined(TRANSFORM_BATCH_SSE2) || defined(TRANSFORM_BATCH_AVX2)
+	// 4 floats in an SSE register.
+	struct F4 {
+		static constexpr size_t width{ 4 };
+		__m128 v;
+		F4(__m128 x) : v{ x } {}
+		F4(float f) : v{ _mm_set1_ps(f) } {}
+		static F4 load(const float* p) { return _mm_loadu_ps(p); }
+		friend F4 operator+(F4 a, F4 b) { return _mm_add_ps(a.v, b.v); }
+		friend F4 operator-(F4 a, F4 b) { return _mm_sub_ps(a.v, b.v); }
+		friend F4 operator*(F4 a, F4 b) { return _mm_mul_ps(a.v, b.v); }
+	};
+
+#endif
+
+#if defined(TRANSFORM_BATCH_SSE2) && !defined(TRANSFORM_BATCH_AVX2)
+	// Polynomial sine and cosine of 4 angles at once, after the Cephes sinf/cosf used by sse_mathfun.
+	// Accurate to about 1e-7 for angles within +-8192 radians. AVX2 builds use the 8-lane version instead.
+	void sinCos(F4 angle, F4& sine, F4& cosine) {
+		const __m128 signMask{ _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u))) };
+		__m128 x{ angle.v };
+		__m128 sinSign{ _mm_and_ps(x, signMask) };
+		x = _mm_andnot_ps(signMask, x);
+
+		// Find the octant, rounded up to an even one, and reduce x into [-pi/4, pi/4] around it.
+		__m128i j{ _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f))) };
+		j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+		__m128 y{ _mm_cvtepi32_ps(j) };
+		__m128 sinFlip{ _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29)) };
+		__m128 cosFlip{ _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29)) };
+		__m128 useSinPoly{ _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128())) };
+		sinSign = _mm_xor_ps(sinSign, sinFlip);
+
+		x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+		x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+		x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+		__m128 z{ _mm_mul_ps(x, x) };
+
+		__m128 c{ _mm_set1_ps(2.443315711809948e-5f) };
+		c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(-1.388731625493765e-3f));
+		c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(4.166664568298827e-2f));
+		c = _mm_mul_ps(_mm_mul_ps(c, z), z);
+		c = _mm_add_ps(_mm_sub_ps(c, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+		__m128 s{ _mm_set1_ps(-1.9515295891e-4f) };
+		s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(8.3321608736e-3f));
+		s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(-1.6666654611e-1f));
+		s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, z), x), x);
+
+		// Depending on the octant, sine and cosine swap polynomials.
+		__m128 sinResult{ _mm_or_ps(_mm_and_ps(useSinPoly, s), _mm_andnot_ps(useSinPoly, c)) };
+		__m128 cosResult{ _mm_or_ps(_mm_and_ps(useSinPoly, c), _mm_andnot_ps(useSinPoly, s)) };
+		sine = _mm_xor_ps(sinResult, sinSign);
+		cosine = _mm_xor_ps(cosResult, cosFlip);
+	}
+#endif
+
+#if defined(TRANSFORM_BATCH_SSE2) || defined(TRANSFORM_BATCH_AVX2)
+	// Transpose 16 registers of 4 lanes (one register per matrix element) into 4 column-major matrices.
+	void storeMatrices(F4 (&m)[4][4], glm::mat4* out) {
+		for (int column{ 0 }; column < 4; ++column) {
+			__m128 r0{ m[column][0].v }, r1{ m[column][1].v }, r2{ m[column][2].v }, r3{ m[column][3].v };
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(&out[0][column][0], r0);
+			_mm_storeu_ps(&out[1][column][0], r1);
+			_mm_storeu_ps(&out[2][column][0], r2);
+			_mm_storeu_ps(&out[3][column][0], r3);
+		}
+	}
+#endif
+
+#if defined(TRANSFORM_BATCH_AVX2)
+	// 8 floats in an AVX register.
+	struct F8 {
+		static constexpr size_t width{ 8 };
+		__m256 v;
+		F8(__m256 x) : v{ x } {}
+		F8(float f) : v{ _mm256_set1_ps(f) } {}
+		static F8 load(const float* p) { return _mm256_loadu_ps(p); }
+		friend F8 operator+(F8 a, F8 b) { return _mm256_add_ps(a.v, b.v); }
+		friend F8 operator-(F8 a, F8 b) { return _mm256_sub_ps(a.v, b.v); }
+		friend F8 operator*(F8 a, F8 b) { return _mm256_mul_ps(a.v, b.v); }
+	};
+
+	// The same polynomials as the SSE version, 8 lanes wide.
+	void sinCos(F8 angle, F8& sine, F8& cosine) {
+		const __m256 signMask{ _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(0x80000000u))) };
+		__m256 x{ angle.v };
+		__m256 sinSign{ _mm256_and_ps(x, signMask) };
+		x = _mm256_andnot_ps(signMask, x);
+
+		__m256i j{ _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516f))) };
+		j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+		__m256 y{ _mm256_cvtepi32_ps(j) };
+		__m256 sinFlip{ _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29)) };
+		__m256 cosFlip{ _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29)) };
+		__m256 useSinPoly{ _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256())) };
+		sinSign = _mm256_xor_ps(sinSign, sinFlip);
+
+		x = _mm256_fnmadd_ps(y, _mm256_set1_ps(0.78515625f), x);
+		x = _mm256_fnmadd_ps(y, _mm256_set1_ps(2.4187564849853515625e-4f), x);
+		x = _mm256_fnmadd_ps(y, _mm256_set1_ps(3.77489497744594108e-8f), x);
+		__m256 z{ _mm256_mul_ps(x, x) };
+
+		__m256 c{ _mm256_set1_ps(2.443315711809948e-5f) };
+		c = _mm256_fmadd_ps(c, z, _mm256_set1_ps(-1.388731625493765e-3f));
+		c = _mm256_fmadd_ps(c, z, _mm256_set1_ps(4.166664568298827e-2f));
+		c = _mm256_mul_ps(_mm256_mul_ps(c, z), z);
+		c = _mm256_add_ps(_mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), c), _mm256_set1_ps(1.0f));
+
+		__m256 s{ _mm256_set1_ps(-1.9515295891e-4f) };
+		s = _mm256_fmadd_ps(s, z, _mm256_set1_ps(8.3321608736e-3f));
+		s = _mm256_fmadd_ps(s, z, _mm256_set1_ps(-1.6666654611e-1f));
+		s = _mm256_fmadd_ps(_mm256_mul_ps(s, z), x, x);
+
+		__m256 sinResult{ _mm256_blendv_ps(c, s, useSinPoly) };
+		__m256 cosResult{ _mm256_blendv_ps(s, c, useSinPoly) };
+		sine = _mm256_xor_ps(sinResult, sinSign);
+		cosine = _mm256_xor_ps(cosResult, cosFlip);
+	}
+
+	// Split each 8-lane register into two halves and transpose them like the SSE version.
+	void storeMatrices(F8 (&m)[4][4], glm::mat4* out) {
+		for (int half{ 0 }; half < 2; ++half) {
+			F4 lanes[4][4]{
+				{ F4{ 0.0f }, F4{ 0.0f }, F4{ 0.0f }, F4{ 0.0f } }, { F4{ 0.0f }, F4{ 0.0f }, F4{ 0.0f }, F4{ 0.0f } },
+				{ F4{ 0.0f }, F4{ 0.0f }, F4{ 0.0f }, F4{ 0.0f } }, { F4{ 0.0f }, F4{ 0.0f }, F4{ 0.0f }, F4{ 0.0f } },
+			};
+			for (int c{ 0 }; c < 4; ++c) {
+				for (int r{ 0 }; r < 4; ++r) {
+					lanes[c][r] = half == 0 ? _mm256_castps256_ps128(m[c][r].v) : _mm256_extractf128_ps(m[c][r].v, 1);
+				}
+			}
+			storeMatrices(lanes, out + 4 * half);
+		}
+	}
+#endif
+
+#if defined(TRANSFORM_BATCH_SSE2) || defined(TRANSFORM_BATCH_AVX2)
+	// Builds F::width matrices per iteration and returns the index of the first transform it didn't handle.
+	template <typename F>
+	size_t buildModelMatricesSimd(const TransformBatch& b, glm::mat4* out) {
+		size_t count{ b.size() };
+		size_t i{ 0 };
+		for (; i + F::width <= count; i += F::width) {
+			F sx{ 0.0f }, cx{ 0.0f }, sy{ 0.0f }, cy{ 0.0f }, sz{ 0.0f }, cz{ 0.0f };
+			sinCos(F::load(&b.orientationX[i]), sx, cx);
+			sinCos(F::load(&b.orientationY[i]), sy, cy);
+			sinCos(F::load(&b.orientationZ[i]), sz, cz);
+
+			F r[3][3]{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+			rotationTerms(sx, cx, sy, cy, sz, cz, r);
+
+			F scale[3]{ F::load(&b.scaleX[i]), F::load(&b.scaleY[i]), F::load(&b.scaleZ[i]) };
+			F center[3]{ F::load(&b.centerX[i]), F::load(&b.centerY[i]), F::load(&b.centerZ[i]) };
+			F position[3]{ F::load(&b.positionX[i]), F::load(&b.positionY[i]), F::load(&b.positionZ[i]) };
+
+			// m[column][row], matching glm's layout.
+			F m[4][4]{
+				{ 0.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 0.0f },
+				{ 0.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f },
+			};
+			for (int c{ 0 }; c < 3; ++c) {
+				for (int row{ 0 }; row < 3; ++row) {
+					m[c][row] = r[row][c] * scale[c];
+				}
+			}
+			for (int row{ 0 }; row < 3; ++row) {
+				m[3][row] = position[row] + center[row] * scale[row]
+					- (m[0][row] * center[0] + m[1][row] * center[1] + m[2][row] * center[2]);
+			}
+			storeMatrices(m, out + i);
+		}
+		return i;
+	}
+
+	// out = out * base, with one SSE register per column.
+	void multiplyBaseSimd(glm::mat4& m, const glm::mat4& base) {
+		__m128 columns[4]{ _mm_loadu_ps(&m[0][0]), _mm_loadu_ps(&m[1][0]), _mm_loadu_ps(&m[2][0]), _mm_loadu_ps(&m[3][0]) };
+		for (int c{ 0 }; c < 4; ++c) {
+			__m128 result{ _mm_mul_ps(columns[0], _mm_set1_ps(base[c][0])) };
+			result = _mm_add_ps(result, _mm_mul_ps(columns[1], _mm_set1_ps(base[c][1])));
+			result = _mm_add_ps(result, _mm_mul_ps(columns[2], _mm_set1_ps(base[c][2])));
+			result = _mm_add_ps(result, _mm_mul_ps(columns[3], _mm_set1_ps(base[c][3])));
+			_mm_storeu_ps(&m[c][0], result);
+		}
+	}
+#endif
+}
+
+void buildModelMatricesScalar(const TransformBatch& b, glm::mat4* out, size_t first) {
+	bool hasBase{ b.baseTransforms.size() == b.size() };
+	for (size_t i{ first }; i < b.size(); ++i) {
+		F1 r[3][3]{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+		rotationTerms(F1{ std::sin(b.orientationX[i]) }, F1{ std::cos(b.orientationX[i]) },
+			F1{ std::sin(b.orientationY[i]) }, F1{ std::cos(b.orientationY[i]) },
+			F1{ std::sin(b.orientationZ[i]) }, F1{ std::cos(b.orientationZ[i]) }, r);
+
+		glm::vec3 scale{ b.scaleX[i], b.scaleY[i], b.scaleZ[i] };
+		glm::vec3 center{ b.centerX[i], b.centerY[i], b.centerZ[i] };
+		glm::vec3 position{ b.positionX[i], b.positionY[i], b.positionZ[i] };
+
+		glm::mat4& m{ out[i] };
+		for (int c{ 0 }; c < 3; ++c) {
+			for (int row{ 0 }; row < 3; ++row) {
+				m[c][row] = r[row][c].v * scale[c];
+			}
+			m[c][3] = 0;
+		}
+		for (int row{ 0 }; row < 3; ++row) {
+			m[3][row] = position[row] + center[row] * scale[row]
+				- (m[0][row] * center[0] + m[1][row] * center[1] + m[2][row] * center[2]);
+		}
+		m[3][3] = 1;
+
+		if (hasBase) {
+			m = m * b.baseTransforms[i];
+		}
+	}
+}
+
+void buildModelMatrices(const TransformBatch& batch, glm::mat4* out) {
+#if defined(TRANSFORM_BATCH_AVX2)
+	size_t done{ buildModelMatricesSimd<F8>(batch, out) };
+#elif defined(TRANSFORM_BATCH_SSE2)
+	size_t done{ buildModelMatricesSimd<F4>(batch, out) };
+#else
+	size_t done{ 0 };
+#endif
+
+#if defined(TRANSFORM_BATCH_SSE2) || defined(TRANSFORM_BATCH_AVX2)
+	if (batch.baseTransforms.size() == batch.size()) {
+		for (size_t i{ 0 }; i < done; ++i) {
+			multiplyBaseSimd(out[i], batch.baseTransforms[i]);
+		}
+	}
+#endif
+	buildModelMatricesScalar(batch, out, done);
+}
+
+const char* modelMatrixKernelName() {
+#if defined(TRANSFORM_BATCH_AVX2)
+	return "AVX2";
+#elif defined(TRANSFORM_BATCH_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
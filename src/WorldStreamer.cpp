@@ -0,0 +1,247 @@
+#include "WorldStreamer.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include "FrameStats.h"
+
+namespace {
+	// Cells straight ahead of the camera's travel count as this much closer than they are.
+	constexpr float travelBias{ 0.5f };
+
+	float toMegabytes(size_t bytes) {
+		return static_cast<float>(bytes) / (1 << 20);
+	}
+}
+
+WorldStreamer::WorldStreamer(float loadRadius, float unloadRadius)
+	: m_loadRadius{ loadRadius }, m_unloadRadius{ std::max(unloadRadius, loadRadius) } {
+}
+
+WorldStreamer::~WorldStreamer() {
+	for (auto& cell : m_cells) {
+		if (cell.job) {
+			jobSystem().wait(cell.job);
+		}
+	}
+}
+
+uint32_t WorldStreamer::addCell(const WorldCell& cell) {
+	m_cells.push_back(Cell{ cell });
+	return static_cast<uint32_t>(m_cells.size() - 1);
+}
+
+float WorldStreamer::distanceTo(const Cell& cell, const glm::vec3& cameraPos) const {
+	const BoundingBox& bounds{ cell.description.bounds };
+	glm::vec3 nearest{ glm::clamp(cameraPos, bounds.min, bounds.max) };
+	return glm::distance(cameraPos, nearest);
+}
+
+void WorldStreamer::startLoad(Cell& cell) {
+	cell.state = CellState::loading;
+	cell.requested = std::chrono::steady_clock::now();
+	cell.load = std::make_shared<Load>();
+	cell.job = jobSystem().submit([load = cell.load, models = cell.description.models, options = importOptions]() {
+		try {
+			for (auto& model : models) {
+				load->models.push_back(decodeStaticModel(model.path, options));
+				load->ramBytes += load->models.back().ramBytes();
+			}
+		}
+		catch (const std::exception& e) {
+			load->error = e.what();
+		}
+	});
+}
+
+void WorldStreamer::finishLoad(Cell& cell) {
+	cell.vramBytes = 0;
+	for (uint32_t i{ 0 }; i < cell.load->models.size(); ++i) {
+		const CellModel& placement{ cell.description.models[i] };
+		DecodedModel& decoded{ cell.load->models[i] };
+		// A model the registry already had was not decoded, and uploads nothing.
+		size_t uploaded{ decoded.existing ? 0 : decoded.vramBytes() };
+		ModelHandle model{ uploadStaticModel(decoded) };
+		ModelUse& use{ m_modelUses[model.get()] };
+		if (use.cells++ == 0) {
+			use.bytes = uploaded;
+			cell.vramBytes += uploaded;
+		}
+		SceneObject object{ AssetRegistry::instantiate(model) };
+		object.position = placement.position;
+		object.orientation = placement.orientation;
+		object.scale = placement.scale;
+		object.updateWorldMatrices();
+		cell.objects.push_back(std::move(object));
+	}
+	cell.state = CellState::resident;
+	m_vramBytes += cell.vramBytes;
+	m_ramBytes -= cell.load->ramBytes;
+	cell.load.reset();
+	cell.job.reset();
+	++cell.loads;
+	// A new cell counts as just seen, so it isn't the first to be evicted.
+	cell.lastVisibleFrame = m_frame;
+	cell.lastLoadMilliseconds = std::chrono::duration<float, std::milli>(
+		std::chrono::steady_clock::now() - cell.requested).count();
+	frameStats().cellLoadMilliseconds = std::max(frameStats().cellLoadMilliseconds, cell.lastLoadMilliseconds);
+	++frameStats().cellsUploaded;
+}
+
+void WorldStreamer::unload(Cell& cell) {
+	if (cell.state == CellState::resident) {
+		// Dropping the objects releases the models, unless something else still uses them. Their VRAM is only
+		// given back with the last resident cell that uses them.
+		for (auto& object : cell.objects) {
+			auto use{ m_modelUses.find(object.asset.get()) };
+			if (use != m_modelUses.end() && --use->second.cells == 0) {
+				m_vramBytes -= use->second.bytes;
+				m_modelUses.erase(use);
+			}
+		}
+		cell.objects.clear();
+	}
+	else if (cell.state == CellState::loading) {
+		m_ramBytes -= cell.load->ramBytes;
+		cell.load.reset();
+		cell.job.reset();
+	}
+	cell.state = CellState::unloaded;
+}
+
+void WorldStreamer::update(const glm::vec3& cameraPos) {
+	++m_frame;
+	m_travel = 0.9f * m_travel + (cameraPos - m_lastCameraPos);
+	m_lastCameraPos = cameraPos;
+	glm::vec3 travel{ glm::length(m_travel) > 1e-4f ? glm::normalize(m_travel) : glm::vec3{ 0 } };
+
+	// Collect finished loads: failed ones are given up on, and ones the camera has left are dropped. The
+	// decoded data of the rest is held in RAM until it is uploaded.
+	jobSystem().progress();
+	uint32_t pending{ 0 };
+	for (auto& cell : m_cells) {
+		if (cell.state != CellState::loading) {
+			continue;
+		}
+		if (cell.job && JobSystem::isDone(cell.job)) {
+			cell.job.reset();
+			m_ramBytes += cell.load->ramBytes;
+			if (!cell.load->error.empty()) {
+				std::cerr << "ERROR: streaming cell " << (&cell - m_cells.data()) << ": " << cell.load->error << std::endl;
+				unload(cell);
+				cell.state = CellState::failed;
+				continue;
+			}
+		}
+		if (!cell.job && distanceTo(cell, cameraPos) > m_unloadRadius) {
+			unload(cell);
+		}
+		pending += cell.job ? 1 : 0;
+	}
+
+	// Upload the decoded cells, nearest first.
+	std::vector<std::pair<float, Cell*>> decoded{};
+	for (auto& cell : m_cells) {
+		if (cell.state == CellState::loading && !cell.job) {
+			decoded.emplace_back(distanceTo(cell, cameraPos), &cell);
+		}
+	}
+	std::sort(decoded.begin(), decoded.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	for (uint32_t i{ 0 }; i < decoded.size() && i < maxUploadsPerFrame; ++i) {
+		finishLoad(*decoded[i].second);
+	}
+
+	// Unload the resident cells the camera has left, then evict the ones that have gone longest without being
+	// seen until the rest fit the VRAM budget. Cells seen last frame are never evicted.
+	for (auto& cell : m_cells) {
+		if (cell.state == CellState::resident && distanceTo(cell, cameraPos) > m_unloadRadius) {
+			unload(cell);
+		}
+	}
+	while (m_vramBytes > vramBudget) {
+		Cell* oldest{ nullptr };
+		for (auto& cell : m_cells) {
+			if (cell.state == CellState::resident && cell.lastVisibleFrame + 1 < m_frame
+				&& (!oldest || cell.lastVisibleFrame < oldest->lastVisibleFrame)) {
+				oldest = &cell;
+			}
+		}
+		if (!oldest) {
+			break;
+		}
+		++oldest->evictions;
+		++frameStats().cellsEvicted;
+		unload(*oldest);
+	}
+
+	// Start loading the highest priority cells in range. Over budget, only cells seen last frame may load, and
+	// cells that have been loaded before only come back if they fit, so unseen cells don't evict each other
+	// in a loop.
+	std::vector<std::pair<float, Cell*>> wanted{};
+	for (auto& cell : m_cells) {
+		float distance{ distanceTo(cell, cameraPos) };
+		if (cell.state != CellState::unloaded || distance > m_loadRadius) {
+			continue;
+		}
+		bool seen{ cell.lastVisibleFrame + 1 >= m_frame };
+		if (!seen && m_vramBytes + cell.vramBytes > vramBudget) {
+			continue;
+		}
+		glm::vec3 toCell{ cell.description.bounds.center() - cameraPos };
+		toCell.y = 0;
+		float ahead{ glm::length(toCell) > 1e-4f ? std::max(0.0f, glm::dot(glm::normalize(toCell), travel)) : 0 };
+		wanted.emplace_back(distance * (1 - travelBias * ahead), &cell);
+	}
+	std::sort(wanted.begin(), wanted.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	for (auto& [priority, cell] : wanted) {
+		if (pending >= maxPendingLoads || m_ramBytes >= ramBudget) {
+			break;
+		}
+		startLoad(*cell);
+		++pending;
+	}
+
+	FrameStats& stats{ frameStats() };
+	stats.cellsResident = static_cast<uint32_t>(residentCells());
+	stats.cellsLoading = pending;
+	stats.streamingRamMegabytes = toMegabytes(m_ramBytes);
+	stats.streamingVramMegabytes = toMegabytes(m_vramBytes);
+}
+
+void WorldStreamer::enqueue(RenderQueue& queue, ShaderProgram& program, const Frustum& frustum,
+	const OcclusionCuller* occlusion) {
+	for (auto& cell : m_cells) {
+		if (!frustum.intersects(cell.description.bounds)) {
+			continue;
+		}
+		cell.lastVisibleFrame = m_frame;
+		for (auto& object : cell.objects) {
+			object.enqueue(queue, program, frustum, occlusion);
+		}
+	}
+}
+
+size_t WorldStreamer::residentCells() const {
+	return std::count_if(m_cells.begin(), m_cells.end(),
+		[](const Cell& cell) { return cell.state == CellState::resident; });
+}
+
+size_t WorldStreamer::ramBytes() const {
+	return m_ramBytes;
+}
+
+size_t WorldStreamer::vramBytes() const {
+	return m_vramBytes;
+}
+
+void WorldStreamer::printCells(std::ostream& out) const {
+	const char* stateNames[]{ "unloaded", "loading", "resident", "failed" };
+	out << "streaming: " << toMegabytes(m_ramBytes) << " / " << toMegabytes(ramBudget) << " MB RAM, "
+		<< toMegabytes(m_vramBytes) << " / " << toMegabytes(vramBudget) << " MB VRAM" << std::endl;
+	for (uint32_t i{ 0 }; i < m_cells.size(); ++i) {
+		const Cell& cell{ m_cells[i] };
+		out << "  cell " << i << ": " << stateNames[static_cast<int>(cell.state)] << ", " << cell.loads
+			<< " loads, " << cell.evictions << " evictions, " << toMegabytes(cell.vramBytes) << " MB, last load "
+			<< std::fixed << std::setprecision(1) << cell.lastLoadMilliseconds << " ms" << std::defaultfloat
+			<< std::endl;
+	}
+}
@@ -11,6 +11,8 @@
 *   Main: initializes a Scene, advances Animators, and renders objects in the scene.
 */
 #include <glad/glad.h>
+#include <atomic>
+#include <cstdlib>
 #include <iostream>
 #include <filesystem>
 #include <numbers>
@@ -19,10 +21,26 @@
 #include <SFML/Window/Window.hpp>
 #include <SFML/Graphics.hpp>
 
+#include "AssetRegistry.h"
 #include "AssimpImport.h"
+#include "Bvh.h"
+#include "EntityStore.h"
+#include "FrameStats.h"
+#include "ForestScatter.h"
+#include "Frustum.h"
+#include "GeometryArena.h"
+#include "GpuResource.h"
+#include "Impostors.h"
+#include "InstanceRenderer.h"
+#include "JobSystem.h"
 #include "Mesh.h"
+#include "OcclusionCuller.h"
+#include "OcclusionQueries.h"
+#include "RenderQueue.h"
 #include "SceneObject.h"
 #include "ShaderProgram.h"
+#include "StreamBuffer.h"
+#include "WorldStreamer.h"
 
 #define M_PI std::numbers::pi_v<float>
 
@@ -31,8 +49,113 @@
 struct Scene {
 	ShaderProgram program{};
 	std::vector<SceneObject> objects{};
+	// Where prayer() put the hand-placed scenery in objects.
+	uint32_t house{ 0 };
+	uint32_t stump{ 0 };
+	uint32_t mushies{ 0 };
+	uint32_t tree{ 0 };
+	// A spatial index over the world-space bounds of every node that has meshes, for culling, picking
+	// and proximity queries. indexedNodes maps each index item back to its (object, node) pair.
+	Bvh index{};
+	std::vector<std::pair<uint32_t, uint32_t>> indexedNodes{};
+	// Per frame: which objects are drawn from their meshes (rather than as impostors or not at all), and the
+	// index items the frustum query found.
+	std::vector<uint8_t> queuedObjects{};
+	std::vector<uint32_t> visibleNodes{};
+	// Models loaded as entities rather than SceneObjects, and the list of their meshes to draw this frame.
+	EntityStore entities{};
+	std::vector<EntityDraw> entityDraws{};
+	RenderQueue queue{};
+	// Hides objects behind the big scenery before they are queued.
+	OcclusionCuller occlusion{ 256, 128 };
+	// GPU occlusion queries for the most expensive objects, which are identified by their index in objects.
+	OcclusionQueries queries{};
+	// Distant copies of the trees and mushrooms are drawn as impostors. impostorObjects maps an object index
+	// to its impostor.
+	ImpostorRenderer impostors{};
+	std::vector<std::pair<uint32_t, uint32_t>> impostorObjects{};
+	// The forest around the clearing: copies of the trees, stumps and mushrooms scattered in chunks around the
+	// camera, and drawn with instancing instead of as separate objects.
+	InstanceRenderer instances{};
+	ForestScatter forest{ 449, 48.0f, 150.0f, 190.0f };
+	// More landmarks out in the forest, in world cells that are streamed in and out around the camera.
+	WorldStreamer streamer{ 260.0f, 320.0f };
 };
 
+/**
+ * @brief Adds an object to the scene, returning its index in objects.
+ */
+uint32_t addObject(Scene& scene, SceneObject object) {
+	scene.objects.push_back(std::move(object));
+	return static_cast<uint32_t>(scene.objects.size() - 1);
+}
+
+/**
+ * @brief Builds the scene's spatial index from the current world-space bounds of its objects.
+ */
+void buildSceneIndex(Scene& scene) {
+	std::vector<BoundingBox> bounds{};
+	scene.indexedNodes.clear();
+	for (uint32_t o{ 0 }; o < scene.objects.size(); ++o) {
+		SceneObject& object{ scene.objects[o] };
+		object.updateWorldMatrices();
+		for (uint32_t n{ 0 }; n < object.nodeCount(); ++n) {
+			if (!object.nodeBounds(n).isEmpty()) {
+				bounds.push_back(object.nodeBounds(n));
+				scene.indexedNodes.emplace_back(o, n);
+			}
+		}
+	}
+	scene.index.build(bounds);
+}
+
+/**
+ * @brief Brings the scene's world matrices up to date, and refits the spatial index around anything that moved.
+ */
+void updateScene(Scene& scene) {
+	// Each object's hierarchy is independent, so they can be updated in parallel.
+	std::atomic<uint32_t> recomputed{ 0 };
+	jobSystem().parallelFor(scene.objects.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i{ begin }; i < end; ++i) {
+			recomputed += scene.objects[i].updateWorldMatrices();
+		}
+	});
+	frameStats().recomputedNodes += recomputed;
+
+	for (uint32_t i{ 0 }; i < scene.indexedNodes.size(); ++i) {
+		auto [o, n] { scene.indexedNodes[i] };
+		if (scene.objects[o].nodeMoved(n)) {
+			scene.index.update(i, scene.objects[o].nodeBounds(n));
+		}
+	}
+	scene.index.refit();
+}
+
+/**
+ * @brief Queues the meshes of the objects marked in queuedObjects, finding their nodes inside the frustum with
+ * one query of the spatial index instead of walking every object's hierarchy.
+ */
+void enqueueVisibleNodes(Scene& scene, const Frustum& frustum) {
+	scene.visibleNodes.clear();
+	scene.index.queryFrustum(frustum, scene.visibleNodes);
+	frameStats().culledNodes += static_cast<uint32_t>(scene.indexedNodes.size() - scene.visibleNodes.size());
+	for (uint32_t item : scene.visibleNodes) {
+		auto [o, n] { scene.indexedNodes[item] };
+		if (scene.queuedObjects[o]) {
+			scene.objects[o].enqueueNode(n, scene.queue, scene.program, frustum, &scene.occlusion);
+		}
+	}
+}
+
+/**
+ * @brief The vertex format static scenery is imported in: FOREST_VERTEX_FORMAT=packed stores it in 16 bytes
+ * per vertex instead of 32.
+ */
+VertexFormat sceneryVertexFormat() {
+	const char* format{ std::getenv("FOREST_VERTEX_FORMAT") };
+	return format != nullptr && std::string{ format } == "packed" ? VertexFormat::packed : VertexFormat::standard;
+}
+
 /**
  * @brief Constructs a shader program that applies the Phong reflection model.
  */
@@ -64,45 +187,172 @@ ShaderProgram texturingShader() {
 }
 
 /**
- * @brief Loads an image from the given path into an OpenGL texture.
+ * @brief Loads an image from the given path into an OpenGL texture, sharing it with anything else that
+ * already loaded the same image.
  */
-Texture loadTexture(const std::filesystem::path& path, const std::string& samplerName = "baseTexture") {
+TextureHandle loadTexture(const std::filesystem::path& path) {
+	std::string key{ AssetRegistry::canonicalKey(path) };
+	uint64_t hash{ AssetRegistry::hashFile(path) };
+	if (auto texture{ assetRegistry().findTexture(key, hash) }) {
+		return texture;
+	}
 	StbImage i{};
 	i.loadFromFile(path.string());
-	return Texture::loadImage(i, samplerName);
+	return assetRegistry().addTexture(key, hash, i);
+}
+
+/**
+ * @brief Registers occluders for the scenery that hides the most: the mushroom house, the stump and the
+ * tree trunk. Each is a box in the model's own space, measured from the vertices of its solid part (the
+ * house's walls below the cap, and the stump's and the tree's trunks) and kept well inside them.
+ */
+void addSceneOccluders(Scene& scene) {
+	scene.occlusion.clearOccluders();
+	// The House primitive's walls are about 0.55 across from y = 0.3 to 0.65, and wider above and below.
+	scene.occlusion.addOccluder(Occluder::box(BoundingBox{ glm::vec3{ -0.28f, 0.05f, -0.28f },
+		glm::vec3{ 0.28f, 0.75f, 0.28f } }, scene.objects[scene.house].buildModelMatrix()));
+	// The stump's Cylinder is about 85 units in radius up to y = 170, with roots spreading below y = 40.
+	scene.occlusion.addOccluder(Occluder::box(BoundingBox{ glm::vec3{ -45, 0, -45 }, glm::vec3{ 45, 140, 45 } },
+		scene.objects[scene.stump].buildModelMatrix()));
+	// The tree's trunk is about 0.55 in radius around (-0.6, -0.1) between y = 1.3 and 3.
+	scene.occlusion.addOccluder(Occluder::box(BoundingBox{ glm::vec3{ -0.9f, 1.3f, -0.4f },
+		glm::vec3{ -0.3f, 3.0f, 0.2f } }, scene.objects[scene.tree].buildModelMatrix()));
+}
+
+/**
+ * @brief Sets up the forest scatter with the tree, stump and mushroom models, keeping it out of the
+ * hand-placed clearing. Trees are placed first, so the smaller plants can keep clear of their trunks.
+ */
+void setupForest(Scene& scene, uint32_t seed) {
+	scene.instances.load();
+	scene.forest = ForestScatter{ seed, 48.0f, 150.0f, 190.0f };
+	scene.forest.keepOut.push_back(glm::vec3{ 8, -6, 25 });
+
+	const SceneObject& tree{ scene.objects[scene.tree] };
+	const SceneObject& stump{ scene.objects[scene.stump] };
+	const SceneObject& mushies{ scene.objects[scene.mushies] };
+	scene.forest.addRule(ScatterRule{ scene.instances.registerModel(tree), 12.0f, 0.9f, 0.0f,
+		tree.position.y, tree.scale.x, 0.7f, 1.3f });
+	scene.forest.addRule(ScatterRule{ scene.instances.registerModel(stump), 20.0f, 0.5f, 6.0f,
+		stump.position.y, stump.scale.x, 0.8f, 1.2f });
+	scene.forest.addRule(ScatterRule{ scene.instances.registerModel(mushies), 3.0f, 0.7f, 3.0f,
+		mushies.position.y, mushies.scale.x, 0.6f, 1.4f });
+}
+
+/**
+ * @brief Sets the camera and lighting uniforms shared by the Phong programs.
+ */
+void setLightingUniforms(ShaderProgram& program, const glm::mat4& view, const glm::mat4& projection,
+	const glm::vec3& cameraPos, const glm::vec4& material) {
+	program.activate();
+	program.setUniform("view", view);
+	program.setUniform("projection", projection);
+	program.setUniform("cameraPos", cameraPos);
+
+	// Material properties: ambient, diffuse, specular, shininess
+	program.setUniform("material", material);
+	program.setUniform("ambientColor", glm::vec3{ 0.65f, 0.65f, 0.65f });
+	program.setUniform(
+		"directionalLight",
+		glm::normalize(glm::vec3{ 0.3f, 1.0f, 0.7f })
+	);
+	program.setUniform("directionalColor", glm::vec3{ 1.0f, 1.0f, 1.0f });
+
+	program.setUniform(
+		"pointLight.position",
+		glm::vec3{ 0.8f, 3.3f, 0.5f }
+	);
+	program.setUniform("pointLight.color", glm::vec3(1.0f));
+	program.setUniform("pointLight.constant", 1.0f);
+	program.setUniform("pointLight.linear", 0.09f);
+	program.setUniform("pointLight.quadratic", 0.032f);
+}
+
+/**
+ * @brief Splits the world around the clearing into a grid of cells, each with a mushroom house and a stump of
+ * its own, for the streamer to load as the camera comes near. The clearing itself stays resident. Budgets in
+ * megabytes can be set with FOREST_RAM_BUDGET_MB and FOREST_VRAM_BUDGET_MB.
+ */
+void setupWorldCells(Scene& scene) {
+	constexpr float cellSize{ 160.0f };
+	constexpr int32_t cellsPerSide{ 7 };
+	if (const char* budget{ std::getenv("FOREST_RAM_BUDGET_MB") }) {
+		scene.streamer.ramBudget = std::stoull(budget) << 20;
+	}
+	if (const char* budget{ std::getenv("FOREST_VRAM_BUDGET_MB") }) {
+		scene.streamer.vramBudget = std::stoull(budget) << 20;
+	}
+	scene.streamer.importOptions.flipTextureCoords = true;
+	scene.streamer.importOptions.bakeStatic = true;
+	scene.streamer.importOptions.vertexFormat = sceneryVertexFormat();
+
+	for (int32_t z{ -cellsPerSide / 2 }; z <= cellsPerSide / 2; ++z) {
+		for (int32_t x{ -cellsPerSide / 2 }; x <= cellsPerSide / 2; ++x) {
+			if (x == 0 && z == 0) {
+				continue;
+			}
+			glm::vec3 center{ x * cellSize, 0, z * cellSize };
+			// A 45 degree step per cell; orientations are in radians, and the step must not go negative.
+			float turn{ glm::radians(static_cast<float>(((x * 7 + z * 13) % 8 + 8) % 8) * 45.0f) };
+			WorldCell cell{};
+			cell.bounds.expand(center - glm::vec3{ cellSize / 2, 10, cellSize / 2 });
+			cell.bounds.expand(center + glm::vec3{ cellSize / 2, 40, cellSize / 2 });
+			cell.models.push_back(CellModel{ "../../../models/mushroom/mushroom.gltf", center + glm::vec3{ 20, -1, -25 },
+				glm::vec3{ 0, turn, 0 }, glm::vec3{ 9, 9, 9 } });
+			cell.models.push_back(CellModel{ "../../../models/stump/stump.gltf", center + glm::vec3{ -30, -6, 20 },
+				glm::vec3{ 0, -turn, 0 }, glm::vec3{ .025, .025, .025 } });
+			// Keep the forest out of the landmarks.
+			for (auto& model : cell.models) {
+				scene.forest.keepOut.push_back(glm::vec3{ model.position.x, model.position.z, 20 });
+			}
+			scene.streamer.addCell(cell);
+		}
+	}
 }
 
 Scene prayer() {
 	Scene scene{ phongLightingShader() };
+	// Scenery never moves, so its node hierarchies can be baked into a few merged meshes.
+	ImportOptions staticModel{};
+	staticModel.flipTextureCoords = true;
+	staticModel.bakeStatic = true;
+	staticModel.vertexFormat = sceneryVertexFormat();
+
 		// house
-		auto house{ assimpLoad("../../../models/mushroom/mushroom.gltf", true) };
+		auto house{ assimpLoad("../../../models/mushroom/mushroom.gltf", staticModel) };
 		house.position = glm::vec3{ 7, -1, 0 }; 
 		house.scale = glm::vec3{ 9, 9, 9 };      
-		scene.objects.push_back(std::move(house));
+		scene.house = addObject(scene, std::move(house));
 
 		//stump
-		auto stump{ assimpLoad("../../../models/stump/stump.gltf", true) };
+		auto stump{ assimpLoad("../../../models/stump/stump.gltf", staticModel) };
 		stump.position = glm::vec3{ 9, -6, -23 };
 		stump.scale = glm::vec3{ .025, .025, .025 };
-		scene.objects.push_back(std::move(stump));
+		scene.stump = addObject(scene, std::move(stump));
 
 		//mushies 
-		auto mushies{ assimpLoad("../../../models/mushies/mushies.gltf", true) };
+		auto mushies{ assimpLoad("../../../models/mushies/mushies.gltf", staticModel) };
 		mushies.position = glm::vec3{ -5, -.6, -4 };
 		mushies.scale = glm::vec3{ 1, 1, 1 };
-		scene.objects.push_back(std::move(mushies));
+		scene.mushies = addObject(scene, std::move(mushies));
 
 		// tree
-		auto tree{ assimpLoad("../../../models/tree/tree.gltf", true) };
+		auto tree{ assimpLoad("../../../models/tree/tree.gltf", staticModel) };
 		tree.position = glm::vec3{ 22, -6, 2 };
 		tree.scale = glm::vec3{ 5, 5, 5 };
-		scene.objects.push_back(std::move(tree));
+		scene.tree = addObject(scene, std::move(tree));
 
 		// fairy
-		auto fairy{ assimpLoad("../../../models/fairy/fairy.gltf", true) };
-		fairy.position = glm::vec3{ 0.8f, 2.9f, 0.5f };
-		fairy.scale = glm::vec3{ .2f, .2f, .2f };
-		scene.objects.push_back(std::move(fairy));
+		ImportOptions animatedModel{};
+		animatedModel.flipTextureCoords = true;
+		Entity fairy{ assimpLoadEntities("../../../models/fairy/fairy.gltf", animatedModel, scene.entities) };
+		scene.entities.transform(fairy).position = glm::vec3{ 0.8f, 2.9f, 0.5f };
+		scene.entities.transform(fairy).scale = glm::vec3{ .2f, .2f, .2f };
+		for (auto& archetype : scene.entities.archetypes()) {
+			for (auto& material : archetype.materials) {
+				material.parameters = glm::vec4{ 0.2f, 0.8f, 0.4f, 32 };
+			}
+		}
 
 	return scene;
 }
@@ -112,6 +362,11 @@ int main() {
 
 	std::cout << "Current directory: " << std::filesystem::current_path() << std::endl;
 
+	// FOREST_WORKERS caps the number of background threads used for loading and scene updates.
+	if (const char* workers{ std::getenv("FOREST_WORKERS") }) {
+		configureJobSystem(static_cast<uint32_t>(std::stoul(workers)));
+	}
+
 	// Initialize the window and OpenGL.
 	sf::ContextSettings settings;
 	settings.depthBits = 24;
@@ -139,6 +394,34 @@ int main() {
 	glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
 
 	Scene myScene = prayer();
+	buildSceneIndex(myScene);
+	addSceneOccluders(myScene);
+	// The mushroom house and the tree are by far the heaviest objects.
+	myScene.queries.load();
+	myScene.queries.track(myScene.house);
+	myScene.queries.track(myScene.tree);
+	// FOREST_IMPOSTOR_DISTANCE sets how far away the mushrooms and the tree turn into impostors.
+	myScene.impostors.load();
+	if (const char* distance{ std::getenv("FOREST_IMPOSTOR_DISTANCE") }) {
+		myScene.impostors.switchDistance = std::stof(distance);
+	}
+	for (uint32_t object : { myScene.mushies, myScene.tree }) {
+		myScene.impostorObjects.emplace_back(object, myScene.impostors.bake(myScene.objects[object]));
+	}
+	// FOREST_SEED picks which forest grows around the clearing.
+	uint32_t seed{ 449 };
+	if (const char* value{ std::getenv("FOREST_SEED") }) {
+		seed = static_cast<uint32_t>(std::stoul(value));
+	}
+	setupForest(myScene, seed);
+	// The instanced program reads a per-instance model matrix, which is what multi-draw indirect needs.
+	// FOREST_SUBMIT=indirect starts with multi-draw indirect, if the context supports it.
+	myScene.queue.addIndirectProgram(myScene.program, myScene.instances.program());
+	if (const char* submit{ std::getenv("FOREST_SUBMIT") }; submit && std::string{ submit } == "indirect") {
+		std::cout << "submission: " << myScene.queue.cycleMode() << std::endl;
+	}
+	setupWorldCells(myScene);
+	assetRegistry().printStats(std::cout);
 	myScene.program.activate();
 
 	// Camera setup
@@ -154,17 +437,24 @@ int main() {
 	bool firstMouse = true;
 	sf::Vector2i lastMousePos;
 
+	// Culling that tests bounds near the eye allows for the near plane cutting into them: its corners are
+	// within twice its distance of the eye at any field of view below about 100 degrees.
+	constexpr float nearPlane{ 0.1f };
+	constexpr float nearClipMargin{ 2 * nearPlane };
 	glm::mat4 projection =
 		glm::perspective(glm::radians(45.0f),
 			static_cast<float>(window.getSize().x) /
 			static_cast<float>(window.getSize().y),
-			0.1f, 500.0f); 
+			nearPlane, 500.0f); 
 
 	sf::Clock c;
 
 	int frameCount = 0;
 	while (window.isOpen()) {
 		frameCount++;
+		frameStats().reset();
+		// Per-frame data goes in the stream buffer region the GPU finished reading longest ago.
+		streamBuffer().beginFrame();
 
 		// Frame time for smooth movement
 		float deltaTime = c.restart().asSeconds();
@@ -178,6 +468,37 @@ int main() {
 			if (event->is<sf::Event::Closed>()) {
 				window.close();
 			}
+			// Q switches the occlusion query mode.
+			else if (auto key{ event->getIf<sf::Event::KeyPressed>() }; key && key->scancode == sf::Keyboard::Scancode::Q) {
+				std::cout << "occlusion queries: " << myScene.queries.cycleMode() << std::endl;
+			}
+			// I dumps the impostor atlases into the working directory.
+			else if (auto key{ event->getIf<sf::Event::KeyPressed>() }; key && key->scancode == sf::Keyboard::Scancode::I) {
+				myScene.impostors.dumpAtlases(".");
+			}
+			// L lists the streamed world cells with their memory use and load times, and the shared assets.
+			else if (auto key{ event->getIf<sf::Event::KeyPressed>() }; key && key->scancode == sf::Keyboard::Scancode::L) {
+				myScene.streamer.printCells(std::cout);
+				assetRegistry().printStats(std::cout);
+			}
+			// M switches the render queue between a draw call per mesh and multi-draw indirect.
+			else if (auto key{ event->getIf<sf::Event::KeyPressed>() }; key && key->scancode == sf::Keyboard::Scancode::M) {
+				std::cout << "submission: " << myScene.queue.cycleMode() << std::endl;
+				myScene.queue.printTimings(std::cout);
+			}
+			// C switches culling big meshes a meshlet at a time on and off.
+			else if (auto key{ event->getIf<sf::Event::KeyPressed>() }; key && key->scancode == sf::Keyboard::Scancode::C) {
+				myScene.queue.meshletCulling = !myScene.queue.meshletCulling;
+				std::cout << "meshlet culling (" << meshletKernelName() << "): "
+					<< (myScene.queue.meshletCulling ? "on" : "off") << std::endl;
+			}
+			// V prints the live GL objects and the VRAM they take, by category, each geometry arena's use and the
+			// stream buffer's fence waits.
+			else if (auto key{ event->getIf<sf::Event::KeyPressed>() }; key && key->scancode == sf::Keyboard::Scancode::V) {
+				gpuResources().printTable(std::cout);
+				printGeometryArenaStats(std::cout);
+				streamBuffer().printStats(std::cout);
+			}
 		}
 
 		// Handle keyboard input (outside event loop for smooth movement)
@@ -233,41 +554,120 @@ int main() {
 			cameraUp
 		);
 
+		// Rasterize the occluders on the worker threads while this thread updates the scene.
+		JobSystem::JobHandle occlusionReady{ myScene.occlusion.rasterize(jobSystem(), projection * view,
+			cameraPos, nearClipMargin) };
+
 		// Clear buffers
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// Set uniforms for main shader and render scene objects
-		myScene.program.activate();
-		myScene.program.setUniform("view", view);
-		myScene.program.setUniform("projection", projection);
-		myScene.program.setUniform("cameraPos", cameraPos);
-
-		// Material properties: ambient, diffuse, specular, shininess
-		myScene.program.setUniform("material", glm::vec4{ 0.2f, 0.8f, 0.4f, 32 });
-		myScene.program.setUniform("ambientColor", glm::vec3{ 0.65f, 0.65f, 0.65f });
-		myScene.program.setUniform(
-			"directionalLight",
-			glm::normalize(glm::vec3{ 0.3f, 1.0f, 0.7f })
-		);
-		myScene.program.setUniform("directionalColor", glm::vec3{ 1.0f, 1.0f, 1.0f });
+		// Set uniforms for the shaders and render scene objects
+		myScene.queue.defaultMaterial = glm::vec4{ 0.2f, 0.8f, 0.4f, 32 };
+		setLightingUniforms(myScene.instances.program(), view, projection, cameraPos, myScene.queue.defaultMaterial);
+		setLightingUniforms(myScene.program, view, projection, cameraPos, myScene.queue.defaultMaterial);
 
-		myScene.program.setUniform(
-			"pointLight.position",
-			glm::vec3{ 0.8f, 3.3f, 0.5f }
-		);
-		myScene.program.setUniform("pointLight.color", glm::vec3(1.0f));
-		myScene.program.setUniform("pointLight.constant", 1.0f);
-		myScene.program.setUniform("pointLight.linear", 0.09f);
-		myScene.program.setUniform("pointLight.quadratic", 0.032f);
+		updateScene(myScene);
+		if (myScene.forest.update(cameraPos)) {
+			myScene.forest.fillInstances(myScene.instances);
+		}
+		myScene.streamer.update(cameraPos);
+		// Cells streamed out leave holes in the geometry arenas; pack each one once they waste too much. Models
+		// loaded in the packed vertex format live in their own arena.
+		compactGeometryArenas();
+
+		// Queue every scene object and entity, skipping everything outside the camera's view volume, then
+		// draw the queue sorted by GL state and front to back.
+		Frustum frustum{ Frustum::fromMatrix(projection * view) };
+		jobSystem().wait(occlusionReady);
+		frameStats().occlusionMilliseconds = myScene.occlusion.lastRasterMilliseconds();
+		myScene.queries.beginFrame();
+		bool queriesOn{ myScene.queries.mode != OcclusionQueries::Mode::off };
+		myScene.queue.begin(cameraPos, 500.0f, projection[1][1], frustum);
+		myScene.impostors.beginFrame();
+		// The impostor to draw an object as this frame, if it has one and is far enough away.
+		auto impostorFor{ [&](uint32_t object) -> const std::pair<uint32_t, uint32_t>* {
+			for (auto& p : myScene.impostorObjects) {
+				if (p.first == object && glm::distance(cameraPos, myScene.objects[object].worldBounds().center())
+					> myScene.impostors.switchDistance) {
+					return &p;
+				}
+			}
+			return nullptr;
+		} };
+		myScene.queuedObjects.assign(myScene.objects.size(), 0);
+		for (uint32_t i{ 0 }; i < myScene.objects.size(); ++i) {
+			SceneObject& o{ myScene.objects[i] };
+			if (auto impostor{ impostorFor(i) }) {
+				if (frustum.intersects(o.worldBounds())) {
+					myScene.impostors.addInstance(impostor->second, o.worldBounds().center());
+				}
+				continue;
+			}
+			if (queriesOn && myScene.queries.isTracked(i)) {
+				if (!frustum.intersects(o.worldBounds())) {
+					myScene.queries.markOutside(i);
+					continue;
+				}
+				// Conditionally rendered objects are drawn after the queue.
+				if (myScene.queries.mode == OcclusionQueries::Mode::conditional) {
+					continue;
+				}
+				if (!myScene.queries.shouldDraw(i)) {
+					++frameStats().occluded;
+					continue;
+				}
+			}
+			myScene.queuedObjects[i] = 1;
+		}
+		enqueueVisibleNodes(myScene, frustum);
+		myScene.streamer.enqueue(myScene.queue, myScene.program, frustum, &myScene.occlusion);
+
+		// The entity systems each walk contiguous component arrays.
+		updateTransforms(myScene.entities);
+		frameStats().culledEntities += cullEntities(myScene.entities, frustum, &myScene.occlusion);
+		buildDrawList(myScene.entities, myScene.entityDraws);
+		enqueueEntities(myScene.entityDraws, myScene.program, myScene.queue);
+
+		myScene.queue.sort();
+		myScene.queue.submit();
+
+		// Query the tracked objects against the finished depth buffer, drawing them first in conditional mode.
+		if (queriesOn) {
+			glm::mat4 viewProjection{ projection * view };
+			for (uint32_t i{ 0 }; i < myScene.objects.size(); ++i) {
+				SceneObject& o{ myScene.objects[i] };
+				if (!myScene.queries.isTracked(i) || impostorFor(i) || !frustum.intersects(o.worldBounds())) {
+					continue;
+				}
+				if (myScene.queries.mode == OcclusionQueries::Mode::conditional) {
+					myScene.program.activate();
+					myScene.program.setUniform("material", myScene.queue.defaultMaterial);
+					myScene.queries.beginConditional(i);
+					o.drawObject(myScene.program, frustum);
+					myScene.queries.endConditional(i);
+				}
+				myScene.queries.issue(i, o.worldBounds(), viewProjection, cameraPos, nearClipMargin);
+			}
+		}
 
-		// Render scene objects
-		for (auto& o : myScene.objects) {
-			o.drawObject(myScene.program);
+		myScene.instances.draw(frustum, cameraPos, projection[1][1]);
 
-		}
+		myScene.impostors.draw(view, projection, cameraPos, glm::normalize(glm::vec3{ 0.3f, 1.0f, 0.7f }),
+			glm::vec3{ 0.65f, 0.65f, 0.65f });
+		streamBuffer().endFrame();
 
 		window.display();
+		// Delete the GL objects dropped this frame once the GPU has finished with them.
+		gpuResources().endFrame();
+
+#ifdef LOG_FRAME_STATS
+		frameStats().print(std::cout);
+#endif
 	}
 
+	myScene.queue.printTimings(std::cout);
+	streamBuffer().printStats(std::cout);
+	gpuResources().printTable(std::cout);
+	gpuResources().flush();
 	return 0;
 }
\ No newline at end of file